@@ -0,0 +1,11 @@
+#version 330
+/*
+* Bounding boxes are drawn with color and depth writes disabled,
+* only the samples counted by the occlusion query matter.
+*/
+
+out vec4 color;
+
+void main() {
+	color = vec4(1);
+}
@@ -0,0 +1,15 @@
+#version 330
+/*
+* Draws an axis aligned bounding box for occlusion queries.
+* The vertex positions are the corners of the unit cube [0, 1]^3.
+*/
+
+layout(location = 0) in vec3 position;
+
+uniform mat4 viewProjMatrix;
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main() {
+	gl_Position = viewProjMatrix * vec4(mix(boundsMin, boundsMax, position), 1);
+}
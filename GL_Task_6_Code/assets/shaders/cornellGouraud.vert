@@ -12,6 +12,8 @@ out VertexData {
 	vec4 color;
 } vert;
 
+invariant gl_Position;
+
 uniform mat4 modelMatrix;
 uniform mat4 viewProjMatrix;
 uniform mat3 normalMatrix;
@@ -21,26 +23,39 @@ uniform vec3 camera_world;
 uniform vec3 materialCoefficients; // x = ambient, y = diffuse, z = specular 
 uniform float specularAlpha;
 
-uniform bool draw_normals;
-
 uniform struct DirectionalLight {
 	vec3 color;
 	vec3 direction;
 } dirL;
 
-uniform struct PointLight {
-	vec3 color;
-	vec3 position;
-	vec3 attenuation;
-} pointL;
+uniform samplerBuffer pointLightData;       // 3 texels per light: (position, range), (color, 0), (attenuation, 0)
+uniform usamplerBuffer clusterLightRanges;  // (offset, count) per cluster
+uniform usamplerBuffer clusterLightIndices; // light lists of all clusters
+uniform vec3 clusterGridSize;
+uniform vec3 clusterDepthParams;            // slice = log(depth) * x - y, z = near plane
 
-vec3 phong(vec3 n, vec3 l, vec3 v, vec3 diffuseC, float diffuseF, vec3 specularC, float specularF, float alpha, bool attenuate, vec3 attenuation) {
-	float d = length(l);
+vec3 phong(vec3 n, vec3 l, vec3 v, vec3 diffuseC, float diffuseF, vec3 specularC, float specularF, float alpha) {
 	l = normalize(l);
-	float att = 1.0;	
-	if(attenuate) att = 1.0f / (attenuation.x + d * attenuation.y + d * d * attenuation.z);
 	vec3 r = reflect(-l, n);
-	return (diffuseF * diffuseC * max(0, dot(n, l)) + specularF * specularC * pow(max(0, dot(r, v)), alpha)) * att; 
+	return diffuseF * diffuseC * max(0, dot(n, l)) + specularF * specularC * pow(max(0, dot(r, v)), alpha);
+}
+
+// Distance attenuation of a point light, l is the vector from the surface to the light
+float attenuate(vec3 l, vec3 attenuation) {
+	float d = length(l);
+	return 1.0f / (attenuation.x + d * attenuation.y + d * d * attenuation.z);
+}
+
+// Returns the offset into clusterLightIndices and the number of lights of the cluster
+// that contains a clip space position. Positions closer than the near plane (w <= 0 behind the camera)
+// are moved onto it, so neither the division nor the logarithm leave the grid.
+uvec2 getClusterLights(vec4 clip) {
+	float viewDepth = max(clip.w, clusterDepthParams.z);
+	vec3 cell;
+	cell.xy = clamp(clip.xy / viewDepth * 0.5 + 0.5, 0.0, 0.9999) * clusterGridSize.xy;
+	cell.z = clamp(log(viewDepth) * clusterDepthParams.x - clusterDepthParams.y, 0.0, clusterGridSize.z - 1.0);
+	int index = int(cell.x) + int(clusterGridSize.x) * (int(cell.y) + int(clusterGridSize.y) * int(cell.z));
+	return texelFetch(clusterLightRanges, index).xy;
 }
 
 void main() {
@@ -54,25 +69,34 @@ void main() {
 	// Use a different illumination depending on whether we see the inside or outside of the Cornell Box:
 	if (dot(n, v) > 0.0) {
 		// Assume that the Cornell Box is emissive inside:
+#ifdef DRAW_NORMALS
+		vert.color = vec4(n, 1.0);
+#else
 		vert.color = vec4(color, 1.0);
-		if (draw_normals) {
-			vert.color = vec4(n, 1.0);
-		}
+#endif
 		return;
 	}
 	// else, i.e. when viewed from the outside, use the ordinarily shaded color.
 	// But attention: We have to invert the normal, because we'd like to illuminate the back faces:
 	n = -n;
+#ifdef DRAW_NORMALS
+	vert.color = vec4(n, 1.0);
+	return;
+#endif
 
 	vert.color = vec4(color * materialCoefficients.x, 1); // ambient
 	
 	// add directional light contribution
-	vert.color.rgb += phong(n, -dirL.direction, v, dirL.color * color, materialCoefficients.y, dirL.color, materialCoefficients.z, specularAlpha, false, vec3(0));
+	vert.color.rgb += phong(n, -dirL.direction, v, dirL.color * color, materialCoefficients.y, dirL.color, materialCoefficients.z, specularAlpha);
 			
-	// add point light contribution
-	vert.color.rgb += phong(n, pointL.position - position_world.xyz, v, pointL.color * color, materialCoefficients.y, pointL.color, materialCoefficients.z, specularAlpha, true, pointL.attenuation);
-
-	if (draw_normals) {
-		vert.color = vec4(n, 1.0);
+	// add the contributions of the point lights in this vertex's cluster
+	uvec2 lights = getClusterLights(gl_Position);
+	for (uint i = 0u; i < lights.y; ++i) {
+		int light = int(texelFetch(clusterLightIndices, int(lights.x + i)).r) * 3;
+		vec3 lightPosition = texelFetch(pointLightData, light).xyz;
+		vec3 lightColor = texelFetch(pointLightData, light + 1).rgb;
+		vec3 lightAttenuation = texelFetch(pointLightData, light + 2).xyz;
+		vec3 l = lightPosition - position_world.xyz;
+		vert.color.rgb += attenuate(l, lightAttenuation) * phong(n, l, v, lightColor * color, materialCoefficients.y, lightColor, materialCoefficients.z, specularAlpha);
 	}
 }
\ No newline at end of file
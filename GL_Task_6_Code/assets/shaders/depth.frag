@@ -0,0 +1,10 @@
+#version 330
+/*
+* Depth-only pass, color writes are disabled.
+*/
+
+out vec4 color;
+
+void main() {
+	color = vec4(1);
+}
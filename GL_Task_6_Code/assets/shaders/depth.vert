@@ -0,0 +1,18 @@
+#version 330
+/*
+* Depth-only pass, uses the position stream only.
+* gl_Position is invariant and computed exactly like in the shading passes,
+* so that the main pass can test with GL_EQUAL.
+*/
+
+layout(location = 0) in vec3 position;
+
+invariant gl_Position;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewProjMatrix;
+
+void main() {
+	vec4 position_world_ = modelMatrix * vec4(position, 1);
+	gl_Position = viewProjMatrix * position_world_;
+}
@@ -0,0 +1,15 @@
+#version 330
+/*
+* Gray with a fixed light from above, cheap enough to compile before anything else.
+*/
+
+in VertexData {
+	vec3 normal_world;
+} vert;
+
+out vec4 color;
+
+void main() {
+	float light = 0.5 + 0.3 * normalize(vert.normal_world).y;
+	color = vec4(vec3(light), 1);
+}
@@ -0,0 +1,25 @@
+#version 330
+/*
+* Drawn while the program of a material is still compiling.
+* gl_Position is invariant and computed exactly like in the shading passes,
+* so that the fallback also passes the GL_EQUAL test after a depth pre-pass.
+*/
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+out VertexData {
+	vec3 normal_world;
+} vert;
+
+invariant gl_Position;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewProjMatrix;
+uniform mat3 normalMatrix;
+
+void main() {
+	vert.normal_world = normalMatrix * normal;
+	vec4 position_world_ = modelMatrix * vec4(position, 1);
+	gl_Position = viewProjMatrix * position_world_;
+}
@@ -9,6 +9,10 @@ in VertexData {
 	vec3 position_world;
 	vec3 normal_world;
 	vec2 uv;
+	vec4 position_clip;
+#ifdef TEXTURE_ARRAY
+	flat uint textureLayer;
+#endif
 } vert;
 
 out vec4 color;
@@ -17,30 +21,73 @@ uniform vec3 camera_world;
 
 uniform vec3 materialCoefficients; // x = ambient, y = diffuse, z = specular 
 uniform float specularAlpha;
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray diffuseTextureArray; // one draw per array, the layer is given per vertex
+#else
 uniform sampler2D diffuseTexture;
-
-uniform bool draw_normals;
-uniform bool draw_texcoords;
+#endif
 
 uniform struct DirectionalLight {
 	vec3 color;
 	vec3 direction;
 } dirL;
 
-uniform struct PointLight {
-	vec3 color;
-	vec3 position;
-	vec3 attenuation;
-} pointL;
+uniform samplerBuffer pointLightData;       // 3 texels per light: (position, range), (color, 0), (attenuation, 0)
+uniform usamplerBuffer clusterLightRanges;  // (offset, count) per cluster
+uniform usamplerBuffer clusterLightIndices; // light lists of all clusters
+uniform vec3 clusterGridSize;
+uniform vec3 clusterDepthParams;            // slice = log(depth) * x - y, z = near plane
 
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[4];
+uniform vec4 shadowSplits;                  // far view depth of every cascade
+uniform int shadowCascadeCount;
 
-vec3 phong(vec3 n, vec3 l, vec3 v, vec3 diffuseC, float diffuseF, vec3 specularC, float specularF, float alpha, bool attenuate, vec3 attenuation) {
-	float d = length(l);
+vec3 phong(vec3 n, vec3 l, vec3 v, vec3 diffuseC, float diffuseF, vec3 specularC, float specularF, float alpha) {
 	l = normalize(l);
-	float att = 1.0;	
-	if(attenuate) att = 1.0f / (attenuation.x + d * attenuation.y + d * d * attenuation.z);
 	vec3 r = reflect(-l, n);
-	return (diffuseF * diffuseC * max(0, dot(n, l)) + specularF * specularC * pow(max(0, dot(r, v)), alpha)) * att; 
+	return diffuseF * diffuseC * max(0, dot(n, l)) + specularF * specularC * pow(max(0, dot(r, v)), alpha);
+}
+
+// Distance attenuation of a point light, l is the vector from the surface to the light
+float attenuate(vec3 l, vec3 attenuation) {
+	float d = length(l);
+	return 1.0f / (attenuation.x + d * attenuation.y + d * d * attenuation.z);
+}
+
+// Returns the offset into clusterLightIndices and the number of lights of the cluster
+// that contains a clip space position. Positions closer than the near plane (w <= 0 behind the camera)
+// are moved onto it, so neither the division nor the logarithm leave the grid.
+uvec2 getClusterLights(vec4 clip) {
+	float viewDepth = max(clip.w, clusterDepthParams.z);
+	vec3 cell;
+	cell.xy = clamp(clip.xy / viewDepth * 0.5 + 0.5, 0.0, 0.9999) * clusterGridSize.xy;
+	cell.z = clamp(log(viewDepth) * clusterDepthParams.x - clusterDepthParams.y, 0.0, clusterGridSize.z - 1.0);
+	int index = int(cell.x) + int(clusterGridSize.x) * (int(cell.y) + int(clusterGridSize.y) * int(cell.z));
+	return texelFetch(clusterLightRanges, index).xy;
+}
+
+// Returns how much of the directional light reaches a position (0 = shadowed, 1 = lit).
+// The cascade is chosen by view depth, positions outside a cascade fall through to the next one.
+float getShadow(vec3 positionWS, vec3 normalWS, float viewDepth) {
+	for (int i = 0; i < shadowCascadeCount; ++i) {
+		if (viewDepth > shadowSplits[i]) continue;
+		vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+		// offset along the normal by about one texel of this cascade against acne
+		float worldTexel = 2.0 / (length(vec3(shadowMatrices[i][0][0], shadowMatrices[i][1][0], shadowMatrices[i][2][0])) * float(textureSize(shadowMap, 0).x));
+		vec4 p = shadowMatrices[i] * vec4(positionWS + normalWS * worldTexel * 1.5, 1.0);
+		vec3 coords = p.xyz / p.w * 0.5 + 0.5;
+		if (any(lessThan(coords.xy, vec2(0.0))) || any(greaterThan(coords.xy, vec2(1.0)))) continue;
+		if (coords.z >= 1.0) return 1.0;
+		// 2x2 bilinear comparisons at four offsets
+		float lit = 0.0;
+		lit += texture(shadowMap, vec4(coords.xy + vec2(-0.5, -0.5) * texelSize, float(i), coords.z));
+		lit += texture(shadowMap, vec4(coords.xy + vec2( 0.5, -0.5) * texelSize, float(i), coords.z));
+		lit += texture(shadowMap, vec4(coords.xy + vec2(-0.5,  0.5) * texelSize, float(i), coords.z));
+		lit += texture(shadowMap, vec4(coords.xy + vec2( 0.5,  0.5) * texelSize, float(i), coords.z));
+		return lit * 0.25;
+	}
+	return 1.0;
 }
 
 // Gets the reflected color value from a a certain position, from 
@@ -100,28 +147,45 @@ vec3 fresnelSchlick (float cosTheta, vec3 F0) {
 
 void main() {	
 	vec3 n = normalize(vert.normal_world);
+#if defined(DRAW_TEXCOORDS)
+	color = vec4(vert.uv, 0, 1);
+	return;
+#elif defined(DRAW_NORMALS)
+	color = vec4(n, 1);
+	return;
+#endif
 	vec3 v = normalize(vert.position_world - camera_world);
 	vec3 R = normalize(clampedReflect(v, n));
 	vec3 reflectionColor = getCornellBoxReflectionColor(vert.position_world, R);
 	vec3 F0 = vec3(0.1); // <-- some kind of plastic
 	vec3 reflectivity = fresnelSchlick(dot(n, -v), F0);
 
+#ifdef TEXTURE_ARRAY
+	vec3 texColor = texture(diffuseTextureArray, vec3(vert.uv, float(vert.textureLayer))).rgb;
+#else
 	vec3 texColor = texture(diffuseTexture, vert.uv).rgb;
+#endif
 	color = vec4(texColor * materialCoefficients.x, 1); // ambient
 	
 	// add directional light contribution
-	color.rgb += phong(n, -dirL.direction, -v, dirL.color * texColor, materialCoefficients.y, dirL.color, materialCoefficients.z, specularAlpha, false, vec3(0));
+#ifdef SHADOWS
+	float shadow = getShadow(vert.position_world, n, vert.position_clip.w);
+#else
+	float shadow = 1.0;
+#endif
+	color.rgb += shadow * phong(n, -dirL.direction, -v, dirL.color * texColor, materialCoefficients.y, dirL.color, materialCoefficients.z, specularAlpha);
 			
-	// add point light contribution
-	color.rgb += phong(n, pointL.position - vert.position_world, -v, pointL.color * texColor, materialCoefficients.y, pointL.color, materialCoefficients.z, specularAlpha, true, pointL.attenuation);
+	// add the contributions of the point lights in this fragment's cluster
+	uvec2 lights = getClusterLights(vert.position_clip);
+	for (uint i = 0u; i < lights.y; ++i) {
+		int light = int(texelFetch(clusterLightIndices, int(lights.x + i)).r) * 3;
+		vec3 lightPosition = texelFetch(pointLightData, light).xyz;
+		vec3 lightColor = texelFetch(pointLightData, light + 1).rgb;
+		vec3 lightAttenuation = texelFetch(pointLightData, light + 2).xyz;
+		vec3 l = lightPosition - vert.position_world;
+		color.rgb += attenuate(l, lightAttenuation) * phong(n, l, -v, lightColor * texColor, materialCoefficients.y, lightColor, materialCoefficients.z, specularAlpha);
+	}
 
 	color = vec4(mix(color.xyz, reflectionColor, reflectivity), 1.0f);
-
-	if (draw_normals) {
-		color.rgb = n;
-	}
-	if (draw_texcoords) {
-		color.rgb = vec3(vert.uv, 0);
-	}
 }
 
@@ -8,13 +8,22 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 uv;
+#ifdef TEXTURE_ARRAY
+layout(location = 5) in uint textureLayer; // layer in the bound texture array
+#endif
 
 out VertexData {
 	vec3 position_world;
 	vec3 normal_world;
 	vec2 uv;
+	vec4 position_clip;
+#ifdef TEXTURE_ARRAY
+	flat uint textureLayer;
+#endif
 } vert;
 
+invariant gl_Position;
+
 uniform mat4 modelMatrix;
 uniform mat4 viewProjMatrix;
 uniform mat3 normalMatrix;
@@ -22,7 +31,11 @@ uniform mat3 normalMatrix;
 void main() {
 	vert.normal_world = normalMatrix * normal;
 	vert.uv = uv;
+#ifdef TEXTURE_ARRAY
+	vert.textureLayer = textureLayer;
+#endif
 	vec4 position_world_ = modelMatrix * vec4(position, 1);
 	vert.position_world = position_world_.xyz;
 	gl_Position = viewProjMatrix * position_world_;
+	vert.position_clip = gl_Position;
 }
\ No newline at end of file
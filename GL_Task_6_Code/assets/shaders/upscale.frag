@@ -0,0 +1,41 @@
+#version 330
+/*
+* Upscales the dynamic resolution image to the window with contrast-adaptive sharpening.
+* Only the lower left source_size texels of the texture hold the image.
+* Sharpening is reduced where the local contrast is already high, so edges do not ring.
+*/
+
+in vec2 screen_uv;
+
+out vec4 color;
+
+uniform sampler2D source;
+uniform vec2 source_size;
+uniform vec2 texture_size;
+uniform float sharpness;
+
+vec3 fetch(vec2 texel) {
+	// stay half a texel inside the rendered area, the rest of the texture is stale
+	texel = clamp(texel, vec2(0.5), source_size - 0.5);
+	return texture(source, texel / texture_size).rgb;
+}
+
+void main() {
+	vec2 texel = screen_uv * source_size;
+
+	vec3 c = fetch(texel);
+	vec3 n = fetch(texel + vec2(0, 1));
+	vec3 s = fetch(texel - vec2(0, 1));
+	vec3 e = fetch(texel + vec2(1, 0));
+	vec3 w = fetch(texel - vec2(1, 0));
+
+	vec3 minimum = min(c, min(min(n, s), min(e, w)));
+	vec3 maximum = max(c, max(max(n, s), max(e, w)));
+	vec3 amount = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, vec3(1e-4)), 0.0, 1.0));
+
+	// negative lobe weight, from -1/8 (soft) to -1/5 (sharp)
+	vec3 weight = amount * -1.0 / mix(8.0, 5.0, sharpness);
+	vec3 sharpened = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+
+	color = vec4(clamp(sharpened, 0.0, 1.0), 1);
+}
@@ -0,0 +1,157 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#undef min
+#undef max
+
+namespace {
+
+struct Summary {
+    double minimum = 0.0, average = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, maximum = 0.0;
+};
+
+/*!
+ * Nearest-rank percentiles, so every value is one that was actually measured
+ */
+Summary summarize(std::vector<double> values) {
+    Summary summary;
+    if (values.empty())
+        return summary;
+
+    std::sort(values.begin(), values.end());
+    auto percentile = [&](double p) {
+        size_t rank = size_t(std::ceil(p * values.size()));
+        return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    summary.minimum = values.front();
+    summary.average = sum / values.size();
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.maximum = values.back();
+    return summary;
+}
+
+void writeSummary(std::ostream& out, const char* name, const Summary& summary) {
+    out << "    \"" << name << "\": {\"min\": " << summary.minimum << ", \"mean\": " << summary.average
+        << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+        << ", \"max\": " << summary.maximum << "}";
+}
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+Benchmark::Benchmark(unsigned int warmupFrames, unsigned int measuredFrames)
+    : _warmupFrames(warmupFrames)
+    , _frames(std::max(1u, measuredFrames))
+    , _queries(_frames.size() * 2)
+    , _epoch(Clock::now())
+    , _current(-1)
+    , _renderStart(0.0)
+    , _lastPresent(-1.0)
+    , _presentedFrames(0) {
+    glGenQueries(GLsizei(_queries.size()), _queries.data());
+}
+
+Benchmark::~Benchmark() { glDeleteQueries(GLsizei(_queries.size()), _queries.data()); }
+
+void Benchmark::beginFrame(unsigned int frameNumber, double simulationCpuTime) {
+    _current = long(frameNumber) - long(_warmupFrames);
+    if (_current >= long(_frames.size())) {
+        _current = -1;
+    }
+    _renderStart = now();
+    if (_lastPresent < 0.0) {
+        _lastPresent = _renderStart;
+    }
+    if (_current >= 0) {
+        _frames[_current].simulationCpuTime = simulationCpuTime;
+        glQueryCounter(_queries[_current * 2], GL_TIMESTAMP);
+    }
+}
+
+void Benchmark::endFrame() {
+    if (_current >= 0) {
+        _frames[_current].renderCpuTime = now() - _renderStart;
+        glQueryCounter(_queries[_current * 2 + 1], GL_TIMESTAMP);
+    }
+}
+
+void Benchmark::framePresented() {
+    double present = now();
+    if (_current >= 0) {
+        _frames[_current].frameTime = present - _lastPresent;
+    }
+    _lastPresent = present;
+    _presentedFrames++;
+}
+
+bool Benchmark::writeReport(const std::string& filepath, const std::string& rendererSettings, int width, int height) {
+    // only frames that were actually presented, the run may have been cancelled
+    size_t frameCount = std::min(_frames.size(), size_t(std::max(0, int(_presentedFrames) - int(_warmupFrames))));
+
+    std::vector<double> frameTimes, simulationTimes, renderTimes, gpuTimes;
+    for (size_t i = 0; i < frameCount; i++) {
+        // waits for the GPU, the run is over
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(_queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(_queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+        frameTimes.push_back(_frames[i].frameTime * 1000.0);
+        simulationTimes.push_back(_frames[i].simulationCpuTime * 1000.0);
+        renderTimes.push_back(_frames[i].renderCpuTime * 1000.0);
+        gpuTimes.push_back(double(end - begin) * 1e-6);
+    }
+    Summary frameSummary = summarize(frameTimes);
+    Summary gpuSummary = summarize(gpuTimes);
+
+    std::cout << "Benchmark: " << frameCount << " frames, frame time p50 / p95 / p99 " << frameSummary.p50 << " / "
+              << frameSummary.p95 << " / " << frameSummary.p99 << " ms, GPU time p50 / p95 / p99 " << gpuSummary.p50
+              << " / " << gpuSummary.p95 << " / " << gpuSummary.p99 << " ms" << std::endl;
+
+    std::ofstream out(filepath);
+    if (!out) {
+        std::cerr << "Could not write benchmark report " << filepath << std::endl;
+        return false;
+    }
+    out << std::fixed << std::setprecision(4);
+    out << "{\n";
+    out << "  \"renderer_settings\": \"" << escapeJson(rendererSettings) << "\",\n";
+    out << "  \"width\": " << width << ",\n";
+    out << "  \"height\": " << height << ",\n";
+    out << "  \"warmup_frames\": " << _warmupFrames << ",\n";
+    out << "  \"measured_frames\": " << frameCount << ",\n";
+    out << "  \"summary_ms\": {\n";
+    writeSummary(out, "frame", frameSummary);
+    out << ",\n";
+    writeSummary(out, "cpu_simulation", summarize(simulationTimes));
+    out << ",\n";
+    writeSummary(out, "cpu_render", summarize(renderTimes));
+    out << ",\n";
+    writeSummary(out, "gpu", gpuSummary);
+    out << "\n  },\n";
+    out << "  \"frames_ms\": [";
+    for (size_t i = 0; i < frameCount; i++) {
+        out << (i == 0 ? "\n" : ",\n") << "    {\"frame\": " << frameTimes[i] << ", \"cpu_simulation\": " << simulationTimes[i]
+            << ", \"cpu_render\": " << renderTimes[i] << ", \"gpu\": " << gpuTimes[i] << "}";
+    }
+    out << "\n  ]\n}\n";
+    return bool(out);
+}
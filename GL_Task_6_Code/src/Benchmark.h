@@ -0,0 +1,86 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/*!
+ * Records the timings of a fixed number of frames and writes them as JSON report
+ * The first warm-up frames are rendered but not recorded, they include shader compilation, uploads and cache
+ * misses. Every recorded frame gets a pair of timestamp queries, they are only read back in writeReport(), so the
+ * measurement itself never stalls the GPU.
+ * beginFrame() to framePresented() have to be called on the render thread, the rest while it is not running.
+ */
+class Benchmark {
+  protected:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        /*!
+         * Time from one presented frame to the next
+         */
+        double frameTime = 0.0;
+        double simulationCpuTime = 0.0;
+        double renderCpuTime = 0.0;
+    };
+
+    unsigned int _warmupFrames;
+    std::vector<Frame> _frames;
+    std::vector<GLuint> _queries;
+
+    Clock::time_point _epoch;
+    /*!
+     * Index of the current frame into _frames, negative during the warm-up
+     */
+    long _current;
+    double _renderStart;
+    double _lastPresent;
+    unsigned int _presentedFrames;
+
+    double now() const { return std::chrono::duration<double>(Clock::now() - _epoch).count(); }
+
+  public:
+    /*!
+     * Benchmark constructor, needs the GL context
+     * @param warmupFrames: number of frames that are not recorded
+     * @param measuredFrames: number of recorded frames after the warm-up
+     */
+    Benchmark(unsigned int warmupFrames, unsigned int measuredFrames);
+    ~Benchmark();
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    /*!
+     * Starts the render thread's work for a frame
+     * @param frameNumber: number of the simulation frame, counting from 0
+     * @param simulationCpuTime: CPU time the simulation spent on the frame, in seconds
+     */
+    void beginFrame(unsigned int frameNumber, double simulationCpuTime);
+
+    /*!
+     * Ends the frame's GL submission, call before swapping the buffers
+     */
+    void endFrame();
+
+    /*!
+     * Records the frame time, call after swapping the buffers
+     */
+    void framePresented();
+
+    /*!
+     * @return whether all recorded frames were presented
+     */
+    bool isFinished() const { return _presentedFrames >= _warmupFrames + _frames.size(); }
+
+    /*!
+     * Reads back the GPU times, prints a summary and writes the report, needs the GL context
+     * @param filepath: the JSON output file
+     * @param rendererSettings: renderer INI file the run used, copied into the report
+     * @param width: framebuffer width
+     * @param height: framebuffer height
+     * @return whether the report was written
+     */
+    bool writeReport(const std::string& filepath, const std::string& rendererSettings, int width, int height);
+};
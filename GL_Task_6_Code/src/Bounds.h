@@ -0,0 +1,147 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+/*!
+ * Axis aligned bounding box
+ */
+struct AABB {
+    /*!
+     * Minimum corner of the box
+     */
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    /*!
+     * Maximum corner of the box
+     */
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    AABB() = default;
+
+    /*!
+     * Bounding box constructor
+     * @param min: minimum corner of the box
+     * @param max: maximum corner of the box
+     */
+    AABB(glm::vec3 min, glm::vec3 max)
+        : min(min)
+        , max(max) {}
+
+    /*!
+     * @return if the box contains at least one point
+     */
+    bool isValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    /*!
+     * @return the center of the box
+     */
+    glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+
+    /*!
+     * @return the half size of the box along each axis
+     */
+    glm::vec3 getExtents() const { return (max - min) * 0.5f; }
+
+    /*!
+     * @param i: index of the corner (0-7), bit 0 selects x, bit 1 selects y, bit 2 selects z
+     * @return the corner of the box
+     */
+    glm::vec3 getCorner(unsigned int i) const { return glm::vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z); }
+
+    /*!
+     * Grows the box so that it contains the given point
+     * @param p: the point to be included
+     */
+    void expand(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    /*!
+     * Grows the box so that it contains the given box
+     * @param other: the box to be included
+     */
+    void expand(const AABB& other) {
+        if (!other.isValid())
+            return;
+        expand(other.min);
+        expand(other.max);
+    }
+
+    /*!
+     * @param p: the point to test
+     * @return if the point lies inside the box
+     */
+    bool contains(const glm::vec3& p) const { return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z; }
+
+    /*!
+     * Transforms the box and returns the axis aligned box around the result
+     * @param m: the transformation matrix
+     * @return the transformed bounding box
+     */
+    AABB transformed(const glm::mat4& m) const {
+        if (!isValid())
+            return AABB();
+        // Arvo's method: project the extents onto every axis of the new frame
+        glm::vec3 center = glm::vec3(m * glm::vec4(getCenter(), 1.0f));
+        glm::vec3 extents = getExtents();
+        glm::vec3 newExtents = glm::abs(glm::vec3(m[0])) * extents.x + glm::abs(glm::vec3(m[1])) * extents.y + glm::abs(glm::vec3(m[2])) * extents.z;
+        return AABB(center - newExtents, center + newExtents);
+    }
+
+    /*!
+     * Computes the bounding box of a set of points
+     * @param points: the points to enclose
+     * @return the bounding box of the points
+     */
+    static AABB fromPoints(const std::vector<glm::vec3>& points) {
+        AABB box;
+        for (const glm::vec3& p : points) {
+            box.expand(p);
+        }
+        return box;
+    }
+};
+
+/*!
+ * View frustum, given by the six planes of a view-projection matrix
+ */
+struct Frustum {
+    /*!
+     * Planes (normal, distance), pointing inwards: left, right, bottom, top, near, far
+     */
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    /*!
+     * Frustum constructor, extracts the planes from a view-projection matrix
+     * @param viewProjMatrix: the view-projection matrix
+     */
+    explicit Frustum(const glm::mat4& viewProjMatrix) {
+        glm::vec4 row0(viewProjMatrix[0][0], viewProjMatrix[1][0], viewProjMatrix[2][0], viewProjMatrix[3][0]);
+        glm::vec4 row1(viewProjMatrix[0][1], viewProjMatrix[1][1], viewProjMatrix[2][1], viewProjMatrix[3][1]);
+        glm::vec4 row2(viewProjMatrix[0][2], viewProjMatrix[1][2], viewProjMatrix[2][2], viewProjMatrix[3][2]);
+        glm::vec4 row3(viewProjMatrix[0][3], viewProjMatrix[1][3], viewProjMatrix[2][3], viewProjMatrix[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+    }
+
+    /*!
+     * @return false if the box lies completely outside of one of the planes
+     */
+    bool intersects(const AABB& box) const {
+        for (const glm::vec4& plane : planes) {
+            // corner furthest along the plane normal
+            glm::vec3 p(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,54 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#undef min
+#undef max
+
+CameraPath::CameraPath(INIReader& reader) {
+    long count = reader.GetInteger("path", "keyframes", 0);
+    for (long i = 0; i < count; i++) {
+        std::string name = "keyframe" + std::to_string(i);
+        std::istringstream values(reader.Get("path", name, ""));
+        CameraKeyframe keyframe;
+        if (!(values >> keyframe.time >> keyframe.yaw >> keyframe.pitch >> keyframe.zoom)) {
+            std::cerr << "Camera path: " << name << " needs time, yaw, pitch and zoom" << std::endl;
+            continue;
+        }
+        if (!_keyframes.empty() && keyframe.time <= _keyframes.back().time) {
+            std::cerr << "Camera path: " << name << " is not after the previous keyframe" << std::endl;
+            continue;
+        }
+        _keyframes.push_back(keyframe);
+    }
+}
+
+CameraKeyframe CameraPath::evaluate(double time) const {
+    if (_keyframes.empty())
+        return CameraKeyframe();
+    if (_keyframes.size() == 1)
+        return _keyframes[0];
+
+    double start = _keyframes.front().time;
+    double duration = _keyframes.back().time - start;
+    time = start + std::fmod(std::max(0.0, time), duration);
+
+    // first keyframe after the time, the path has only a few of them
+    size_t next = 1;
+    while (next < _keyframes.size() - 1 && _keyframes[next].time <= time) {
+        next++;
+    }
+    const CameraKeyframe& a = _keyframes[next - 1];
+    const CameraKeyframe& b = _keyframes[next];
+    float t = float((time - a.time) / (b.time - a.time));
+
+    CameraKeyframe result;
+    result.time = time;
+    result.yaw = a.yaw + (b.yaw - a.yaw) * t;
+    result.pitch = a.pitch + (b.pitch - a.pitch) * t;
+    result.zoom = a.zoom + (b.zoom - a.zoom) * t;
+    return result;
+}
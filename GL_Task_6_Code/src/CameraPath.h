@@ -0,0 +1,44 @@
+#pragma once
+
+#include "INIReader.h"
+#include <vector>
+
+/*!
+ * Camera state at a point in time of a scripted camera path
+ */
+struct CameraKeyframe {
+    double time = 0.0;
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+    float zoom = 5.0f;
+};
+
+/*!
+ * Scripted camera path for reproducible runs, read from the [path] section of a camera INI file:
+ *   keyframes = 2
+ *   keyframe0 = 0.0 0.0 0.0 5.0    ; time in seconds, yaw, pitch, zoom
+ *   keyframe1 = 8.0 360.0 20.0 3.0
+ * The keyframes are interpolated linearly, the path repeats after the last keyframe.
+ */
+class CameraPath {
+  protected:
+    std::vector<CameraKeyframe> _keyframes;
+
+  public:
+    /*!
+     * Camera path constructor
+     * @param reader: the camera INI file, a missing or broken [path] section results in an empty path
+     */
+    explicit CameraPath(INIReader& reader);
+
+    /*!
+     * @return whether the file contained no usable keyframes
+     */
+    bool isEmpty() const { return _keyframes.empty(); }
+
+    /*!
+     * @return the interpolated camera state
+     * @param time: time since the start of the path, in seconds
+     */
+    CameraKeyframe evaluate(double time) const;
+};
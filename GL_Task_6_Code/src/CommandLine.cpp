@@ -0,0 +1,58 @@
+#include "CommandLine.h"
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#undef min
+#undef max
+
+void parseEngineArgs(EngineArgs& args, int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) {
+            args.trace = true;
+            args.trace_filepath = argv[++i];
+        } else if (arg == "--trace-startup") {
+            args.trace_startup = true;
+        } else if (arg == "--trace-frames" && i + 2 < argc) {
+            args.trace_first_frame = unsigned(std::strtoul(argv[++i], nullptr, 10));
+            args.trace_frame_count = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--benchmark" && i + 1 < argc) {
+            args.benchmark = true;
+            args.benchmark_filepath = argv[++i];
+        } else if (arg == "--benchmark-frames" && i + 2 < argc) {
+            args.benchmark_warmup_frames = unsigned(std::strtoul(argv[++i], nullptr, 10));
+            args.benchmark_frames = std::max(1u, unsigned(std::strtoul(argv[++i], nullptr, 10)));
+        } else if (arg == "--capture" && i + 1 < argc) {
+            args.capture = true;
+            args.capture_path = argv[++i];
+        } else if (arg == "--capture-threads" && i + 1 < argc) {
+            args.capture_threads = unsigned(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--image-format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            std::transform(format.begin(), format.end(), format.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+            if (isImageFormat(format)) {
+                args.image_format = format;
+            } else {
+                std::cerr << "Unknown image format " << format << ", using " << args.image_format << std::endl;
+            }
+        }
+    }
+
+    if (args.trace && !args.trace_startup && args.trace_frame_count == 0) {
+        // without a range the first frames after startup are the most useful default
+        args.trace_frame_count = 10;
+    }
+    if (args.capture_threads == 0) {
+        args.capture_threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    if (!args.trace && (args.trace_startup || args.trace_frame_count > 0)) {
+        std::cerr << "--trace-startup and --trace-frames need --trace <file>" << std::endl;
+        args.trace_startup = false;
+        args.trace_frame_count = 0;
+    }
+}
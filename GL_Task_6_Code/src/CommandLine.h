@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+/*!
+ * Command line options of the engine, in addition to the framework's CMDLineArgs
+ */
+struct EngineArgs {
+    /*!
+     * --trace <file>: writes a Chrome trace of the recorded CPU zones
+     */
+    bool trace = false;
+    std::string trace_filepath = "";
+    /*!
+     * --trace-startup: records from program start until the first frame begins
+     */
+    bool trace_startup = false;
+    /*!
+     * --trace-frames <first> <count>: records the given simulation frames
+     */
+    unsigned int trace_first_frame = 0;
+    unsigned int trace_frame_count = 0;
+    /*!
+     * --benchmark <file>: renders a fixed number of frames with a fixed time step and writes their timings as JSON
+     */
+    bool benchmark = false;
+    std::string benchmark_filepath = "";
+    /*!
+     * --benchmark-frames <warm-up> <measured>: number of frames rendered before and during the measurement
+     */
+    unsigned int benchmark_warmup_frames = 60;
+    unsigned int benchmark_frames = 600;
+    /*!
+     * --capture <path>: writes every rendered frame, to a video if the path ends with .y4m, otherwise as numbered images
+     */
+    bool capture = false;
+    std::string capture_path = "";
+    /*!
+     * --capture-threads <count>: number of threads encoding the captured frames, 0 for half the hardware threads
+     */
+    unsigned int capture_threads = 0;
+    /*!
+     * --image-format <ppm|png|qoi>: format of screenshots and captured images
+     */
+    std::string image_format = "ppm";
+};
+
+/*!
+ * Reads the engine's options, arguments it does not know are skipped
+ * @param args: receives the options
+ * @param argc: argument count of main()
+ * @param argv: arguments of main()
+ */
+void parseEngineArgs(EngineArgs& args, int argc, char** argv);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Material.h"
+#include "SceneGraph.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <memory>
+
+/*!
+ * Places an entity in the scene graph, the world matrix is stored in the graph
+ */
+struct TransformComponent {
+    NodeId node = SceneGraph::NO_PARENT;
+};
+
+/*!
+ * GPU geometry of an entity, the buffers are owned by the object that created the entity
+ */
+struct RenderableComponent {
+    GLuint vao = 0;
+    /*!
+     * Position-only vertex array for depth passes
+     */
+    GLuint vaoDepth = 0;
+    unsigned int elements = 0;
+    /*!
+     * Disabled renderables are skipped when building draw lists
+     */
+    bool enabled = true;
+};
+
+/*!
+ * Material of an entity
+ */
+struct MaterialComponent {
+    std::shared_ptr<Material> material;
+};
+
+/*!
+ * Bounding boxes of an entity, the world box is kept up to date by updateWorldBounds()
+ */
+struct BoundsComponent {
+    AABB local;
+    AABB world;
+};
+
+/*!
+ * Position and rotation of a player, applied to its scene graph node by updatePlayerTransforms()
+ */
+struct PlayerStateComponent {
+    glm::vec3 position = glm::vec3(0.0f);
+    float rotationY = 0.0f;
+    bool dirty = false;
+};
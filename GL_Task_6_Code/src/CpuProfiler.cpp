@@ -0,0 +1,169 @@
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start, end;
+};
+
+/*!
+ * Events of one thread, only the owning thread appends
+ */
+struct EventChunk {
+    static const unsigned int CAPACITY = 4096;
+
+    Event events[CAPACITY];
+    std::atomic<unsigned int> count{0};
+    std::atomic<EventChunk*> next{nullptr};
+};
+
+struct ThreadBuffer {
+    unsigned int id = 0;
+    std::atomic<const char*> name{nullptr};
+    std::unique_ptr<EventChunk> first;
+    EventChunk* last = nullptr;
+    /*!
+     * Chunks after the first one, owned here and linked through EventChunk::next for readers
+     */
+    std::vector<std::unique_ptr<EventChunk>> more;
+};
+
+std::mutex bufferMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+/*!
+ * Name set before the thread recorded anything, buffers are only allocated once a thread records
+ */
+thread_local const char* threadName = nullptr;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer& getThreadBuffer() {
+    if (!threadBuffer) {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->first.reset(new EventChunk());
+        buffer->last = buffer->first.get();
+        buffer->name.store(threadName, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        buffer->id = static_cast<unsigned int>(buffers.size());
+        threadBuffer = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+    return *threadBuffer;
+}
+
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(*c));
+            out << escaped;
+        } else {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+/*!
+ * Trace events are in microseconds, the nanoseconds are kept as fraction
+ */
+void writeMicroseconds(std::ostream& out, uint64_t nanoseconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03llu", (unsigned long long)(nanoseconds / 1000), (unsigned long long)(nanoseconds % 1000));
+    out << text;
+}
+
+} // namespace
+
+std::atomic<bool> CpuProfiler::_enabled(false);
+
+uint64_t CpuProfiler::now() {
+    // never 0, zones use 0 for "not recording"
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count()) + 1;
+}
+
+void CpuProfiler::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    EventChunk* chunk = buffer.last;
+    unsigned int count = chunk->count.load(std::memory_order_relaxed);
+    if (count == EventChunk::CAPACITY) {
+        buffer.more.emplace_back(new EventChunk());
+        EventChunk* next = buffer.more.back().get();
+        chunk->next.store(next, std::memory_order_release);
+        buffer.last = chunk = next;
+        count = 0;
+    }
+    chunk->events[count] = Event{name, start, end};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+    threadName = name;
+    if (threadBuffer) {
+        threadBuffer->name.store(name, std::memory_order_relaxed);
+    }
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& filepath) {
+    std::ofstream out(filepath);
+    if (!out) {
+        std::cerr << "Could not write trace " << filepath << std::endl;
+        return false;
+    }
+
+    // buffers are never removed, the ones registered later have no events of interest yet
+    std::vector<ThreadBuffer*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+            snapshot.push_back(buffer.get());
+        }
+    }
+
+    unsigned int eventCount = 0;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (ThreadBuffer* buffer : snapshot) {
+        const char* threadName = buffer->name.load(std::memory_order_relaxed);
+        if (threadName) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+            writeJsonString(out, threadName);
+            out << "}}";
+            first = false;
+        }
+
+        for (EventChunk* chunk = buffer->first.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            unsigned int count = chunk->count.load(std::memory_order_acquire);
+            for (unsigned int i = 0; i < count; i++) {
+                const Event& event = chunk->events[i];
+                out << (first ? "" : ",") << "\n{\"name\":";
+                writeJsonString(out, event.name);
+                out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->id << ",\"ts\":";
+                writeMicroseconds(out, event.start);
+                out << ",\"dur\":";
+                writeMicroseconds(out, event.end - event.start);
+                out << "}";
+                first = false;
+                eventCount++;
+            }
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "Wrote " << eventCount << " trace events to " << filepath << std::endl;
+    return bool(out);
+}
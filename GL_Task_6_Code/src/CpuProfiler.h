@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*!
+ * Records timed zones on any thread and exports them as a Chrome trace (chrome://tracing, Perfetto)
+ * Every thread writes into its own buffer, a list of fixed-size chunks. An event is published by incrementing the
+ * chunk's atomic count, so recording never locks and the trace can be written while other threads keep recording.
+ * While recording is disabled a zone costs one relaxed atomic load.
+ */
+class CpuProfiler {
+  protected:
+    static std::atomic<bool> _enabled;
+
+  public:
+    /*!
+     * Starts or stops recording, events recorded so far are kept
+     */
+    static void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    /*!
+     * @return nanoseconds since an arbitrary, fixed point in time
+     */
+    static uint64_t now();
+
+    /*!
+     * Records a finished zone on the calling thread
+     * @param name: name of the zone, has to stay valid until the trace is written (usually a literal)
+     * @param start: start time from now()
+     * @param end: end time from now()
+     */
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    /*!
+     * Names the calling thread in the trace
+     * @param name: name of the thread, has to stay valid until the trace is written
+     */
+    static void setThreadName(const char* name);
+
+    /*!
+     * Writes all recorded events as Chrome trace event JSON
+     * @param filepath: the output file
+     * @return whether the file was written
+     */
+    static bool writeChromeTrace(const std::string& filepath);
+};
+
+/*!
+ * Records the lifetime of the object as a zone, use PROFILE_ZONE instead
+ */
+class CpuZone {
+  protected:
+    const char* _name;
+    uint64_t _start;
+
+  public:
+    explicit CpuZone(const char* name)
+        : _name(name)
+        , _start(CpuProfiler::isEnabled() ? CpuProfiler::now() : 0) {}
+    ~CpuZone() {
+        if (_start != 0 && CpuProfiler::isEnabled())
+            CpuProfiler::record(_name, _start, CpuProfiler::now());
+    }
+
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+/*!
+ * Times the rest of the enclosing block
+ */
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(cpuZone, __LINE__)(name)
+
+/*!
+ * Times the rest of the enclosing function
+ */
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
@@ -0,0 +1,152 @@
+#include "DrawList.h"
+#include "Components.h"
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Small id derived from an object's address, only used to group equal states next to each other
+ */
+inline uint64_t pointerKey(const void* pointer, unsigned int bits) { return (uint64_t(reinterpret_cast<uintptr_t>(pointer)) >> 4) & ((uint64_t(1) << bits) - 1); }
+
+} // namespace
+
+DrawListBuilder::DrawListBuilder()
+    : _threadLists(getWorkerThreadCount())
+    , _nextList(0)
+    , _culledCount(0) {}
+
+void DrawListBuilder::build(
+    EntityWorld& entities,
+    const SceneGraph& scene,
+    const glm::mat4& viewProjMatrix,
+    const glm::vec3& cameraPosition,
+    float farPlane,
+    const std::function<bool(const AABB&)>& isVisible
+) {
+    PROFILE_FUNCTION();
+    for (std::vector<DrawCommand>& list : _threadLists) {
+        list.clear();
+    }
+    _nextList = 0;
+    _culledCount = 0;
+
+    Frustum frustum(viewProjMatrix);
+    float depthScale = float((1u << 24) - 1) / farPlane;
+
+    // every worker range records into its own list
+    entities.parallelEachWith<TransformComponent, RenderableComponent, MaterialComponent, BoundsComponent>(
+        [&]() { return &_threadLists[_nextList++]; },
+        [&](std::vector<DrawCommand>* list, Entity entity, TransformComponent& transform, RenderableComponent& renderable, MaterialComponent& material, BoundsComponent& bounds) {
+            if (!renderable.enabled)
+                return;
+            if (!frustum.intersects(bounds.world) || !isVisible(bounds.world)) {
+                _culledCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            Material* mat = material.material.get();
+            ShaderVariants* shader = mat->getShaderVariants();
+            float distance = glm::length(bounds.world.getCenter() - cameraPosition);
+            uint32_t depth = uint32_t(std::min(std::max(distance * depthScale, 0.0f), float((1u << 24) - 1)));
+
+            DrawCommand command;
+            command.sortKey = (pointerKey(shader, 16) << 48) | (pointerKey(mat, 24) << 24) | depth;
+            command.depthKey = depth;
+            command.elements = renderable.elements;
+            command.vao = renderable.vao;
+            command.vaoDepth = renderable.vaoDepth;
+            command.shader = shader;
+            command.material = mat;
+            command.entity = entity;
+            command.worldBounds = bounds.world;
+            command.modelMatrix = scene.getWorldMatrix(transform.node);
+            command.normalMatrix = scene.getNormalMatrix(transform.node);
+            command.previousModelMatrix = scene.getPreviousWorldMatrix(transform.node);
+            list->push_back(command);
+        }
+    );
+
+    // merge and sort on the calling thread, the lists are small compared to the work above
+    _commands.clear();
+    for (const std::vector<DrawCommand>& list : _threadLists) {
+        _commands.insert(_commands.end(), list.begin(), list.end());
+    }
+    std::sort(_commands.begin(), _commands.end(), [](const DrawCommand& a, const DrawCommand& b) { return a.sortKey < b.sortKey; });
+
+    _depthOrder.resize(_commands.size());
+    for (unsigned int i = 0; i < _depthOrder.size(); i++) {
+        _depthOrder[i] = i;
+    }
+    std::sort(_depthOrder.begin(), _depthOrder.end(), [&](unsigned int a, unsigned int b) { return _commands[a].depthKey < _commands[b].depthKey; });
+}
+
+void DrawListBuilder::submitDepth(Shader& depthShader, float interpolation) const {
+    for (unsigned int index : _depthOrder) {
+        const DrawCommand& command = _commands[index];
+        depthShader.setUniform("modelMatrix", command.getModelMatrix(interpolation));
+        glBindVertexArray(command.vaoDepth);
+        glDrawElements(GL_TRIANGLES, command.elements, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
+void DrawListBuilder::submitDepth(const std::vector<DrawCommand>& commands, Shader& depthShader, float interpolation) {
+    for (const DrawCommand& command : commands) {
+        depthShader.setUniform("modelMatrix", command.getModelMatrix(interpolation));
+        glBindVertexArray(command.vaoDepth);
+        glDrawElements(GL_TRIANGLES, command.elements, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
+void DrawListBuilder::submit(uint32_t shaderFeatures, OcclusionQueries* queries, float interpolation) const {
+    const ShaderVariants* currentVariants = nullptr;
+    Shader* currentShader = nullptr;
+    const Material* currentMaterial = nullptr;
+    GLuint currentVao = 0;
+
+    for (const DrawCommand& command : _commands) {
+        auto draw = [&]() {
+            GpuScope scope(GpuProfiler::getDrawProfiler(), "DrawList draw");
+            if (command.shader != currentVariants) {
+                // the variant lookup only happens when the shader changes, which the sort order keeps rare
+                currentShader = command.shader->get(shaderFeatures);
+                currentShader->use();
+                currentVariants = command.shader;
+                currentMaterial = nullptr;
+            }
+            if (command.material != currentMaterial) {
+                command.material->setUniforms(*currentShader);
+                currentMaterial = command.material;
+            }
+            // the normal matrix is not blended, the rotation between two steps is small
+            currentShader->setUniform("modelMatrix", command.getModelMatrix(interpolation));
+            currentShader->setUniform("normalMatrix", command.normalMatrix);
+            if (command.vao != currentVao) {
+                glBindVertexArray(command.vao);
+                currentVao = command.vao;
+            }
+            glDrawElements(GL_TRIANGLES, command.elements, GL_UNSIGNED_INT, 0);
+        };
+
+        if (queries) {
+            // the bounding box pass binds its own shader and vertex array
+            currentVariants = nullptr;
+            currentVao = 0;
+            glBindVertexArray(0);
+            // keyed by entity index, small integers never collide with the object addresses other callers use as keys
+            queries->draw(reinterpret_cast<const void*>(uintptr_t(command.entity.index) + 1), command.worldBounds, command.elements, draw);
+        } else {
+            draw();
+        }
+    }
+    glBindVertexArray(0);
+}
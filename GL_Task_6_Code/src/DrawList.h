@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Bounds.h"
+#include "EntityWorld.h"
+#include "Material.h"
+#include "OcclusionQueries.h"
+#include "SceneGraph.h"
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include <GL/glew.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*!
+ * A single draw call with all per-draw constants, recorded on a worker thread and replayed on the GL thread
+ */
+struct DrawCommand {
+    /*!
+     * Shader, material and front-to-back depth, in this order of significance
+     */
+    uint64_t sortKey;
+    /*!
+     * Quantized distance to the camera, used for front-to-back depth passes
+     */
+    uint32_t depthKey;
+    unsigned int elements;
+    GLuint vao, vaoDepth;
+    /*!
+     * The material's shader, the variant is chosen when the command is replayed
+     */
+    ShaderVariants* shader;
+    Material* material;
+    /*!
+     * Identifies the object across frames for occlusion queries
+     */
+    Entity entity;
+    AABB worldBounds;
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix;
+    /*!
+     * World matrix after the previous simulation step
+     */
+    glm::mat4 previousModelMatrix;
+
+    /*!
+     * @return the model matrix blended between the last two simulation steps
+     * @param interpolation: 0 for the previous step, 1 for the latest one
+     */
+    glm::mat4 getModelMatrix(float interpolation) const { return interpolation >= 1.0f ? modelMatrix : previousModelMatrix + (modelMatrix - previousModelMatrix) * interpolation; }
+};
+
+/*!
+ * Builds the frame's draw calls in parallel
+ * The renderable entities are split across worker threads. Every thread culls its entities, computes the sort keys
+ * and writes the per-draw constants into its own command list, so no locking is needed.
+ * The GL thread merges the lists, sorts them once and replays them with redundant state changes removed.
+ */
+class DrawListBuilder {
+  protected:
+    /*!
+     * One list per parallelFor chunk, each chunk claims a list through the atomic counter
+     */
+    std::vector<std::vector<DrawCommand>> _threadLists;
+    std::atomic<unsigned int> _nextList;
+
+    std::vector<DrawCommand> _commands;
+    std::vector<unsigned int> _depthOrder;
+
+    std::atomic<unsigned int> _culledCount;
+
+  public:
+    DrawListBuilder();
+
+    /*!
+     * Culls all enabled renderable entities and records their draw commands
+     * @param entities: the entity world
+     * @param scene: the scene graph, already updated for this frame
+     * @param viewProjMatrix: view-projection matrix of the camera
+     * @param cameraPosition: position of the camera in world space
+     * @param farPlane: far plane distance of the camera, for depth sorting
+     * @param isVisible: additional visibility test (e.g. occlusion culling), called concurrently
+     */
+    void build(
+        EntityWorld& entities,
+        const SceneGraph& scene,
+        const glm::mat4& viewProjMatrix,
+        const glm::vec3& cameraPosition,
+        float farPlane,
+        const std::function<bool(const AABB&)>& isVisible
+    );
+
+    /*!
+     * Replays the commands front to back with the position-only vertex arrays
+     * @param depthShader: the depth-only shader, in use and with viewProjMatrix already set
+     * @param interpolation: blend factor between the last two simulation steps
+     */
+    void submitDepth(Shader& depthShader, float interpolation = 1.0f) const;
+
+    /*!
+     * Replays commands with the position-only vertex arrays, in the given order
+     * @param commands: the commands
+     * @param depthShader: the depth-only shader, in use and with viewProjMatrix already set
+     * @param interpolation: blend factor between the last two simulation steps
+     */
+    static void submitDepth(const std::vector<DrawCommand>& commands, Shader& depthShader, float interpolation = 1.0f);
+
+    /*!
+     * Replays the commands sorted by state
+     * @param shaderFeatures: combination of ShaderFeature bits selecting the shader variants
+     * @param queries: occlusion queries for expensive objects, or nullptr
+     * @param interpolation: blend factor between the last two simulation steps
+     */
+    void submit(uint32_t shaderFeatures, OcclusionQueries* queries, float interpolation = 1.0f) const;
+
+    /*!
+     * @return the merged commands of the last build, sorted by state
+     */
+    const std::vector<DrawCommand>& getCommands() const { return _commands; }
+
+    /*!
+     * @return the number of entities culled in the last build
+     */
+    unsigned int getCulledCount() const { return _culledCount; }
+};
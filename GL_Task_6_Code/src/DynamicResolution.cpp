@@ -0,0 +1,196 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Scale changes smaller than this are ignored, so the resolution does not flicker around the budget
+ */
+const float SCALE_DEAD_ZONE = 0.02f;
+
+/*!
+ * Part of the difference to the target scale applied per measured frame
+ */
+const float SCALE_RESPONSE = 0.2f;
+
+/*!
+ * Viewport sizes are rounded to multiples of this
+ */
+const int SIZE_GRANULARITY = 8;
+
+int scaledSize(int size, float scale, int maxSize) {
+    int scaled = int(std::lround(size * scale / SIZE_GRANULARITY)) * SIZE_GRANULARITY;
+    return std::max(SIZE_GRANULARITY, std::min(scaled, maxSize));
+}
+
+} // namespace
+
+DynamicResolution::DynamicResolution(int width, int height, float minScale, float maxScale, float frameBudget, float sharpness, int samples)
+    : _width(width)
+    , _height(height)
+    , _minScale(std::max(0.1f, std::min(minScale, maxScale)))
+    , _maxScale(std::max(_minScale, maxScale))
+    , _scale(_maxScale)
+    , _frameBudget(frameBudget)
+    , _sharpness(std::max(0.0f, std::min(sharpness, 1.0f)))
+    , _gpuTime(0.0f)
+    , _frame(0)
+    , _viewportWidth(0)
+    , _viewportHeight(0)
+    , _lastLogTime(0.0) {
+    _maxWidth = int(std::ceil(width * _maxScale / SIZE_GRANULARITY)) * SIZE_GRANULARITY;
+    _maxHeight = int(std::ceil(height * _maxScale / SIZE_GRANULARITY)) * SIZE_GRANULARITY;
+    _upscaleShader = std::make_shared<Shader>("assets/shaders/upscale.vert", "assets/shaders/upscale.frag");
+
+    // multisampled scene target
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, _maxWidth, _maxHeight);
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, _maxWidth, _maxHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_sceneFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Dynamic resolution scene framebuffer is incomplete" << std::endl;
+    }
+
+    // single-sampled copy, bilinear filtering is part of the upscale
+    glGenTextures(1, &_resolveTexture);
+    glBindTexture(GL_TEXTURE_2D, _resolveTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _maxWidth, _maxHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &_resolveFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _resolveFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _resolveTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Dynamic resolution resolve framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // the fullscreen triangle is generated from gl_VertexID, but core profile still needs a vertex array
+    glGenVertexArrays(1, &_emptyVao);
+
+    glGenQueries(QUERY_FRAMES, _queries);
+    for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+        _queryIssued[i] = false;
+        _queryWidth[i] = _queryHeight[i] = 0;
+    }
+}
+
+DynamicResolution::~DynamicResolution() {
+    glDeleteQueries(QUERY_FRAMES, _queries);
+    glDeleteVertexArrays(1, &_emptyVao);
+    glDeleteFramebuffers(1, &_resolveFbo);
+    glDeleteTextures(1, &_resolveTexture);
+    glDeleteFramebuffers(1, &_sceneFbo);
+    glDeleteRenderbuffers(1, &_depthBuffer);
+    glDeleteRenderbuffers(1, &_colorBuffer);
+}
+
+void DynamicResolution::updateScale() {
+    // the query issued QUERY_FRAMES frames ago is usually done, it is skipped instead of waited for if not
+    unsigned int slot = _frame % QUERY_FRAMES;
+    if (!_queryIssued[slot])
+        return;
+    GLint available = 0;
+    glGetQueryObjectiv(_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    _queryIssued[slot] = false;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(_queries[slot], GL_QUERY_RESULT, &elapsed);
+    float time = float(elapsed) * 1e-9f;
+    _gpuTime = _gpuTime == 0.0f ? time : _gpuTime + (time - _gpuTime) * 0.1f;
+    if (time <= 0.0f)
+        return;
+
+    // the cost is roughly proportional to the pixel count, i.e. to the squared scale of the measured frame
+    float measuredScale = std::sqrt(float(_queryWidth[slot]) * float(_queryHeight[slot]) / (float(_width) * float(_height)));
+    float targetScale = std::max(_minScale, std::min(measuredScale * std::sqrt(_frameBudget / time), _maxScale));
+    if (std::abs(targetScale - _scale) > SCALE_DEAD_ZONE) {
+        _scale += (targetScale - _scale) * SCALE_RESPONSE;
+    }
+}
+
+void DynamicResolution::begin() {
+    updateScale();
+
+    _viewportWidth = scaledSize(_width, _scale, _maxWidth);
+    _viewportHeight = scaledSize(_height, _scale, _maxHeight);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFbo);
+    glViewport(0, 0, _viewportWidth, _viewportHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // a query that is still not done after QUERY_FRAMES frames is restarted, its result is dropped
+    unsigned int slot = _frame % QUERY_FRAMES;
+    glBeginQuery(GL_TIME_ELAPSED, _queries[slot]);
+    _queryIssued[slot] = true;
+    _queryWidth[slot] = _viewportWidth;
+    _queryHeight[slot] = _viewportHeight;
+}
+
+void DynamicResolution::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+    _frame++;
+
+    // resolve the used part of the multisampled buffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _sceneFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _resolveFbo);
+    glBlitFramebuffer(0, 0, _viewportWidth, _viewportHeight, 0, 0, _viewportWidth, _viewportHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, _width, _height);
+
+    // the fullscreen pass ignores the scene's render state
+    GLint polygonMode[2];
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+
+    _upscaleShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _resolveTexture);
+    _upscaleShader->setUniform("source", 0);
+    _upscaleShader->setUniform("source_size", glm::vec2(float(_viewportWidth), float(_viewportHeight)));
+    _upscaleShader->setUniform("texture_size", glm::vec2(float(_maxWidth), float(_maxHeight)));
+    _upscaleShader->setUniform("sharpness", _sharpness);
+    glBindVertexArray(_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glPolygonMode(GL_FRONT_AND_BACK, GLenum(polygonMode[0]));
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+    if (cullFace)
+        glEnable(GL_CULL_FACE);
+}
+
+void DynamicResolution::logStatistics(double time) {
+    if (time - _lastLogTime < 1.0)
+        return;
+    _lastLogTime = time;
+
+    std::cout << "Dynamic resolution: " << _viewportWidth << "x" << _viewportHeight << " (" << int(_scale * 100.0f + 0.5f) << "%), GPU "
+              << _gpuTime * 1000.0f << " ms of " << _frameBudget * 1000.0f << " ms" << std::endl;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Shader.h"
+#include <GL/glew.h>
+#include <memory>
+
+/*!
+ * Renders the scene into an offscreen framebuffer whose resolution follows the GPU frame time
+ * The framebuffer is allocated once at the maximum scale, lower scales only render into a smaller viewport of it.
+ * The GPU time of every frame is measured with a timer query. The results are read a few frames later, so the CPU
+ * never waits for the GPU. A controller scales the resolution so the measured time approaches the frame budget.
+ * The multisampled image is resolved and upscaled to the backbuffer with a contrast-adaptive sharpening filter.
+ */
+class DynamicResolution {
+  protected:
+    /*!
+     * Number of frames in flight, a timer query is read back this many frames after it was issued
+     */
+    static const unsigned int QUERY_FRAMES = 4;
+
+    int _width, _height;
+    int _maxWidth, _maxHeight;
+    float _minScale, _maxScale;
+    float _scale;
+    /*!
+     * GPU time per frame the controller aims for, in seconds
+     */
+    float _frameBudget;
+    float _sharpness;
+    /*!
+     * Smoothed GPU time of the scene pass, in seconds
+     */
+    float _gpuTime;
+
+    GLuint _sceneFbo, _colorBuffer, _depthBuffer;
+    GLuint _resolveFbo, _resolveTexture;
+    GLuint _emptyVao;
+    std::shared_ptr<Shader> _upscaleShader;
+
+    GLuint _queries[QUERY_FRAMES];
+    bool _queryIssued[QUERY_FRAMES];
+    /*!
+     * Scaled viewport size of the frame each query measured
+     */
+    int _queryWidth[QUERY_FRAMES], _queryHeight[QUERY_FRAMES];
+    unsigned int _frame;
+    int _viewportWidth, _viewportHeight;
+
+    double _lastLogTime;
+
+    /*!
+     * Reads finished timer queries and adjusts the scale
+     */
+    void updateScale();
+
+  public:
+    /*!
+     * Dynamic resolution constructor, creates the framebuffers and the upscaling shader
+     * @param width: width of the window
+     * @param height: height of the window
+     * @param minScale: lowest resolution scale per axis
+     * @param maxScale: highest resolution scale per axis
+     * @param frameBudget: GPU time per frame to aim for, in seconds
+     * @param sharpness: strength of the sharpening filter, from 0 to 1
+     * @param samples: number of MSAA samples of the scene framebuffer
+     */
+    DynamicResolution(int width, int height, float minScale, float maxScale, float frameBudget, float sharpness, int samples);
+    ~DynamicResolution();
+
+    /*!
+     * Binds and clears the scene framebuffer at the current scale and starts timing the frame
+     */
+    void begin();
+
+    /*!
+     * Stops timing, resolves the scene and upscales it to the default framebuffer
+     */
+    void end();
+
+    /*!
+     * @return the current resolution scale per axis
+     */
+    float getScale() const { return _scale; }
+
+    /*!
+     * @return the smoothed GPU time of the scene pass in seconds
+     */
+    float getGpuTime() const { return _gpuTime; }
+
+    /*!
+     * Prints the scale and GPU time at most once per second
+     * @param time: current time in seconds
+     */
+    void logStatistics(double time);
+};
@@ -0,0 +1,171 @@
+#include "EntityWorld.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#undef min
+#undef max
+
+namespace {
+
+ComponentInfo componentInfos[Archetype::MAX_COMPONENTS];
+unsigned int componentCount = 0;
+std::mutex componentMutex;
+
+size_t alignUp(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+unsigned int registerComponent(const ComponentInfo& info) {
+    std::lock_guard<std::mutex> lock(componentMutex);
+    if (componentCount == Archetype::MAX_COMPONENTS) {
+        std::cerr << "Too many component types, at most " << Archetype::MAX_COMPONENTS << " are supported" << std::endl;
+        std::abort();
+    }
+    componentInfos[componentCount] = info;
+    return componentCount++;
+}
+
+const ComponentInfo& getComponentInfo(unsigned int id) { return componentInfos[id]; }
+
+Archetype::Archetype(ComponentMask mask)
+    : _mask(mask)
+    , _capacity(0)
+    , _chunkBytes(CHUNK_SIZE) {
+    size_t rowSize = sizeof(Entity);
+    for (unsigned int id = 0; id < MAX_COMPONENTS; id++) {
+        _offsets[id] = 0;
+        if (hasComponent(id)) {
+            _components.push_back(id);
+            rowSize += getComponentInfo(id).size;
+        }
+    }
+
+    // as many rows as fit into a chunk once every array is aligned
+    auto layout = [&](unsigned int capacity) {
+        size_t offset = sizeof(Entity) * capacity;
+        for (unsigned int id : _components) {
+            const ComponentInfo& info = getComponentInfo(id);
+            offset = alignUp(offset, info.alignment);
+            _offsets[id] = offset;
+            offset += info.size * capacity;
+        }
+        return offset;
+    };
+    _capacity = std::max(1u, unsigned(CHUNK_SIZE / rowSize));
+    while (_capacity > 1 && layout(_capacity) > CHUNK_SIZE) {
+        _capacity--;
+    }
+    _chunkBytes = std::max(CHUNK_SIZE, layout(_capacity));
+}
+
+Archetype::~Archetype() {
+    for (Chunk& chunk : _chunks) {
+        for (unsigned int row = 0; row < chunk.count; row++) {
+            for (unsigned int id : _components) {
+                getComponentInfo(id).destroy(getComponent(chunk, id, row));
+            }
+        }
+    }
+}
+
+void Archetype::allocateRow(Entity entity, unsigned int& chunk, unsigned int& row) {
+    if (_chunks.empty() || _chunks.back().count == _capacity) {
+        Chunk newChunk;
+        newChunk.data.reset(new unsigned char[_chunkBytes]);
+        _chunks.push_back(std::move(newChunk));
+    }
+    chunk = static_cast<unsigned int>(_chunks.size() - 1);
+    row = _chunks.back().count++;
+    getEntities(_chunks.back())[row] = entity;
+}
+
+Entity Archetype::removeRow(unsigned int chunk, unsigned int row, bool destroyComponents) {
+    Chunk& target = _chunks[chunk];
+    if (destroyComponents) {
+        for (unsigned int id : _components) {
+            getComponentInfo(id).destroy(getComponent(target, id, row));
+        }
+    }
+
+    // keep the chunks packed, the last row fills the gap
+    Entity moved;
+    Chunk& last = _chunks.back();
+    unsigned int lastRow = last.count - 1;
+    if (&last != &target || lastRow != row) {
+        for (unsigned int id : _components) {
+            const ComponentInfo& info = getComponentInfo(id);
+            info.moveConstruct(getComponent(target, id, row), getComponent(last, id, lastRow));
+            info.destroy(getComponent(last, id, lastRow));
+        }
+        moved = getEntities(last)[lastRow];
+        getEntities(target)[row] = moved;
+    }
+    last.count--;
+    if (last.count == 0) {
+        _chunks.pop_back();
+    }
+    return moved;
+}
+
+Archetype& EntityWorld::getArchetype(ComponentMask mask) {
+    std::unique_ptr<Archetype>& archetype = _archetypes[mask];
+    if (!archetype) {
+        archetype.reset(new Archetype(mask));
+    }
+    return *archetype;
+}
+
+Entity EntityWorld::allocateEntity() {
+    Entity entity;
+    if (!_freeIndices.empty()) {
+        entity.index = _freeIndices.back();
+        _freeIndices.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(_records.size());
+        _records.emplace_back();
+    }
+    entity.generation = _records[entity.index].generation;
+    return entity;
+}
+
+void EntityWorld::fixRecord(Entity moved, unsigned int chunk, unsigned int row) {
+    if (moved.isValid()) {
+        _records[moved.index].chunk = chunk;
+        _records[moved.index].row = row;
+    }
+}
+
+void EntityWorld::moveEntity(Entity entity, Archetype& target) {
+    Record& record = _records[entity.index];
+    Archetype& source = *record.archetype;
+
+    unsigned int chunk, row;
+    target.allocateRow(entity, chunk, row);
+    Archetype::Chunk& from = source.getChunks()[record.chunk];
+    Archetype::Chunk& to = target.getChunks()[chunk];
+    for (unsigned int id : source.getComponents()) {
+        const ComponentInfo& info = getComponentInfo(id);
+        if (target.hasComponent(id)) {
+            info.moveConstruct(target.getComponent(to, id, row), source.getComponent(from, id, record.row));
+        }
+        info.destroy(source.getComponent(from, id, record.row));
+    }
+
+    fixRecord(source.removeRow(record.chunk, record.row, false), record.chunk, record.row);
+    record.archetype = &target;
+    record.chunk = chunk;
+    record.row = row;
+}
+
+void EntityWorld::destroy(Entity entity) {
+    if (!isAlive(entity))
+        return;
+    Record& record = _records[entity.index];
+    fixRecord(record.archetype->removeRow(record.chunk, record.row, true), record.chunk, record.row);
+    record.archetype = nullptr;
+    record.generation++;
+    _freeIndices.push_back(entity.index);
+}
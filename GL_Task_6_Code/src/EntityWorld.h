@@ -0,0 +1,291 @@
+#pragma once
+
+#include "Parallel.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+ * Handle to an entity, the generation detects handles of destroyed entities
+ */
+struct Entity {
+    uint32_t index = ~0u;
+    uint32_t generation = 0;
+
+    bool isValid() const { return index != ~0u; }
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+/*!
+ * Set of component types, bit i stands for the component with id i
+ */
+using ComponentMask = uint64_t;
+
+/*!
+ * Type-erased description of a component type
+ */
+struct ComponentInfo {
+    size_t size;
+    size_t alignment;
+    void (*moveConstruct)(void* destination, void* source);
+    void (*destroy)(void* component);
+};
+
+/*!
+ * Registers a component type
+ * @return the id of the component type
+ */
+unsigned int registerComponent(const ComponentInfo& info);
+
+/*!
+ * @return the description of a registered component type
+ */
+const ComponentInfo& getComponentInfo(unsigned int id);
+
+/*!
+ * @return the id of a component type, registered on first use
+ */
+template <typename T> unsigned int componentId() {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned components are not supported");
+    static const unsigned int id = registerComponent(ComponentInfo{
+        sizeof(T),
+        alignof(T),
+        [](void* destination, void* source) { new (destination) T(std::move(*static_cast<T*>(source))); },
+        [](void* component) { static_cast<T*>(component)->~T(); },
+    });
+    return id;
+}
+
+template <typename... Ts> ComponentMask componentMask() { return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<Ts>())); }
+
+/*!
+ * All entities with the same set of components
+ * The entities are stored in fixed-size chunks, every chunk holds one tightly packed array per component type.
+ */
+class Archetype {
+  public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    static constexpr unsigned int MAX_COMPONENTS = 64;
+
+    struct Chunk {
+        std::unique_ptr<unsigned char[]> data;
+        unsigned int count = 0;
+    };
+
+  protected:
+    ComponentMask _mask;
+    std::vector<unsigned int> _components;
+    /*!
+     * Byte offset of every component array inside a chunk, indexed by component id
+     */
+    size_t _offsets[MAX_COMPONENTS];
+    unsigned int _capacity;
+    size_t _chunkBytes;
+    std::vector<Chunk> _chunks;
+
+  public:
+    /*!
+     * Archetype constructor, computes the chunk layout
+     * @param mask: the component types of the archetype
+     */
+    explicit Archetype(ComponentMask mask);
+    ~Archetype();
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    /*!
+     * Appends an uninitialized row, the caller has to construct all components
+     * @param entity: the entity stored in the row
+     * @param chunk: receives the chunk of the row
+     * @param row: receives the row inside the chunk
+     */
+    void allocateRow(Entity entity, unsigned int& chunk, unsigned int& row);
+
+    /*!
+     * Removes a row by moving the last row into it
+     * @param chunk: chunk of the row
+     * @param row: row inside the chunk
+     * @param destroyComponents: false if the components were already moved out and destroyed
+     * @return the entity that was moved into the row, or an invalid entity if the last row was removed
+     */
+    Entity removeRow(unsigned int chunk, unsigned int row, bool destroyComponents);
+
+    ComponentMask getMask() const { return _mask; }
+    bool hasComponent(unsigned int id) const { return (_mask >> id) & 1u; }
+    const std::vector<unsigned int>& getComponents() const { return _components; }
+    unsigned int getCapacity() const { return _capacity; }
+    std::vector<Chunk>& getChunks() { return _chunks; }
+
+    Entity* getEntities(Chunk& chunk) { return reinterpret_cast<Entity*>(chunk.data.get()); }
+    void* getComponent(Chunk& chunk, unsigned int id, unsigned int row) { return chunk.data.get() + _offsets[id] + row * getComponentInfo(id).size; }
+    template <typename T> T* getArray(Chunk& chunk) { return reinterpret_cast<T*>(chunk.data.get() + _offsets[componentId<T>()]); }
+};
+
+/*!
+ * Entity component system with archetype storage
+ * Entities with the same component types share an archetype, so queries iterate tightly packed component arrays.
+ * Structural changes (create, destroy, add, remove) must not happen while a query is running.
+ */
+class EntityWorld {
+  protected:
+    struct Record {
+        Archetype* archetype = nullptr;
+        unsigned int chunk = 0, row = 0;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Record> _records;
+    std::vector<uint32_t> _freeIndices;
+    std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> _archetypes;
+
+    Archetype& getArchetype(ComponentMask mask);
+    Entity allocateEntity();
+    /*!
+     * Moves an entity into another archetype, components missing in the new archetype are destroyed
+     * Components that are new in the target archetype are left uninitialized.
+     */
+    void moveEntity(Entity entity, Archetype& target);
+    void fixRecord(Entity moved, unsigned int chunk, unsigned int row);
+
+    template <typename F, typename... Ts, size_t... Is>
+    static void eachInChunk(Archetype& archetype, Archetype::Chunk& chunk, F& func, std::index_sequence<Is...>) {
+        Entity* entities = archetype.getEntities(chunk);
+        std::tuple<Ts*...> arrays(archetype.getArray<Ts>(chunk)...);
+        for (unsigned int i = 0; i < chunk.count; i++) {
+            func(entities[i], std::get<Is>(arrays)[i]...);
+        }
+    }
+
+  public:
+    EntityWorld() = default;
+    EntityWorld(const EntityWorld&) = delete;
+    EntityWorld& operator=(const EntityWorld&) = delete;
+
+    /*!
+     * Creates an entity
+     * @param components: the initial components of the entity, of distinct types
+     * @return the new entity
+     */
+    template <typename... Ts> Entity create(Ts&&... components) {
+        Entity entity = allocateEntity();
+        Archetype& archetype = getArchetype(componentMask<std::decay_t<Ts>...>());
+        Record& record = _records[entity.index];
+        record.archetype = &archetype;
+        archetype.allocateRow(entity, record.chunk, record.row);
+        Archetype::Chunk& chunk = archetype.getChunks()[record.chunk];
+        (new (archetype.getComponent(chunk, componentId<std::decay_t<Ts>>(), record.row)) std::decay_t<Ts>(std::forward<Ts>(components)), ...);
+        return entity;
+    }
+
+    /*!
+     * Destroys an entity and all its components
+     */
+    void destroy(Entity entity);
+
+    /*!
+     * @return whether the entity exists
+     */
+    bool isAlive(Entity entity) const { return entity.index < _records.size() && _records[entity.index].generation == entity.generation && _records[entity.index].archetype; }
+
+    /*!
+     * @return the component of an entity, or nullptr if the entity has no such component
+     */
+    template <typename T> T* get(Entity entity) {
+        if (!isAlive(entity))
+            return nullptr;
+        Record& record = _records[entity.index];
+        if (!record.archetype->hasComponent(componentId<T>()))
+            return nullptr;
+        return &record.archetype->getArray<T>(record.archetype->getChunks()[record.chunk])[record.row];
+    }
+
+    template <typename T> const T* get(Entity entity) const { return const_cast<EntityWorld*>(this)->get<T>(entity); }
+
+    /*!
+     * Adds a component to an entity (or replaces it), moving the entity into another archetype
+     * @return the added component
+     */
+    template <typename T> T& add(Entity entity, T component) {
+        if (T* existing = get<T>(entity)) {
+            *existing = std::move(component);
+            return *existing;
+        }
+        Record& record = _records[entity.index];
+        moveEntity(entity, getArchetype(record.archetype->getMask() | componentMask<T>()));
+        T* added = &record.archetype->getArray<T>(record.archetype->getChunks()[record.chunk])[record.row];
+        new (added) T(std::move(component));
+        return *added;
+    }
+
+    /*!
+     * Removes a component from an entity, moving the entity into another archetype
+     */
+    template <typename T> void remove(Entity entity) {
+        if (!get<T>(entity))
+            return;
+        Record& record = _records[entity.index];
+        moveEntity(entity, getArchetype(record.archetype->getMask() & ~componentMask<T>()));
+    }
+
+    /*!
+     * Calls func(Entity, Ts&...) for every entity that has all components Ts, chunk by chunk
+     */
+    template <typename... Ts, typename F> void each(F&& func) {
+        ComponentMask mask = componentMask<Ts...>();
+        for (auto& entry : _archetypes) {
+            Archetype& archetype = *entry.second;
+            if ((archetype.getMask() & mask) != mask)
+                continue;
+            for (Archetype::Chunk& chunk : archetype.getChunks()) {
+                eachInChunk<F, Ts...>(archetype, chunk, func, std::index_sequence_for<Ts...>());
+            }
+        }
+    }
+
+    /*!
+     * Like each(), but distributes the chunks over worker threads
+     * func is called concurrently and may only write to the components it is given.
+     */
+    template <typename... Ts, typename F> void parallelEach(F&& func) {
+        parallelEachWith<Ts...>([]() { return 0; }, [&](int, Entity entity, Ts&... components) { func(entity, components...); });
+    }
+
+    /*!
+     * Like parallelEach(), with a context per worker range
+     * makeContext() is called once per range of chunks (at most getWorkerThreadCount() times),
+     * its result is passed to func(context, Entity, Ts&...) for every entity of the range.
+     * This allows per-thread outputs without locking.
+     */
+    template <typename... Ts, typename C, typename F> void parallelEachWith(C&& makeContext, F&& func) {
+        ComponentMask mask = componentMask<Ts...>();
+        std::vector<std::pair<Archetype*, Archetype::Chunk*>> chunks;
+        for (auto& entry : _archetypes) {
+            Archetype& archetype = *entry.second;
+            if ((archetype.getMask() & mask) != mask)
+                continue;
+            for (Archetype::Chunk& chunk : archetype.getChunks()) {
+                chunks.emplace_back(&archetype, &chunk);
+            }
+        }
+        parallelFor(static_cast<unsigned int>(chunks.size()), [&](unsigned int begin, unsigned int end) {
+            auto context = makeContext();
+            auto visit = [&](Entity entity, Ts&... components) { func(context, entity, components...); };
+            for (unsigned int i = begin; i < end; i++) {
+                eachInChunk<decltype(visit), Ts...>(*chunks[i].first, *chunks[i].second, visit, std::index_sequence_for<Ts...>());
+            }
+        });
+    }
+
+    /*!
+     * @return the number of living entities
+     */
+    unsigned int getEntityCount() const { return static_cast<unsigned int>(_records.size() - _freeIndices.size()); }
+};
@@ -0,0 +1,144 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Full range BT.601 as expected by C420jpeg, the chroma of each 2x2 block is averaged
+ * The rows of the image are bottom to top, the planes top to bottom.
+ */
+void convertToI420(const Image& image, std::vector<uint8_t>& planes) {
+    unsigned int width = image.width, height = image.height;
+    unsigned int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    planes.resize(size_t(width) * height + size_t(chromaWidth) * chromaHeight * 2);
+    uint8_t* lumaPlane = planes.data();
+    uint8_t* cbPlane = lumaPlane + size_t(width) * height;
+    uint8_t* crPlane = cbPlane + size_t(chromaWidth) * chromaHeight;
+
+    auto pixel = [&](unsigned int x, unsigned int y) { return &image.pixels[(size_t(height - 1 - y) * width + x) * 4]; };
+
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            const uint8_t* p = pixel(x, y);
+            lumaPlane[size_t(y) * width + x] = uint8_t(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+        }
+    }
+    for (unsigned int y = 0; y < chromaHeight; y++) {
+        for (unsigned int x = 0; x < chromaWidth; x++) {
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            unsigned int count = 0;
+            for (unsigned int dy = 0; dy < 2 && y * 2 + dy < height; dy++) {
+                for (unsigned int dx = 0; dx < 2 && x * 2 + dx < width; dx++) {
+                    const uint8_t* p = pixel(x * 2 + dx, y * 2 + dy);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            cbPlane[size_t(y) * chromaWidth + x] = uint8_t(std::clamp(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f, 255.0f));
+            crPlane[size_t(y) * chromaWidth + x] = uint8_t(std::clamp(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+} // namespace
+
+Y4MWriter::Y4MWriter(const std::string& filepath, unsigned int frameRate)
+    : _file(std::fopen(filepath.c_str(), "wb"))
+    , _frameRate(std::max(1u, frameRate))
+    , _width(0)
+    , _height(0)
+    , _nextFrame(0) {
+    if (!_file) {
+        std::cerr << "Could not write video " << filepath << std::endl;
+    }
+}
+
+Y4MWriter::~Y4MWriter() {
+    if (!_file)
+        return;
+    for (auto& frame : _pending) {
+        if (frame.second.empty())
+            continue;
+        std::fputs("FRAME\n", _file);
+        std::fwrite(frame.second.data(), 1, frame.second.size(), _file);
+    }
+    std::fclose(_file);
+}
+
+void Y4MWriter::writeHeader(unsigned int width, unsigned int height) {
+    _width = width;
+    _height = height;
+    std::fprintf(_file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, _frameRate);
+}
+
+void Y4MWriter::writeFrame(unsigned int index, const Image& image) {
+    if (!_file)
+        return;
+
+    // the expensive part runs outside the lock
+    std::vector<uint8_t> planes;
+    convertToI420(image, planes);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_width == 0) {
+        writeHeader(image.width, image.height);
+    } else if (image.width != _width || image.height != _height) {
+        std::cerr << "Video frame " << index << " has a different size, it is skipped" << std::endl;
+        planes.clear();
+    }
+    _pending.emplace(index, std::move(planes));
+
+    while (!_pending.empty() && _pending.begin()->first == _nextFrame) {
+        std::vector<uint8_t>& frame = _pending.begin()->second;
+        if (!frame.empty()) {
+            std::fputs("FRAME\n", _file);
+            std::fwrite(frame.data(), 1, frame.size(), _file);
+        }
+        _pending.erase(_pending.begin());
+        _nextFrame++;
+    }
+}
+
+FrameCapture::FrameCapture(const std::string& path, unsigned int frameRate, const std::string& imageFormat, unsigned int encoderThreads)
+    : _path(path)
+    , _imageFormat(imageFormat)
+    , _encoderThreads(encoderThreads)
+    , _frameCount(0) {
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    std::error_code error;
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (extension == ".y4m") {
+        _video = std::make_shared<Y4MWriter>(path, frameRate);
+    }
+}
+
+ImageWriter::Encoder FrameCapture::nextFrame() {
+    unsigned int index = _frameCount++;
+    if (_video) {
+        std::shared_ptr<Y4MWriter> video = _video;
+        return [video, index](const Image& image) { video->writeFrame(index, image); };
+    }
+
+    char number[16];
+    std::snprintf(number, sizeof(number), "_%06u", index);
+    std::string filepath = _path + number + "." + _imageFormat;
+    unsigned int threads = _encoderThreads;
+    return [filepath, threads](const Image& image) { writeImage(image, filepath, threads); };
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ImageWriter.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+ * Writes frames to a YUV4MPEG2 (.y4m) video with 4:2:0 chroma subsampling
+ * The color conversion of several frames may run concurrently, frames that finish early wait in memory until all
+ * frames before them are written.
+ */
+class Y4MWriter {
+  protected:
+    FILE* _file;
+    unsigned int _frameRate;
+    unsigned int _width, _height;
+    unsigned int _nextFrame;
+    std::map<unsigned int, std::vector<uint8_t>> _pending;
+    std::mutex _mutex;
+
+    void writeHeader(unsigned int width, unsigned int height);
+
+  public:
+    /*!
+     * Y4M writer constructor
+     * @param filepath: the output file
+     * @param frameRate: frames per second stored in the header
+     */
+    Y4MWriter(const std::string& filepath, unsigned int frameRate);
+    /*!
+     * Writes the frames still waiting for a missing predecessor and closes the file
+     */
+    ~Y4MWriter();
+
+    Y4MWriter(const Y4MWriter&) = delete;
+    Y4MWriter& operator=(const Y4MWriter&) = delete;
+
+    /*!
+     * Converts a frame and writes it in order, may be called on several threads at once
+     * @param index: position of the frame in the video, counting from 0 without gaps
+     * @param image: the frame, all frames need the size of the first one
+     */
+    void writeFrame(unsigned int index, const Image& image);
+};
+
+/*!
+ * Streams every rendered frame to disk, either as numbered images or as Y4M video
+ * Provides the encoder for each frame, the frames are read back by FrameReadback and written by the ImageWriter's threads.
+ */
+class FrameCapture {
+  protected:
+    std::string _path;
+    std::string _imageFormat;
+    unsigned int _encoderThreads;
+    std::shared_ptr<Y4MWriter> _video;
+    unsigned int _frameCount;
+
+  public:
+    /*!
+     * Frame capture constructor, missing directories of the path are created
+     * @param path: a .y4m file for video, otherwise the prefix of the numbered images
+     * @param frameRate: frames per second of the video
+     * @param imageFormat: extension of the numbered images, "ppm", "png" or "qoi"
+     * @param encoderThreads: number of threads encoding one image, see ImageWriter::getEncoderThreadCount()
+     */
+    FrameCapture(const std::string& path, unsigned int frameRate, const std::string& imageFormat = "ppm", unsigned int encoderThreads = 1);
+
+    /*!
+     * @return the encoder of the next frame, it keeps the video open until it ran
+     */
+    ImageWriter::Encoder nextFrame();
+
+    /*!
+     * @return number of frames captured so far
+     */
+    unsigned int getFrameCount() const { return _frameCount; }
+};
@@ -0,0 +1,79 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#undef min
+#undef max
+
+FramePacer::FramePacer(double frameRateLimit, double spinTime, unsigned int historySize)
+    : _period(frameRateLimit > 0.0 ? 1.0 / frameRateLimit : 0.0)
+    , _spinTime(spinTime)
+    , _epoch(Clock::now())
+    , _deadline(0.0)
+    , _lastFrameStart(-1.0)
+    , _frameTimes(std::max(1u, historySize), 0.0)
+    , _nextFrameTime(0)
+    , _frameTimeCount(0)
+    , _lastLogTime(0.0) {}
+
+void FramePacer::waitForNextFrame() {
+    if (_period > 0.0) {
+        double remaining = _deadline - now();
+        if (remaining > _spinTime) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - _spinTime));
+        }
+        while (now() < _deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    double start = now();
+    if (_period > 0.0) {
+        // keep the phase, unless the frame was late by more than a whole period
+        _deadline = start - _deadline > _period ? start + _period : _deadline + _period;
+    }
+    if (_lastFrameStart >= 0.0) {
+        _frameTimes[_nextFrameTime] = start - _lastFrameStart;
+        _nextFrameTime = (_nextFrameTime + 1) % _frameTimes.size();
+        _frameTimeCount = std::min(_frameTimeCount + 1, unsigned(_frameTimes.size()));
+    }
+    _lastFrameStart = start;
+}
+
+FrameStatistics FramePacer::getStatistics() const {
+    FrameStatistics statistics;
+    if (_frameTimeCount == 0)
+        return statistics;
+
+    statistics.frames = _frameTimeCount;
+    statistics.minimum = _frameTimes[0];
+    statistics.maximum = _frameTimes[0];
+    double sum = 0.0;
+    for (unsigned int i = 0; i < _frameTimeCount; i++) {
+        sum += _frameTimes[i];
+        statistics.minimum = std::min(statistics.minimum, _frameTimes[i]);
+        statistics.maximum = std::max(statistics.maximum, _frameTimes[i]);
+    }
+    statistics.average = sum / _frameTimeCount;
+
+    double squares = 0.0;
+    for (unsigned int i = 0; i < _frameTimeCount; i++) {
+        double difference = _frameTimes[i] - statistics.average;
+        squares += difference * difference;
+    }
+    statistics.deviation = std::sqrt(squares / _frameTimeCount);
+    return statistics;
+}
+
+void FramePacer::logStatistics(double time) {
+    if (time - _lastLogTime < 1.0)
+        return;
+    _lastLogTime = time;
+
+    FrameStatistics statistics = getStatistics();
+    std::cout << "Frame time: " << statistics.average * 1000.0 << " ms avg, " << statistics.deviation * 1000.0 << " ms jitter, "
+              << statistics.minimum * 1000.0 << " - " << statistics.maximum * 1000.0 << " ms over " << statistics.frames << " frames" << std::endl;
+}
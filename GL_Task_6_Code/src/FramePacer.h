@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+/*!
+ * Frame time statistics over the recent frames, in seconds
+ */
+struct FrameStatistics {
+    double average = 0.0;
+    /*!
+     * Standard deviation of the frame times, the frame-to-frame jitter
+     */
+    double deviation = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+    unsigned int frames = 0;
+};
+
+/*!
+ * Starts frames at a steady rate and measures how steady they really are
+ * The optional frame rate limit sleeps until shortly before the deadline and spins for the rest,
+ * because the OS sleep alone overshoots by up to a scheduler tick.
+ * The caller should sample input right after waitForNextFrame(), so the wait does not add to the input latency.
+ */
+class FramePacer {
+  protected:
+    using Clock = std::chrono::steady_clock;
+
+    /*!
+     * Target frame time, 0 if the frame rate is not limited
+     */
+    double _period;
+    /*!
+     * Time before the deadline at which sleeping is replaced by spinning
+     */
+    double _spinTime;
+    Clock::time_point _epoch;
+    double _deadline;
+    double _lastFrameStart;
+
+    std::vector<double> _frameTimes;
+    unsigned int _nextFrameTime;
+    unsigned int _frameTimeCount;
+
+    double _lastLogTime;
+
+    double now() const { return std::chrono::duration<double>(Clock::now() - _epoch).count(); }
+
+  public:
+    /*!
+     * Frame pacer constructor
+     * @param frameRateLimit: maximum frames per second, 0 to only record statistics
+     * @param spinTime: time in seconds before the deadline that is spent spinning instead of sleeping
+     * @param historySize: number of frames the statistics are computed over
+     */
+    FramePacer(double frameRateLimit, double spinTime = 0.002, unsigned int historySize = 120);
+
+    /*!
+     * Waits until the next frame may start and records the time since the last frame start
+     */
+    void waitForNextFrame();
+
+    /*!
+     * @return the statistics of the recent frames
+     */
+    FrameStatistics getStatistics() const;
+
+    /*!
+     * Prints the statistics at most once per second
+     * @param time: current time in seconds
+     */
+    void logStatistics(double time);
+};
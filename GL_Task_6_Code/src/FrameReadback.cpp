@@ -0,0 +1,96 @@
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#undef min
+#undef max
+
+FrameReadback::FrameReadback(ImageWriter& writer, unsigned int slotCount)
+    : _writer(writer)
+    , _slots(std::max(1u, slotCount))
+    , _next(0)
+    , _stalls(0) {
+    for (Slot& slot : _slots) {
+        glGenBuffers(1, &slot.buffer);
+    }
+}
+
+FrameReadback::~FrameReadback() {
+    flush();
+    for (Slot& slot : _slots) {
+        glDeleteBuffers(1, &slot.buffer);
+    }
+}
+
+bool FrameReadback::complete(Slot& slot, bool wait) {
+    if (!slot.fence)
+        return true;
+
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    Image image = _writer.acquireImage(slot.width, slot.height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(image.pixels.size()), GL_MAP_READ_BIT);
+    if (pixels) {
+        std::memcpy(image.pixels.data(), pixels, image.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        // the encoder still gets its frame, a video waits for every index before it writes the next ones
+        std::cerr << "Could not map a captured frame, a black frame is written instead" << std::endl;
+        std::fill(image.pixels.begin(), image.pixels.end(), uint8_t(0));
+    }
+    _writer.write(std::move(image), std::move(slot.encoder));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void FrameReadback::capture(unsigned int width, unsigned int height, const std::string& filepath) {
+    unsigned int threads = _writer.getEncoderThreadCount();
+    capture(width, height, [filepath, threads](const Image& image) { writeImage(image, filepath, threads); });
+}
+
+void FrameReadback::capture(unsigned int width, unsigned int height, ImageWriter::Encoder encoder) {
+    Slot& slot = _slots[_next];
+    if (slot.fence) {
+        // the whole ring is in flight
+        _stalls++;
+        complete(slot, true);
+    }
+    _next = (_next + 1) % _slots.size();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    GLsizeiptr size = GLsizeiptr(width) * height * 4;
+    if (slot.size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.size = size;
+    }
+    // RGBA rows are always 4-byte aligned, the copy stays on the driver's fast path
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.encoder = std::move(encoder);
+}
+
+void FrameReadback::update() {
+    // the copies finish in order, starting with the oldest
+    for (unsigned int i = 0; i < _slots.size(); i++) {
+        if (!complete(_slots[(_next + i) % _slots.size()], false))
+            return;
+    }
+}
+
+void FrameReadback::flush() {
+    for (unsigned int i = 0; i < _slots.size(); i++) {
+        complete(_slots[(_next + i) % _slots.size()], true);
+    }
+}
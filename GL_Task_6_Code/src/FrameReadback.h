@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ImageWriter.h"
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+/*!
+ * Reads back the framebuffer without stalling the pipeline
+ * capture() only starts an asynchronous copy into one of a ring of pixel pack buffers and puts a fence behind it.
+ * update() maps the buffers whose fence has passed, usually a frame or two later, and hands the pixels to the
+ * image writer's thread. Only when all buffers of the ring are still in flight does capture() have to wait.
+ * All methods have to be called on the thread that owns the GL context.
+ */
+class FrameReadback {
+  protected:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsizeiptr size = 0;
+        /*!
+         * Fence behind the copy, nullptr while the slot is free
+         */
+        GLsync fence = nullptr;
+        unsigned int width = 0, height = 0;
+        ImageWriter::Encoder encoder;
+    };
+
+    ImageWriter& _writer;
+    std::vector<Slot> _slots;
+    /*!
+     * Slot the next capture uses, also the oldest one in flight
+     */
+    unsigned int _next;
+    unsigned int _stalls;
+
+    /*!
+     * Maps a slot's buffer and queues its pixels for writing
+     * @param wait: whether to wait for the copy, otherwise nothing happens if it has not finished yet
+     * @return whether the slot is free now
+     */
+    bool complete(Slot& slot, bool wait);
+
+  public:
+    /*!
+     * Frame readback constructor
+     * @param writer: receives the read back images
+     * @param slotCount: number of captures that can be in flight at once
+     */
+    explicit FrameReadback(ImageWriter& writer, unsigned int slotCount = 3);
+    ~FrameReadback();
+
+    FrameReadback(const FrameReadback&) = delete;
+    FrameReadback& operator=(const FrameReadback&) = delete;
+
+    /*!
+     * Starts reading back a region of the read framebuffer
+     * @param width: region width, from the lower left corner
+     * @param height: region height, from the lower left corner
+     * @param filepath: the file the image is written to, its extension selects the format (see writeImage())
+     */
+    void capture(unsigned int width, unsigned int height, const std::string& filepath);
+
+    /*!
+     * Starts reading back a region of the read framebuffer
+     * @param width: region width, from the lower left corner
+     * @param height: region height, from the lower left corner
+     * @param encoder: receives the image on one of the writer's threads
+     */
+    void capture(unsigned int width, unsigned int height, ImageWriter::Encoder encoder);
+
+    /*!
+     * Hands finished captures to the writer, never waits
+     */
+    void update();
+
+    /*!
+     * Waits for all captures in flight and hands them to the writer
+     */
+    void flush();
+
+    /*!
+     * @return number of captures that had to wait for an older one
+     */
+    unsigned int getStallCount() const { return _stalls; }
+};
@@ -5,14 +5,15 @@
  */
 
 #include "Geometry.h"
+#include "Components.h"
+#include "GpuProfiler.h"
 
 #undef min
 #undef max
 
-Geometry::Geometry(glm::mat4 modelMatrix, const GeometryData& data, std::shared_ptr<Material> material)
-    : elements{static_cast<unsigned int>(data.indices.size())}
-    , modelMatrix{modelMatrix}
-    , material{material} {
+Geometry::Geometry(SceneGraph& scene, EntityWorld& entities, glm::mat4 modelMatrix, const GeometryData& data, std::shared_ptr<Material> material, NodeId parent)
+    : node{scene, modelMatrix, parent}
+    , entities{&entities} {
     // create VAO
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
@@ -56,8 +57,26 @@ Geometry::Geometry(glm::mat4 modelMatrix, const GeometryData& data, std::shared_
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndices);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
 
+    glBindVertexArray(0);
+
+    // create a position-only VAO sharing the position and index buffers
+    glGenVertexArrays(1, &vaoDepth);
+    glBindVertexArray(vaoDepth);
+    glBindBuffer(GL_ARRAY_BUFFER, vboPositions);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIndices);
+
     glBindVertexArray(0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    AABB localBounds = AABB::fromPoints(data.positions);
+    entity = entities.create(
+        TransformComponent{node.getId()},
+        RenderableComponent{vao, vaoDepth, static_cast<unsigned int>(data.indices.size())},
+        MaterialComponent{material},
+        BoundsComponent{localBounds, localBounds.transformed(node.getWorldMatrix())}
+    );
 }
 
 Geometry::~Geometry() {
@@ -66,24 +85,79 @@ Geometry::~Geometry() {
     glDeleteBuffers(1, &vboUVs);
     glDeleteBuffers(1, &vboIndices);
     glDeleteVertexArrays(1, &vao);
+    glDeleteVertexArrays(1, &vaoDepth);
+    entities->destroy(entity);
 }
 
-void Geometry::draw() {
-    Shader* shader = material->getShader();
+void Geometry::draw(uint32_t shaderFeatures) {
+    GpuScope scope(GpuProfiler::getDrawProfiler(), "Geometry::draw");
+    const RenderableComponent& renderable = *entities->get<RenderableComponent>(entity);
+    Material* material = entities->get<MaterialComponent>(entity)->material.get();
+    Shader* shader = material->getShader(shaderFeatures);
     shader->use();
 
-    shader->setUniform("modelMatrix", modelMatrix);
-    shader->setUniform("normalMatrix", glm::mat3(glm::transpose(glm::inverse(modelMatrix))));
-    material->setUniforms();
+    shader->setUniform("modelMatrix", node.getWorldMatrix());
+    shader->setUniform("normalMatrix", node.getNormalMatrix());
+    material->setUniforms(*shader);
 
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, elements, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(renderable.vao);
+    glDrawElements(GL_TRIANGLES, renderable.elements, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+void Geometry::drawDepth(Shader& depthShader) {
+    const RenderableComponent& renderable = *entities->get<RenderableComponent>(entity);
+    depthShader.setUniform("modelMatrix", node.getWorldMatrix());
+
+    glBindVertexArray(renderable.vaoDepth);
+    glDrawElements(GL_TRIANGLES, renderable.elements, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 }
 
-void Geometry::transform(glm::mat4 transformation) { modelMatrix = transformation * modelMatrix; }
+void Geometry::transform(glm::mat4 transformation) { node.setLocalMatrix(transformation * node.getLocalMatrix()); }
+
+void Geometry::resetModelMatrix() { node.setLocalMatrix(glm::mat4(1)); }
+
+void Geometry::setEnabled(bool enabled) { entities->get<RenderableComponent>(entity)->enabled = enabled; }
+
+bool Geometry::isEnabled() const { return entities->get<RenderableComponent>(entity)->enabled; }
+
+unsigned int Geometry::getElementCount() const { return entities->get<RenderableComponent>(entity)->elements; }
+
+const glm::mat4& Geometry::getModelMatrix() const { return node.getWorldMatrix(); }
+
+const SceneNode& Geometry::getNode() const { return node; }
+
+Entity Geometry::getEntity() const { return entity; }
+
+AABB Geometry::getWorldBounds() const { return entities->get<BoundsComponent>(entity)->world; }
+
+DrawCommand Geometry::getDrawCommand() const {
+    const RenderableComponent& renderable = *entities->get<RenderableComponent>(entity);
+    Material* material = entities->get<MaterialComponent>(entity)->material.get();
+
+    DrawCommand command;
+    command.sortKey = 0;
+    command.depthKey = 0;
+    command.elements = renderable.elements;
+    command.vao = renderable.vao;
+    command.vaoDepth = renderable.vaoDepth;
+    command.shader = material->getShaderVariants();
+    command.material = material;
+    command.entity = entity;
+    command.worldBounds = getWorldBounds();
+    command.modelMatrix = node.getWorldMatrix();
+    command.normalMatrix = node.getNormalMatrix();
+    command.previousModelMatrix = node.getPreviousWorldMatrix();
+    return command;
+}
+
+void Geometry::setOccluder(const GeometryData& occluderData) {
+    occluder.positions = occluderData.positions;
+    occluder.indices = occluderData.indices;
+}
 
-void Geometry::resetModelMatrix() { modelMatrix = glm::mat4(1); }
+const OccluderMesh* Geometry::getOccluder() const { return occluder.indices.empty() ? nullptr : &occluder; }
 
 GeometryData Geometry::createCubeGeometry(float width, float height, float depth) {
     GeometryData data;
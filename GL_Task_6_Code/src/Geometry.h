@@ -6,8 +6,13 @@
 #pragma once
 
 
+#include "Bounds.h"
+#include "DrawList.h"
+#include "EntityWorld.h"
 #include "Material.h"
+#include "OcclusionCuller.h"
 #include "Shader.h"
+#include "SceneGraph.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -47,6 +52,10 @@ class Geometry {
      * Vertex array object
      */
     GLuint vao;
+    /*!
+     * Vertex array object that only binds the vertex positions (for depth-only passes)
+     */
+    GLuint vaoDepth;
     /*!
      * Vertex buffer object that stores the vertex positions
      */
@@ -71,39 +80,51 @@ class Geometry {
     GLuint vboIndices;
 
     /*!
-     * Number of elements to be rendered
+     * Scene graph node of the object, holds its model and normal matrix
      */
-    unsigned int elements;
+    SceneNode node;
 
     /*!
-     * Material of the geometry object
+     * Entity of the object, holds its transform, renderable, material and bounds components
      */
-    std::shared_ptr<Material> material;
+    EntityWorld* entities;
+    Entity entity;
 
     /*!
-     * Model matrix of the object
+     * Occluder used for software occlusion culling (empty if the object is no occluder)
      */
-    glm::mat4 modelMatrix;
+    OccluderMesh occluder;
 
   public:
     /*!
      * Geometry object constructor
      * Creates VAO and VBOs and binds them
-     * @param modelMatrix: model matrix of the object
+     * @param scene: scene graph the object is placed in
+     * @param entities: entity world the object's components are stored in
+     * @param modelMatrix: model matrix of the object, relative to the parent node
      * @param data: data for the geometry object
      * @param material: material of the geometry object
+     * @param parent: parent node of the object
      */
-    Geometry(glm::mat4 modelMatrix, const GeometryData& data, std::shared_ptr<Material> material);
+    Geometry(SceneGraph& scene, EntityWorld& entities, glm::mat4 modelMatrix, const GeometryData& data, std::shared_ptr<Material> material, NodeId parent = SceneGraph::NO_PARENT);
     ~Geometry();
 
     /*!
      * Draws the object
      * Uses the shader, sets the uniform and issues a draw call
+     * @param shaderFeatures: combination of ShaderFeature bits selecting the shader variant
+     */
+    void draw(uint32_t shaderFeatures = 0);
+
+    /*!
+     * Draws the object's depth only, using the position stream
+     * @param depthShader: the depth-only shader, with viewProjMatrix already set
      */
-    void draw();
+    void drawDepth(Shader& depthShader);
 
     /*!
-     * Transforms the object, i.e. updates the model matrix
+     * Transforms the object, i.e. updates the model matrix relative to the parent
+     * The world matrices are updated by the next SceneGraph::update().
      * @param transformation: the transformation matrix to be applied to the object
      */
     void transform(glm::mat4 transformation);
@@ -113,6 +134,59 @@ class Geometry {
      */
     void resetModelMatrix();
 
+    /*!
+     * Enables or disables the object in draw lists, it can still be drawn directly
+     * @param enabled: if the object is drawn
+     */
+    void setEnabled(bool enabled);
+
+    /*!
+     * @return if the object is drawn by draw lists
+     */
+    bool isEnabled() const;
+
+    /*!
+     * @return the number of indices drawn by the object
+     */
+    unsigned int getElementCount() const;
+
+    /*!
+     * @return the model (world) matrix of the object
+     */
+    const glm::mat4& getModelMatrix() const;
+
+    /*!
+     * @return the scene graph node of the object
+     */
+    const SceneNode& getNode() const;
+
+    /*!
+     * @return the entity of the object
+     */
+    Entity getEntity() const;
+
+    /*!
+     * @return the bounding box of the object in world space, as of the last updateWorldBounds()
+     */
+    AABB getWorldBounds() const;
+
+    /*!
+     * Records the object's draw call with its current world matrices, e.g. for replaying it on another thread
+     * @return the draw command, without sort keys
+     */
+    DrawCommand getDrawCommand() const;
+
+    /*!
+     * Marks the object as occluder for software occlusion culling
+     * @param occluderData: geometry that is rasterized as occluder, must lie inside the object (usually the object's own data)
+     */
+    void setOccluder(const GeometryData& occluderData);
+
+    /*!
+     * @return the occluder of the object or nullptr if it is no occluder
+     */
+    const OccluderMesh* getOccluder() const;
+
     /*!
      * Creates a cube geometry
      * @param width: width of the cube
@@ -0,0 +1,176 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+#undef min
+#undef max
+
+GpuProfiler* GpuProfiler::_drawProfiler = nullptr;
+
+GpuProfiler::GpuProfiler(unsigned int historySize, const std::string& csvPath)
+    : _frameNumber(0)
+    , _frameScope(0)
+    , _historySize(std::max(1u, historySize))
+    , _droppedFrames(0)
+    , _lastLogTime(0.0) {
+    if (!csvPath.empty()) {
+        _csv.open(csvPath);
+        if (_csv) {
+            _csv << "frame,scope,milliseconds\n";
+        } else {
+            std::cerr << "Could not open GPU profiler output " << csvPath << std::endl;
+        }
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    if (_drawProfiler == this) {
+        _drawProfiler = nullptr;
+    }
+    for (Frame& frame : _frames) {
+        if (!frame.queries.empty()) {
+            glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+        }
+    }
+}
+
+unsigned int GpuProfiler::writeTimestamp() {
+    Frame& frame = _frames[_frameNumber % FRAME_COUNT];
+    if (frame.usedQueries == frame.queries.size()) {
+        // the pool only grows, a frame with as many scopes as before allocates nothing
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    glQueryCounter(frame.queries[frame.usedQueries], GL_TIMESTAMP);
+    return frame.usedQueries++;
+}
+
+unsigned int GpuProfiler::getHistory(const char* name) {
+    auto entry = _historyIndices.find(name);
+    if (entry != _historyIndices.end())
+        return entry->second;
+
+    History history;
+    history.name = name;
+    history.samples.resize(_historySize, 0.0);
+    _histories.push_back(std::move(history));
+    unsigned int index = static_cast<unsigned int>(_histories.size() - 1);
+    _historyIndices.emplace(name, index);
+    return index;
+}
+
+void GpuProfiler::collect(Frame& frame) {
+    frame.pending = false;
+    if (frame.scopes.empty())
+        return;
+
+    // the queries complete in order, if the last one is done all of them are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        _droppedFrames++;
+        return;
+    }
+
+    std::vector<GLuint64> timestamps(frame.usedQueries);
+    for (unsigned int i = 0; i < frame.usedQueries; i++) {
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+
+    // sum the scopes of equal names, then record one sample per name
+    std::vector<unsigned int> touched;
+    for (const Scope& scope : frame.scopes) {
+        History& history = _histories[scope.history];
+        if (!history.touched) {
+            history.touched = true;
+            history.frameSum = 0.0;
+            touched.push_back(scope.history);
+        }
+        history.frameSum += double(timestamps[scope.endQuery] - timestamps[scope.beginQuery]) * 1e-6;
+    }
+    for (unsigned int index : touched) {
+        History& history = _histories[index];
+        history.touched = false;
+        history.samples[history.next] = history.frameSum;
+        history.next = (history.next + 1) % _historySize;
+        history.count = std::min(history.count + 1, _historySize);
+        if (_csv) {
+            _csv << frame.number << "," << history.name << "," << history.frameSum << "\n";
+        }
+    }
+}
+
+void GpuProfiler::beginFrame() {
+    Frame& frame = _frames[_frameNumber % FRAME_COUNT];
+    if (frame.pending) {
+        collect(frame);
+    }
+    frame.usedQueries = 0;
+    frame.scopes.clear();
+    frame.number = _frameNumber;
+    frame.pending = true;
+
+    _frameScope = beginScope("Frame");
+}
+
+void GpuProfiler::endFrame() {
+    endScope(_frameScope);
+    _frameNumber++;
+}
+
+unsigned int GpuProfiler::beginScope(const char* name) {
+    Frame& frame = _frames[_frameNumber % FRAME_COUNT];
+    Scope scope;
+    scope.history = getHistory(name);
+    scope.beginQuery = writeTimestamp();
+    scope.endQuery = scope.beginQuery;
+    frame.scopes.push_back(scope);
+    return static_cast<unsigned int>(frame.scopes.size() - 1);
+}
+
+void GpuProfiler::endScope(unsigned int scope) {
+    Frame& frame = _frames[_frameNumber % FRAME_COUNT];
+    frame.scopes[scope].endQuery = writeTimestamp();
+}
+
+std::vector<GpuScopeStatistics> GpuProfiler::getStatistics() const {
+    std::vector<GpuScopeStatistics> statistics;
+    for (const History& history : _histories) {
+        GpuScopeStatistics entry;
+        entry.name = history.name;
+        entry.samples = history.count;
+        if (history.count > 0) {
+            entry.minimum = history.samples[0];
+            entry.maximum = history.samples[0];
+            double sum = 0.0;
+            for (unsigned int i = 0; i < history.count; i++) {
+                sum += history.samples[i];
+                entry.minimum = std::min(entry.minimum, history.samples[i]);
+                entry.maximum = std::max(entry.maximum, history.samples[i]);
+            }
+            entry.average = sum / history.count;
+        }
+        statistics.push_back(entry);
+    }
+    return statistics;
+}
+
+void GpuProfiler::logStatistics(double time) {
+    if (time - _lastLogTime < 1.0)
+        return;
+    _lastLogTime = time;
+
+    std::cout << "GPU times (min / avg / max ms):";
+    for (const GpuScopeStatistics& entry : getStatistics()) {
+        std::cout << " | " << entry.name << " " << entry.minimum << " / " << entry.average << " / " << entry.maximum;
+    }
+    if (_droppedFrames > 0) {
+        std::cout << " | " << _droppedFrames << " frames dropped";
+    }
+    std::cout << std::endl;
+    if (_csv) {
+        _csv.flush();
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * Rolling GPU time of a scope over the recent frames, in milliseconds
+ * Scopes with the same name are summed per frame before they enter the statistics.
+ */
+struct GpuScopeStatistics {
+    std::string name;
+    double minimum = 0.0;
+    double average = 0.0;
+    double maximum = 0.0;
+    unsigned int samples = 0;
+};
+
+/*!
+ * Measures the GPU time of named scopes with timestamp queries
+ * Every scope writes a timestamp at its begin and end. The queries of a frame are read back FRAME_COUNT frames later,
+ * when the GPU is long done with them, so the profiler never stalls the pipeline. Timestamps (unlike
+ * GL_TIME_ELAPSED queries) may nest and overlap with other timer queries.
+ * All methods have to be called on the thread that owns the GL context.
+ */
+class GpuProfiler {
+  public:
+    static const unsigned int FRAME_COUNT = 4;
+
+  protected:
+    struct Scope {
+        /*!
+         * Index into the statistics of the scope's name
+         */
+        unsigned int history;
+        unsigned int beginQuery, endQuery;
+    };
+
+    struct Frame {
+        std::vector<GLuint> queries;
+        unsigned int usedQueries = 0;
+        std::vector<Scope> scopes;
+        unsigned long long number = 0;
+        bool pending = false;
+    };
+
+    struct History {
+        std::string name;
+        std::vector<double> samples;
+        unsigned int next = 0, count = 0;
+        /*!
+         * Sum of the frame that is being read back
+         */
+        double frameSum = 0.0;
+        bool touched = false;
+    };
+
+    Frame _frames[FRAME_COUNT];
+    unsigned long long _frameNumber;
+    unsigned int _frameScope;
+    unsigned int _historySize;
+
+    std::vector<History> _histories;
+    std::unordered_map<std::string, unsigned int> _historyIndices;
+
+    unsigned int _droppedFrames;
+    double _lastLogTime;
+    std::ofstream _csv;
+
+    static GpuProfiler* _drawProfiler;
+
+    unsigned int writeTimestamp();
+    unsigned int getHistory(const char* name);
+    /*!
+     * Reads the queries of a finished frame into the statistics
+     */
+    void collect(Frame& frame);
+
+  public:
+    /*!
+     * GPU profiler constructor
+     * @param historySize: number of frames the statistics are computed over
+     * @param csvPath: file every frame's scope times are appended to, empty for no CSV output
+     */
+    explicit GpuProfiler(unsigned int historySize = 120, const std::string& csvPath = "");
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    /*!
+     * Collects the results of the oldest frame in flight and starts the "Frame" scope
+     */
+    void beginFrame();
+
+    /*!
+     * Ends the "Frame" scope
+     */
+    void endFrame();
+
+    /*!
+     * Starts a scope, scopes may nest
+     * @param name: name of the scope, scopes with the same name are summed per frame
+     * @return id for endScope()
+     */
+    unsigned int beginScope(const char* name);
+
+    /*!
+     * Ends a scope
+     * @param scope: id returned by beginScope()
+     */
+    void endScope(unsigned int scope);
+
+    /*!
+     * @return the statistics of all scopes, in the order they first appeared
+     */
+    std::vector<GpuScopeStatistics> getStatistics() const;
+
+    /*!
+     * @return number of frames whose results were not ready when their queries were reused
+     */
+    unsigned int getDroppedFrameCount() const { return _droppedFrames; }
+
+    /*!
+     * Prints the statistics at most once per second
+     * @param time: current time in seconds
+     */
+    void logStatistics(double time);
+
+    /*!
+     * Sets the profiler used by the per-draw scopes in Geometry::draw, ModelLoader::Draw and the draw list
+     * @param profiler: the profiler, or nullptr to disable per-draw scopes
+     */
+    static void setDrawProfiler(GpuProfiler* profiler) { _drawProfiler = profiler; }
+    static GpuProfiler* getDrawProfiler() { return _drawProfiler; }
+};
+
+/*!
+ * Measures the GPU time of the enclosing block, does nothing without a profiler
+ */
+class GpuScope {
+  protected:
+    GpuProfiler* _profiler;
+    unsigned int _scope;
+
+  public:
+    GpuScope(GpuProfiler* profiler, const char* name)
+        : _profiler(profiler)
+        , _scope(profiler ? profiler->beginScope(name) : 0) {}
+    ~GpuScope() {
+        if (_profiler)
+            _profiler->endScope(_scope);
+    }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+};
@@ -0,0 +1,461 @@
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#undef min
+#undef max
+
+namespace {
+
+/* --------------------------------------------- */
+// Checksums
+/* --------------------------------------------- */
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256] = {};
+    static bool initialized = [&]() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)initialized;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+const uint32_t ADLER_BASE = 65521;
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // the sums cannot overflow within 5552 bytes
+        size_t block = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+/*!
+ * Checksum of two concatenated blocks from the checksums of the blocks
+ */
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) {
+    uint32_t remainder = uint32_t(secondSize % ADLER_BASE);
+    uint32_t sum1 = first & 0xFFFF;
+    uint32_t sum2 = uint32_t((uint64_t(remainder) * sum1) % ADLER_BASE);
+    sum1 += (second & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += ((first >> 16) & 0xFFFF) + ((second >> 16) & 0xFFFF) + ADLER_BASE - remainder;
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum2 >= ADLER_BASE * 2)
+        sum2 -= ADLER_BASE * 2;
+    if (sum2 >= ADLER_BASE)
+        sum2 -= ADLER_BASE;
+    return (sum2 << 16) | sum1;
+}
+
+/* --------------------------------------------- */
+// Deflate with the fixed Huffman codes
+/* --------------------------------------------- */
+
+class BitWriter {
+  protected:
+    std::vector<uint8_t>& _data;
+    uint32_t _bits;
+    unsigned int _count;
+
+  public:
+    explicit BitWriter(std::vector<uint8_t>& data)
+        : _data(data)
+        , _bits(0)
+        , _count(0) {}
+
+    /*!
+     * Writes the lowest bits of the value, least significant bit first
+     */
+    void write(uint32_t value, unsigned int count) {
+        _bits |= value << _count;
+        _count += count;
+        while (_count >= 8) {
+            _data.push_back(uint8_t(_bits));
+            _bits >>= 8;
+            _count -= 8;
+        }
+    }
+
+    /*!
+     * Writes a Huffman code, these are stored most significant bit first
+     */
+    void writeCode(uint32_t code, unsigned int length) {
+        uint32_t reversed = 0;
+        for (unsigned int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        write(reversed, length);
+    }
+
+    void alignToByte() {
+        if (_count > 0) {
+            write(0, 8 - _count);
+        }
+    }
+};
+
+const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+void writeLiteralOrLength(BitWriter& bits, unsigned int symbol) {
+    if (symbol < 144)
+        bits.writeCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        bits.writeCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        bits.writeCode(symbol - 256, 7);
+    else
+        bits.writeCode(0xC0 + symbol - 280, 8);
+}
+
+void writeMatch(BitWriter& bits, unsigned int length, unsigned int distance) {
+    unsigned int lengthCode = 28;
+    while (LENGTH_BASE[lengthCode] > length) {
+        lengthCode--;
+    }
+    writeLiteralOrLength(bits, 257 + lengthCode);
+    bits.write(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+    unsigned int distanceCode = 29;
+    while (DISTANCE_BASE[distanceCode] > distance) {
+        distanceCode--;
+    }
+    bits.writeCode(distanceCode, 5);
+    bits.write(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+}
+
+/*!
+ * Compresses a block as one non-final fixed Huffman block followed by an empty stored block
+ * Matches are searched with hash chains over a 32 KiB window, limited to a few candidates for speed.
+ */
+void deflateBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    const unsigned int WINDOW = 32768, HASH_BITS = 15, MAX_CHAIN = 16, MIN_MATCH = 3, MAX_MATCH = 258;
+
+    BitWriter bits(out);
+    bits.write(0, 1);
+    bits.write(1, 2);
+
+    std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+    std::vector<int32_t> previous(WINDOW, -1);
+    auto hash = [&](size_t i) { return ((uint32_t(data[i]) << 10) ^ (uint32_t(data[i + 1]) << 5) ^ data[i + 2]) & ((1u << HASH_BITS) - 1); };
+    auto insert = [&](size_t i) {
+        uint32_t h = hash(i);
+        previous[i % WINDOW] = head[h];
+        head[h] = int32_t(i);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        unsigned int bestLength = 0, bestDistance = 0;
+        if (i + MIN_MATCH <= size) {
+            unsigned int maxLength = unsigned(std::min<size_t>(MAX_MATCH, size - i));
+            int32_t candidate = head[hash(i)];
+            for (unsigned int chain = 0; chain < MAX_CHAIN && candidate >= 0 && i - size_t(candidate) <= WINDOW; chain++) {
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + i;
+                unsigned int length = 0;
+                while (length < maxLength && a[length] == b[length]) {
+                    length++;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = unsigned(i - size_t(candidate));
+                    if (length == maxLength)
+                        break;
+                }
+                int32_t next = previous[size_t(candidate) % WINDOW];
+                // stale entries of the ring point forward
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= MIN_MATCH) {
+            writeMatch(bits, bestLength, bestDistance);
+            for (size_t end = i + bestLength; i < end; i++) {
+                if (i + MIN_MATCH <= size)
+                    insert(i);
+            }
+        } else {
+            writeLiteralOrLength(bits, data[i]);
+            if (i + MIN_MATCH <= size)
+                insert(i);
+            i++;
+        }
+    }
+    writeLiteralOrLength(bits, 256);
+
+    // empty stored block, ends the stripe on a byte boundary
+    bits.write(0, 3);
+    bits.alignToByte();
+    out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+}
+
+/* --------------------------------------------- */
+// PNG
+/* --------------------------------------------- */
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return uint8_t(a);
+    return uint8_t(pb <= pc ? b : c);
+}
+
+/*!
+ * Filters a row with each of the five PNG filters and keeps the one with the smallest sum of absolute differences
+ */
+void filterRow(const uint8_t* row, const uint8_t* above, size_t size, uint8_t* out, std::vector<uint8_t>& candidate) {
+    const size_t BPP = 3;
+    unsigned long long bestScore = ~0ull;
+    candidate.resize(size);
+    for (uint8_t filter = 0; filter < 5; filter++) {
+        unsigned long long score = 0;
+        for (size_t x = 0; x < size; x++) {
+            int left = x >= BPP ? row[x - BPP] : 0;
+            int up = above ? above[x] : 0;
+            int upperLeft = above && x >= BPP ? above[x - BPP] : 0;
+            uint8_t predicted = 0;
+            switch (filter) {
+                case 1: predicted = uint8_t(left); break;
+                case 2: predicted = uint8_t(up); break;
+                case 3: predicted = uint8_t((left + up) / 2); break;
+                case 4: predicted = paeth(left, up, upperLeft); break;
+            }
+            uint8_t value = uint8_t(row[x] - predicted);
+            candidate[x] = value;
+            score += value < 128 ? value : 256 - value;
+        }
+        if (score < bestScore) {
+            bestScore = score;
+            out[0] = filter;
+            std::memcpy(out + 1, candidate.data(), size);
+        }
+    }
+}
+
+void appendBigEndian(std::vector<uint8_t>& data, uint32_t value) {
+    data.insert(data.end(), {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)});
+}
+
+void appendChunk(std::vector<uint8_t>& data, const char* type, const uint8_t* content, size_t size) {
+    appendBigEndian(data, uint32_t(size));
+    size_t start = data.size();
+    data.insert(data.end(), type, type + 4);
+    data.insert(data.end(), content, content + size);
+    appendBigEndian(data, crc32(&data[start], data.size() - start));
+}
+
+/*!
+ * Converts the bottom-up RGBA rows of an image to top-down RGB rows
+ */
+void getRGBRow(const Image& image, unsigned int y, uint8_t* row) {
+    const uint8_t* source = &image.pixels[size_t(image.height - 1 - y) * image.width * 4];
+    for (unsigned int x = 0; x < image.width; x++) {
+        row[x * 3 + 0] = source[x * 4 + 0];
+        row[x * 3 + 1] = source[x * 4 + 1];
+        row[x * 3 + 2] = source[x * 4 + 2];
+    }
+}
+
+} // namespace
+
+void encodePNG(const Image& image, std::vector<uint8_t>& data, unsigned int threadCount) {
+    const unsigned int MIN_STRIPE_ROWS = 32;
+    size_t rowSize = size_t(image.width) * 3;
+    unsigned int stripeCount = std::max(1u, std::min(threadCount, image.height / MIN_STRIPE_ROWS));
+
+    struct Stripe {
+        std::vector<uint8_t> compressed;
+        uint32_t adler = 1;
+        size_t size = 0;
+    };
+    std::vector<Stripe> stripes(stripeCount);
+
+    // the calling thread and its helpers take stripes until none are left
+    std::atomic<unsigned int> nextStripe(0);
+    auto encodeStripes = [&]() {
+        std::vector<uint8_t> filtered, rows[2], candidate;
+        rows[0].resize(rowSize);
+        rows[1].resize(rowSize);
+        for (unsigned int s = nextStripe++; s < stripeCount; s = nextStripe++) {
+            // every stripe has at least MIN_STRIPE_ROWS rows, the last one ends at the bottom of the image
+            unsigned int firstRow = unsigned(size_t(image.height) * s / stripeCount);
+            unsigned int lastRow = unsigned(size_t(image.height) * (s + 1) / stripeCount);
+            filtered.resize(size_t(lastRow - firstRow) * (rowSize + 1));
+
+            // the row above the stripe is needed for the filters, the stripes only split the compression
+            if (firstRow > 0) {
+                getRGBRow(image, firstRow - 1, rows[(firstRow - 1) & 1].data());
+            }
+            for (unsigned int y = firstRow; y < lastRow; y++) {
+                uint8_t* row = rows[y & 1].data();
+                getRGBRow(image, y, row);
+                const uint8_t* above = y > 0 ? rows[(y - 1) & 1].data() : nullptr;
+                filterRow(row, above, rowSize, &filtered[size_t(y - firstRow) * (rowSize + 1)], candidate);
+            }
+
+            stripes[s].size = filtered.size();
+            stripes[s].adler = adler32(filtered.data(), filtered.size());
+            deflateBlock(filtered.data(), filtered.size(), stripes[s].compressed);
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (unsigned int i = 1; i < stripeCount; i++) {
+        helpers.emplace_back(encodeStripes);
+    }
+    encodeStripes();
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+
+    // zlib stream: header, the stripes, a final empty block and the checksum of the uncompressed data
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    uint32_t adler = 1;
+    for (const Stripe& stripe : stripes) {
+        zlib.insert(zlib.end(), stripe.compressed.begin(), stripe.compressed.end());
+        adler = adler32Combine(adler, stripe.adler, stripe.size);
+    }
+    zlib.insert(zlib.end(), {0x03, 0x00});
+    appendBigEndian(zlib, adler);
+
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    data.assign(SIGNATURE, SIGNATURE + 8);
+    std::vector<uint8_t> header;
+    appendBigEndian(header, image.width);
+    appendBigEndian(header, image.height);
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    appendChunk(data, "IHDR", header.data(), header.size());
+    appendChunk(data, "IDAT", zlib.data(), zlib.size());
+    appendChunk(data, "IEND", nullptr, 0);
+}
+
+void encodeQOI(const Image& image, std::vector<uint8_t>& data) {
+    data.clear();
+    data.reserve(14 + size_t(image.width) * image.height * 4 + 8);
+    data.insert(data.end(), {'q', 'o', 'i', 'f'});
+    appendBigEndian(data, image.width);
+    appendBigEndian(data, image.height);
+    // RGB, sRGB with linear alpha
+    data.insert(data.end(), {3, 0});
+
+    // packed RGBA like the decoder's table, which starts out transparent black
+    uint32_t seen[64] = {};
+    uint8_t previous[3] = {0, 0, 0};
+    unsigned int run = 0;
+    for (unsigned int y = 0; y < image.height; y++) {
+        const uint8_t* row = &image.pixels[size_t(image.height - 1 - y) * image.width * 4];
+        for (unsigned int x = 0; x < image.width; x++) {
+            const uint8_t* p = &row[x * 4];
+            if (p[0] == previous[0] && p[1] == previous[1] && p[2] == previous[2]) {
+                run++;
+                if (run == 62) {
+                    data.push_back(uint8_t(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                data.push_back(uint8_t(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            // alpha is always 255
+            uint32_t packed = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | 255u;
+            unsigned int index = (p[0] * 3 + p[1] * 5 + p[2] * 7 + 255 * 11) % 64;
+            if (seen[index] == packed) {
+                data.push_back(uint8_t(index));
+            } else {
+                seen[index] = packed;
+                int8_t dr = int8_t(p[0] - previous[0]), dg = int8_t(p[1] - previous[1]), db = int8_t(p[2] - previous[2]);
+                int8_t drg = int8_t(dr - dg), dbg = int8_t(db - dg);
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    data.push_back(uint8_t(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    data.push_back(uint8_t(0x80 | (dg + 32)));
+                    data.push_back(uint8_t(((drg + 8) << 4) | (dbg + 8)));
+                } else {
+                    data.insert(data.end(), {0xFE, p[0], p[1], p[2]});
+                }
+            }
+            previous[0] = p[0];
+            previous[1] = p[1];
+            previous[2] = p[2];
+        }
+    }
+    if (run > 0) {
+        data.push_back(uint8_t(0xC0 | (run - 1)));
+    }
+    data.insert(data.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+void encodePPM(const Image& image, std::vector<uint8_t>& data) {
+    char header[64];
+    int headerSize = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", image.width, image.height);
+    data.assign(header, header + headerSize);
+    data.resize(headerSize + size_t(image.width) * image.height * 3);
+    for (unsigned int y = 0; y < image.height; y++) {
+        getRGBRow(image, y, &data[headerSize + size_t(y) * image.width * 3]);
+    }
+}
+
+bool isImageFormat(const std::string& format) { return format == "ppm" || format == "png" || format == "qoi"; }
+
+bool writeImage(const Image& image, const std::string& filepath, unsigned int threadCount) {
+    std::string extension = std::filesystem::path(filepath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+    std::vector<uint8_t> data;
+    if (extension == ".png") {
+        encodePNG(image, data, threadCount);
+    } else if (extension == ".qoi") {
+        encodeQOI(image, data);
+    } else {
+        encodePPM(image, data);
+    }
+
+    FILE* file = std::fopen(filepath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Could not write image " << filepath << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && written;
+}
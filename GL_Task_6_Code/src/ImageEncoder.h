@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * An 8-bit RGBA image as read back from OpenGL, the rows are stored from bottom to top
+ */
+struct Image {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/*!
+ * Encodes an image as PNG (RGB, 8 bits per channel)
+ * The rows are split into stripes that are filtered and deflated in parallel. Each stripe ends on a byte boundary
+ * with an empty stored block, so the compressed stripes can simply be concatenated into one zlib stream.
+ * The stripes run on the calling thread and threads started for this image, not on the job system, whose waiting
+ * threads would pick them up and stall the frame.
+ * @param image: the image
+ * @param data: receives the file contents
+ * @param threadCount: number of threads encoding stripes, including the calling thread
+ */
+void encodePNG(const Image& image, std::vector<uint8_t>& data, unsigned int threadCount = 1);
+
+/*!
+ * Encodes an image as QOI (RGB), about as small as PNG for rendered images but much faster to encode
+ * @param image: the image
+ * @param data: receives the file contents
+ */
+void encodeQOI(const Image& image, std::vector<uint8_t>& data);
+
+/*!
+ * Encodes an image as binary PPM
+ * @param image: the image
+ * @param data: receives the file contents
+ */
+void encodePPM(const Image& image, std::vector<uint8_t>& data);
+
+/*!
+ * @return whether the format is one of "ppm", "png" and "qoi"
+ * @param format: file extension without the dot
+ */
+bool isImageFormat(const std::string& format);
+
+/*!
+ * Writes an image in the format of the file extension: .png, .qoi or .ppm (the default)
+ * @param image: the image
+ * @param filepath: the output file
+ * @param threadCount: number of threads encoding a PNG, see encodePNG()
+ * @return whether the file was written
+ */
+bool writeImage(const Image& image, const std::string& filepath, unsigned int threadCount = 1);
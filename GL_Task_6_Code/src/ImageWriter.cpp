@@ -0,0 +1,96 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#undef min
+#undef max
+
+ImageWriter::ImageWriter(unsigned int threadCount, unsigned int maxQueued)
+    : _maxQueued(maxQueued)
+    , _encoderThreads(std::max(1u, std::thread::hardware_concurrency() / std::max(1u, threadCount)))
+    , _writing(0)
+    , _waits(0)
+    , _stop(false) {
+    for (unsigned int i = 0; i < std::max(1u, threadCount); i++) {
+        _threads.emplace_back(&ImageWriter::writerLoop, this);
+    }
+}
+
+ImageWriter::~ImageWriter() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+Image ImageWriter::acquireImage(unsigned int width, unsigned int height) {
+    Image image;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_freeImages.empty()) {
+            image = std::move(_freeImages.back());
+            _freeImages.pop_back();
+        }
+    }
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    return image;
+}
+
+void ImageWriter::write(Image image, const std::string& filepath) {
+    unsigned int threads = _encoderThreads;
+    write(std::move(image), [filepath, threads](const Image& image) { writeImage(image, filepath, threads); });
+}
+
+void ImageWriter::write(Image image, Encoder encoder) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_maxQueued > 0 && _requests.size() >= _maxQueued) {
+            _waits++;
+            _condition.wait(lock, [&]() { return _requests.size() < _maxQueued; });
+        }
+        _requests.push_back(Request{std::move(image), std::move(encoder)});
+    }
+    _condition.notify_all();
+}
+
+void ImageWriter::flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [&]() { return _requests.empty() && _writing == 0; });
+}
+
+unsigned int ImageWriter::getWaitCount() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _waits;
+}
+
+void ImageWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        // remaining requests are written before the threads stop
+        _condition.wait(lock, [&]() { return !_requests.empty() || _stop; });
+        if (_requests.empty())
+            return;
+
+        Request request = std::move(_requests.front());
+        _requests.pop_front();
+        _writing++;
+        // a producer may wait for the free place
+        _condition.notify_all();
+        lock.unlock();
+
+        request.encoder(request.image);
+
+        lock.lock();
+        _writing--;
+        _freeImages.push_back(std::move(request.image));
+        _condition.notify_all();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ImageEncoder.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * Encodes and writes images on background threads
+ * The queue is bounded: once it is full, write() waits for the workers, so a producer that is faster than the disk
+ * slows down instead of running out of memory. Written images are recycled, acquireImage() hands their memory out
+ * again so capturing every frame does not allocate.
+ * The workers are separate from the job system, encoding a frame takes long enough to delay the frame's own jobs.
+ * The cores the workers leave idle are shared out among them for encoding the stripes of a PNG.
+ */
+class ImageWriter {
+  public:
+    /*!
+     * Encodes and writes an image, called on one of the worker threads
+     */
+    using Encoder = std::function<void(const Image& image)>;
+
+  protected:
+    struct Request {
+        Image image;
+        Encoder encoder;
+    };
+
+    std::deque<Request> _requests;
+    std::vector<Image> _freeImages;
+    unsigned int _maxQueued;
+    unsigned int _encoderThreads;
+    /*!
+     * Number of requests the workers took from the queue and still work on
+     */
+    unsigned int _writing;
+    unsigned int _waits;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::vector<std::thread> _threads;
+
+    void writerLoop();
+
+  public:
+    /*!
+     * Image writer constructor
+     * @param threadCount: number of worker threads
+     * @param maxQueued: number of images that may wait in the queue, 0 for no limit
+     */
+    explicit ImageWriter(unsigned int threadCount = 1, unsigned int maxQueued = 0);
+    /*!
+     * Writes the remaining images before it returns
+     */
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    /*!
+     * @return an image of the given size, reusing the memory of written images
+     * @param width: image width
+     * @param height: image height
+     */
+    Image acquireImage(unsigned int width, unsigned int height);
+
+    /*!
+     * Queues an image for writing, waits while the queue is full
+     * @param image: the image, moved into the queue
+     * @param filepath: the output file, its extension selects the format (see writeImage())
+     */
+    void write(Image image, const std::string& filepath);
+
+    /*!
+     * Queues an image for a custom encoder, waits while the queue is full
+     * @param image: the image, moved into the queue
+     * @param encoder: runs on a worker thread, requests are started in order but may finish in any order
+     */
+    void write(Image image, Encoder encoder);
+
+    /*!
+     * Waits until all queued images are written
+     */
+    void flush();
+
+    /*!
+     * @return number of threads each worker may use for encoding one image, see writeImage()
+     */
+    unsigned int getEncoderThreadCount() const { return _encoderThreads; }
+
+    /*!
+     * @return number of times write() had to wait for a full queue
+     */
+    unsigned int getWaitCount();
+};
@@ -0,0 +1,177 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+#undef min
+#undef max
+
+namespace {
+
+thread_local unsigned int currentThread = 0;
+
+} // namespace
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : _queuedCount(0)
+    , _stop(false)
+    , _epoch(std::chrono::steady_clock::now()) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        _queues.emplace_back(new Queue());
+    }
+    for (unsigned int i = 1; i < threadCount; i++) {
+        _threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+JobHandle JobSystem::createJob(const char* name, std::function<void()> func) { return std::make_shared<Job>(name, std::move(func), false); }
+
+JobHandle JobSystem::createGLJob(const char* name, std::function<void()> func) { return std::make_shared<Job>(name, std::move(func), true); }
+
+void JobSystem::addDependency(const JobHandle& job, const JobHandle& prerequisite) {
+    std::lock_guard<std::mutex> lock(prerequisite->_mutex);
+    if (prerequisite->isDone())
+        return;
+    job->_pending++;
+    prerequisite->_dependents.push_back(job);
+}
+
+void JobSystem::submit(const JobHandle& job) {
+    if (--job->_pending == 0) {
+        enqueue(job);
+    }
+}
+
+JobHandle JobSystem::run(const char* name, std::function<void()> func) {
+    JobHandle job = createJob(name, std::move(func));
+    submit(job);
+    return job;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    while (!job->isDone()) {
+        if (JobHandle other = findJob(currentThread)) {
+            execute(other);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::runGLJobs() {
+    std::deque<JobHandle> jobs;
+    {
+        std::lock_guard<std::mutex> lock(_glQueue.mutex);
+        jobs.swap(_glQueue.jobs);
+    }
+    // GL jobs that become ready meanwhile run next frame
+    for (const JobHandle& job : jobs) {
+        execute(job);
+    }
+}
+
+void JobSystem::setTimingHook(JobTimingHook hook) { _timingHook = std::move(hook); }
+
+unsigned int JobSystem::getCurrentThreadIndex() { return currentThread; }
+
+void JobSystem::enqueue(const JobHandle& job) {
+    if (job->_glThread) {
+        std::lock_guard<std::mutex> lock(_glQueue.mutex);
+        _glQueue.jobs.push_back(job);
+        return;
+    }
+
+    Queue& queue = *_queues[std::min(currentThread, unsigned(_queues.size() - 1))];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    _queuedCount++;
+    // a worker checks the counter while holding the mutex, taking it here avoids lost wake-ups
+    { std::lock_guard<std::mutex> lock(_sleepMutex); }
+    _wake.notify_one();
+}
+
+JobHandle JobSystem::findJob(unsigned int thread) {
+    unsigned int queueCount = static_cast<unsigned int>(_queues.size());
+
+    // newest job of the own queue first, its data is most likely still in the cache
+    {
+        Queue& own = *_queues[thread];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            JobHandle job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            _queuedCount--;
+            return job;
+        }
+    }
+
+    // steal the oldest job of another queue, these are usually the larger ones
+    for (unsigned int i = 1; i < queueCount; i++) {
+        Queue& victim = *_queues[(thread + i) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            JobHandle job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            _queuedCount--;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(const JobHandle& job) {
+    PROFILE_ZONE(job->_name);
+    if (_timingHook) {
+        double start = std::chrono::duration<double>(std::chrono::steady_clock::now() - _epoch).count();
+        job->_func();
+        double end = std::chrono::duration<double>(std::chrono::steady_clock::now() - _epoch).count();
+        _timingHook(job->_name, currentThread, start, end);
+    } else {
+        job->_func();
+    }
+
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->_mutex);
+        job->_done.store(true, std::memory_order_release);
+        dependents.swap(job->_dependents);
+    }
+    for (const JobHandle& dependent : dependents) {
+        if (--dependent->_pending == 0) {
+            enqueue(dependent);
+        }
+    }
+}
+
+void JobSystem::workerLoop(unsigned int thread) {
+    currentThread = thread;
+    CpuProfiler::setThreadName("Worker");
+    while (!_stop) {
+        if (JobHandle job = findJob(thread)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [&]() { return _queuedCount > 0 || _stop; });
+    }
+}
+
+JobSystem& getJobSystem() {
+    static JobSystem jobSystem(getWorkerThreadCount());
+    return jobSystem;
+}
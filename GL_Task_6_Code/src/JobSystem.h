@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Job;
+using JobHandle = std::shared_ptr<Job>;
+
+/*!
+ * Called after every job with the job's name, the index of the thread it ran on and its start and end time in seconds
+ */
+using JobTimingHook = std::function<void(const char* name, unsigned int thread, double start, double end)>;
+
+/*!
+ * A unit of work in the job graph
+ * A job becomes ready once it was submitted and all its prerequisites are finished.
+ */
+class Job {
+    friend class JobSystem;
+
+  protected:
+    std::function<void()> _func;
+    const char* _name;
+    bool _glThread;
+    /*!
+     * Unfinished prerequisites, plus one until the job is submitted
+     */
+    std::atomic<int> _pending;
+    std::atomic<bool> _done;
+    /*!
+     * Guards _dependents against jobs that finish while dependencies are added
+     */
+    std::mutex _mutex;
+    std::vector<JobHandle> _dependents;
+
+  public:
+    /*!
+     * Job constructor, use JobSystem::createJob() instead
+     * @param name: name shown by the timing hook, has to outlive the job (usually a literal)
+     * @param func: the work
+     * @param glThread: if the job may only run on the thread that owns the GL context
+     */
+    Job(const char* name, std::function<void()> func, bool glThread)
+        : _func(std::move(func))
+        , _name(name)
+        , _glThread(glThread)
+        , _pending(1)
+        , _done(false) {}
+
+    const char* getName() const { return _name; }
+    bool isDone() const { return _done.load(std::memory_order_acquire); }
+};
+
+/*!
+ * Work-stealing job system
+ * Every worker thread owns a queue, it pushes and pops jobs at the back and steals from the front of the
+ * other queues when its own one is empty. Threads outside the job system (main and render thread) share queue 0.
+ * Waiting threads help executing jobs instead of blocking, so jobs may wait for other jobs.
+ * Jobs for GL calls are kept in a separate queue that is only drained by runGLJobs().
+ */
+class JobSystem {
+  protected:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    /*!
+     * Queue 0 is shared by all external threads, queue i belongs to worker i
+     */
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+
+    Queue _glQueue;
+
+    /*!
+     * Number of jobs in all worker queues, idle workers sleep while it is zero
+     */
+    std::atomic<int> _queuedCount;
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+    std::atomic<bool> _stop;
+
+    JobTimingHook _timingHook;
+    std::chrono::steady_clock::time_point _epoch;
+
+    void enqueue(const JobHandle& job);
+    /*!
+     * Pops a job from the thread's own queue, or steals one from another queue
+     * @return the job, or nullptr if all queues are empty
+     */
+    JobHandle findJob(unsigned int thread);
+    void execute(const JobHandle& job);
+    void workerLoop(unsigned int thread);
+
+  public:
+    /*!
+     * Job system constructor, starts the worker threads
+     * @param threadCount: number of threads that execute jobs, including the calling thread (at least 1)
+     */
+    explicit JobSystem(unsigned int threadCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /*!
+     * Creates a job that runs on any thread, it does not run before submit()
+     * @param name: name shown by the timing hook, has to outlive the job (usually a literal)
+     * @param func: the work
+     */
+    JobHandle createJob(const char* name, std::function<void()> func);
+
+    /*!
+     * Creates a job that only runs inside runGLJobs(), e.g. uploads after a worker decoded an asset
+     * @param name: name shown by the timing hook, has to outlive the job (usually a literal)
+     * @param func: the work
+     */
+    JobHandle createGLJob(const char* name, std::function<void()> func);
+
+    /*!
+     * Makes a job wait for another one, has to be called before the job is submitted
+     * @param job: the dependent job
+     * @param prerequisite: the job that has to finish first
+     */
+    void addDependency(const JobHandle& job, const JobHandle& prerequisite);
+
+    /*!
+     * Submits a job, it runs as soon as all its prerequisites are finished
+     */
+    void submit(const JobHandle& job);
+
+    /*!
+     * Creates and submits a job without prerequisites
+     * @return the job, for waiting or as prerequisite
+     */
+    JobHandle run(const char* name, std::function<void()> func);
+
+    /*!
+     * Executes other jobs until a job is finished
+     * Must not be used on GL jobs, those only finish inside runGLJobs().
+     */
+    void wait(const JobHandle& job);
+
+    /*!
+     * Executes all ready GL jobs, called once per frame by the thread that owns the GL context
+     */
+    void runGLJobs();
+
+    /*!
+     * Sets the hook that is called after every job, must not be changed while jobs are running
+     * @param hook: the timing hook, or an empty function to disable timing
+     */
+    void setTimingHook(JobTimingHook hook);
+
+    /*!
+     * @return the number of threads that execute jobs, including external threads (counted as one)
+     */
+    unsigned int getThreadCount() const { return static_cast<unsigned int>(_queues.size()); }
+
+    /*!
+     * @return the index of the calling thread, 0 for threads outside the job system
+     */
+    static unsigned int getCurrentThreadIndex();
+};
+
+/*!
+ * @return the job system shared by the engine, with getWorkerThreadCount() threads
+ */
+JobSystem& getJobSystem();
@@ -0,0 +1,243 @@
+#include "LightClusters.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTERS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CLUSTERS_NEON
+#include <arm_neon.h>
+#endif
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Light spheres of one depth slice, padded to a multiple of four with spheres that never intersect anything
+ */
+struct SliceCandidates {
+    std::vector<float> x, y, z, radius2;
+    std::vector<unsigned int> lights;
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius2.clear();
+        lights.clear();
+    }
+
+    void push(float px, float py, float pz, float r2, unsigned int light) {
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        radius2.push_back(r2);
+        lights.push_back(light);
+    }
+};
+
+/*!
+ * Tests four light spheres against a box
+ * @return bit i is set if sphere i intersects the box
+ */
+inline unsigned int intersectSpheres4(const SliceCandidates& c, size_t i, const AABB& box) {
+#if defined(CLUSTERS_SSE2)
+    __m128 x = _mm_loadu_ps(&c.x[i]);
+    __m128 y = _mm_loadu_ps(&c.y[i]);
+    __m128 z = _mm_loadu_ps(&c.z[i]);
+    __m128 zero = _mm_setzero_ps();
+    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), x), _mm_sub_ps(x, _mm_set1_ps(box.max.x))), zero);
+    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), y), _mm_sub_ps(y, _mm_set1_ps(box.max.y))), zero);
+    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), z), _mm_sub_ps(z, _mm_set1_ps(box.max.z))), zero);
+    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return unsigned(_mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&c.radius2[i]))));
+#elif defined(CLUSTERS_NEON)
+    float32x4_t x = vld1q_f32(&c.x[i]);
+    float32x4_t y = vld1q_f32(&c.y[i]);
+    float32x4_t z = vld1q_f32(&c.z[i]);
+    float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t dx = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.min.x), x), vsubq_f32(x, vdupq_n_f32(box.max.x))), zero);
+    float32x4_t dy = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.min.y), y), vsubq_f32(y, vdupq_n_f32(box.max.y))), zero);
+    float32x4_t dz = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.min.z), z), vsubq_f32(z, vdupq_n_f32(box.max.z))), zero);
+    float32x4_t d2 = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz));
+    uint32x4_t hit = vcleq_f32(d2, vld1q_f32(&c.radius2[i]));
+    return (vgetq_lane_u32(hit, 0) & 1u) | (vgetq_lane_u32(hit, 1) & 2u) | (vgetq_lane_u32(hit, 2) & 4u) | (vgetq_lane_u32(hit, 3) & 8u);
+#else
+    unsigned int mask = 0;
+    for (size_t lane = 0; lane < 4; lane++) {
+        float dx = std::max(std::max(box.min.x - c.x[i + lane], c.x[i + lane] - box.max.x), 0.0f);
+        float dy = std::max(std::max(box.min.y - c.y[i + lane], c.y[i + lane] - box.max.y), 0.0f);
+        float dz = std::max(std::max(box.min.z - c.z[i + lane], c.z[i + lane] - box.max.z), 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= c.radius2[i + lane])
+            mask |= 1u << lane;
+    }
+    return mask;
+#endif
+}
+
+} // namespace
+
+LightClusters::LightClusters(float fov, float aspect, float nearZ, float farZ)
+    : _near(nearZ)
+    , _far(farZ)
+    , _projMatrix(glm::perspective(glm::radians(fov), aspect, nearZ, farZ)) {
+    // view space boxes around the frustum cells, slices are distributed exponentially in depth
+    _clusterBounds.resize(CLUSTER_COUNT);
+    for (unsigned int z = 0; z < GRID_Z; z++) {
+        float sliceNear = _near * std::pow(_far / _near, float(z) / float(GRID_Z));
+        float sliceFar = _near * std::pow(_far / _near, float(z + 1) / float(GRID_Z));
+        for (unsigned int y = 0; y < GRID_Y; y++) {
+            for (unsigned int x = 0; x < GRID_X; x++) {
+                AABB box;
+                for (unsigned int corner = 0; corner < 8; corner++) {
+                    float ndcX = -1.0f + 2.0f * float(x + (corner & 1)) / float(GRID_X);
+                    float ndcY = -1.0f + 2.0f * float(y + ((corner >> 1) & 1)) / float(GRID_Y);
+                    float depth = (corner & 4) ? sliceFar : sliceNear;
+                    box.expand(glm::vec3(ndcX * depth / _projMatrix[0][0], ndcY * depth / _projMatrix[1][1], -depth));
+                }
+                _clusterBounds[x + GRID_X * (y + GRID_Y * z)] = box;
+            }
+        }
+    }
+
+    glGenBuffers(3, _buffers);
+    glGenTextures(3, _textures);
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    for (unsigned int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, _buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, _textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], _buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters() {
+    glDeleteTextures(3, _textures);
+    glDeleteBuffers(3, _buffers);
+}
+
+float LightClusters::computeLightRange(const PointLight& light, float threshold) {
+    // solve maxColor / (c + l * d + q * d^2) = threshold for d
+    float intensity = std::max({light.color.x, light.color.y, light.color.z});
+    float c = light.attenuation.x - intensity / threshold;
+    float l = light.attenuation.y;
+    float q = light.attenuation.z;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (q > 0.0f)
+        return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+    if (l > 0.0f)
+        return -c / l;
+    return std::numeric_limits<float>::max();
+}
+
+void LightClusters::assignLights(const glm::mat4& viewMatrix, const std::vector<PointLight>& lights) {
+    _lightX.clear();
+    _lightY.clear();
+    _lightZ.clear();
+    _lightRadius.clear();
+    _lightData.clear();
+
+    for (const PointLight& light : lights) {
+        if (!light.enabled)
+            continue;
+        float range = computeLightRange(light);
+        if (range <= 0.0f)
+            continue;
+        glm::vec3 position = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+        _lightX.push_back(position.x);
+        _lightY.push_back(position.y);
+        _lightZ.push_back(position.z);
+        _lightRadius.push_back(range);
+        _lightData.push_back(glm::vec4(light.position, range));
+        _lightData.push_back(glm::vec4(light.color, 0.0f));
+        _lightData.push_back(glm::vec4(light.attenuation, 0.0f));
+    }
+
+    // every slice builds its own lists, they are concatenated in slice order afterwards
+    std::vector<std::vector<unsigned int>> sliceIndices(GRID_Z);
+    _clusterRanges.assign(CLUSTER_COUNT, glm::uvec2(0));
+
+    parallelFor(GRID_Z, [&](unsigned int begin, unsigned int end) {
+        SliceCandidates candidates;
+        for (unsigned int z = begin; z < end; z++) {
+            const unsigned int sliceStart = GRID_X * GRID_Y * z;
+            float sliceMinZ = _clusterBounds[sliceStart].min.z;
+            float sliceMaxZ = _clusterBounds[sliceStart].max.z;
+
+            candidates.clear();
+            for (size_t i = 0; i < _lightRadius.size(); i++) {
+                float r = _lightRadius[i];
+                if (_lightZ[i] + r >= sliceMinZ && _lightZ[i] - r <= sliceMaxZ) {
+                    candidates.push(_lightX[i], _lightY[i], _lightZ[i], r * r, unsigned(i));
+                }
+            }
+            while (candidates.lights.size() % 4 != 0) {
+                candidates.push(0.0f, 0.0f, 0.0f, -1.0f, 0);
+            }
+
+            std::vector<unsigned int>& indices = sliceIndices[z];
+            indices.clear();
+            for (unsigned int cluster = sliceStart; cluster < sliceStart + GRID_X * GRID_Y; cluster++) {
+                unsigned int offset = unsigned(indices.size());
+                for (size_t i = 0; i < candidates.lights.size(); i += 4) {
+                    unsigned int mask = intersectSpheres4(candidates, i, _clusterBounds[cluster]);
+                    for (unsigned int lane = 0; mask != 0; lane++, mask >>= 1) {
+                        if (mask & 1)
+                            indices.push_back(candidates.lights[i + lane]);
+                    }
+                }
+                _clusterRanges[cluster] = glm::uvec2(offset, unsigned(indices.size()) - offset);
+            }
+        }
+    });
+
+    _lightIndices.clear();
+    for (unsigned int z = 0; z < GRID_Z; z++) {
+        unsigned int sliceOffset = unsigned(_lightIndices.size());
+        for (unsigned int cluster = GRID_X * GRID_Y * z; cluster < GRID_X * GRID_Y * (z + 1); cluster++) {
+            _clusterRanges[cluster].x += sliceOffset;
+        }
+        _lightIndices.insert(_lightIndices.end(), sliceIndices[z].begin(), sliceIndices[z].end());
+    }
+}
+
+void LightClusters::update(const glm::mat4& viewProjMatrix, const std::vector<PointLight>& lights) {
+    assignLights(glm::inverse(_projMatrix) * viewProjMatrix, lights);
+
+    // texture buffers must not be empty, so always upload at least one element
+    const void* data[3] = {_lightData.data(), _clusterRanges.data(), _lightIndices.data()};
+    const size_t sizes[3] = {_lightData.size() * sizeof(glm::vec4), _clusterRanges.size() * sizeof(glm::uvec2), _lightIndices.size() * sizeof(unsigned int)};
+    for (unsigned int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, _buffers[i]);
+        if (sizes[i] == 0) {
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::setUniforms(Shader& shader, unsigned int firstTextureUnit) {
+    const char* names[3] = {"pointLightData", "clusterLightRanges", "clusterLightIndices"};
+    for (unsigned int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, _textures[i]);
+        shader.setUniform(names[i], int(firstTextureUnit + i));
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    float logRatio = std::log(_far / _near);
+    shader.setUniform("clusterGridSize", glm::vec3(float(GRID_X), float(GRID_Y), float(GRID_Z)));
+    shader.setUniform("clusterDepthParams", glm::vec3(float(GRID_Z) / logRatio, float(GRID_Z) * std::log(_near) / logRatio, _near));
+}
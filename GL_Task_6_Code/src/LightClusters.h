@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Light.h"
+#include "Shader.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*!
+ * Clustered forward lighting.
+ * The view frustum is divided into a grid of clusters (screen tiles x exponential depth slices).
+ * Every frame the point lights are assigned to the clusters they reach on the CPU, and the resulting
+ * per-cluster light lists are uploaded as texture buffers, so shaders only loop over nearby lights.
+ */
+class LightClusters {
+  public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+  protected:
+    float _near, _far;
+    glm::mat4 _projMatrix;
+
+    /*!
+     * View space bounding box of every cluster (depends on the projection only)
+     */
+    std::vector<AABB> _clusterBounds;
+
+    // view space light spheres of the current frame (structure of arrays)
+    std::vector<float> _lightX, _lightY, _lightZ, _lightRadius;
+
+    /*!
+     * Light data as uploaded to the GPU, three texels per light: (position, range), (color, 0), (attenuation, 0)
+     */
+    std::vector<glm::vec4> _lightData;
+    /*!
+     * Offset into _lightIndices and number of lights for every cluster
+     */
+    std::vector<glm::uvec2> _clusterRanges;
+    /*!
+     * Concatenated light lists of all clusters
+     */
+    std::vector<unsigned int> _lightIndices;
+
+    GLuint _buffers[3];
+    GLuint _textures[3];
+
+  public:
+    /*!
+     * Light clusters constructor, the grid follows the camera's projection
+     * @param fov: field of view of the camera, in degrees
+     * @param aspect: aspect ratio of the camera
+     * @param nearZ: near plane distance of the camera
+     * @param farZ: far plane distance of the camera
+     */
+    LightClusters(float fov, float aspect, float nearZ, float farZ);
+    ~LightClusters();
+
+    /*!
+     * Assigns the lights to the clusters (CPU only, no GL calls)
+     * @param viewMatrix: view matrix of the camera
+     * @param lights: all point lights, disabled lights are skipped
+     */
+    void assignLights(const glm::mat4& viewMatrix, const std::vector<PointLight>& lights);
+
+    /*!
+     * Assigns the lights and uploads the cluster data to the GPU
+     * @param viewProjMatrix: view-projection matrix of the camera
+     * @param lights: all point lights, disabled lights are skipped
+     */
+    void update(const glm::mat4& viewProjMatrix, const std::vector<PointLight>& lights);
+
+    /*!
+     * Binds the cluster texture buffers and sets the cluster uniforms of a shader
+     * @param shader: the shader, which has to be in use
+     * @param firstTextureUnit: the first of three consecutive texture units to bind the buffers to
+     */
+    void setUniforms(Shader& shader, unsigned int firstTextureUnit);
+
+    /*!
+     * @return the projection matrix the grid is built for
+     */
+    const glm::mat4& getProjectionMatrix() const { return _projMatrix; }
+
+    /*!
+     * @return offset and light count of every cluster, index = x + GRID_X * (y + GRID_Y * z)
+     */
+    const std::vector<glm::uvec2>& getClusterRanges() const { return _clusterRanges; }
+
+    /*!
+     * @return the light lists of all clusters
+     */
+    const std::vector<unsigned int>& getLightIndices() const { return _lightIndices; }
+
+    /*!
+     * Computes the distance at which a point light's contribution drops below a threshold
+     * @param light: the point light
+     * @param threshold: the smallest contribution that is still considered
+     * @return the range of the light
+     */
+    static float computeLightRange(const PointLight& light, float threshold = 1.0f / 256.0f);
+};
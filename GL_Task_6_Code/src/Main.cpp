@@ -5,12 +5,31 @@
  */
 
 #include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <sstream>
+#include "Benchmark.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "CommandLine.h"
+#include "CpuProfiler.h"
+#include "DrawList.h"
+#include "DynamicResolution.h"
 #include "Shader.h"
+#include "ShaderCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderVariants.h"
+#include "TextureStreamer.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "FrameReadback.h"
 #include "Geometry.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
 #include "Material.h"
 #include "Light.h"
+#include "LightClusters.h"
 #include "Texture.h"
 
 // ASSIMP tests
@@ -19,7 +38,13 @@
 #include <assimp/postprocess.h>
 #include <iostream>
 #include "ModelLoader.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
 #include "Player.h"
+#include "Systems.h"
+#include "RenderSnapshot.h"
+#include "ShadowMaps.h"
+#include <thread>
 
 #undef min
 #undef max
@@ -41,7 +66,8 @@ static std::string FormatDebugOutput(GLenum source, GLenum type, GLuint id, GLen
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void setPerFrameUniforms(Shader* shader, Camera& camera, DirectionalLight& dirL, PointLight& pointL);
+void setPerFrameUniforms(Shader* shader, const FrameSnapshot& frame, LightClusters& lightClusters, ShadowMaps& shadowMaps);
+uint32_t getShaderFeatures(bool shadows);
 
 /* --------------------------------------------- */
 // Global variables
@@ -49,6 +75,11 @@ void setPerFrameUniforms(Shader* shader, Camera& camera, DirectionalLight& dirL,
 
 static bool _wireframe = false;
 static bool _culling = false;
+static bool _occlusion_culling = false;
+static bool _occlusion_queries = false;
+static bool _shadows = true;
+static bool _frame_statistics = false;
+static bool _screenshot = false;
 
 static bool _draw_normals = false;
 static bool _draw_texcoords = false;
@@ -66,6 +97,13 @@ int main(int argc, char** argv) {
 
     CMDLineArgs cmdline_args;
     gcgParseArgs(cmdline_args, argc, argv);
+    EngineArgs engine_args;
+    parseEngineArgs(engine_args, argc, argv);
+
+    CpuProfiler::setThreadName("Main");
+    if (engine_args.trace_startup) {
+        CpuProfiler::setEnabled(true);
+    }
 
     /* --------------------------------------------- */
     // Load settings.ini
@@ -78,6 +116,12 @@ int main(int argc, char** argv) {
     int refresh_rate = window_reader.GetInteger("window", "refresh_rate", 60);
     bool fullscreen = window_reader.GetBoolean("window", "fullscreen", false);
     std::string window_title = window_reader.Get("window", "title", "GCG 2023");
+    // 0 disables vsync, 2 presents every second refresh
+    int swap_interval = window_reader.GetInteger("window", "swap_interval", 1);
+    // 0 disables the frame rate limit
+    double frame_rate_limit = window_reader.GetReal("window", "frame_rate_limit", 0.0);
+    int simulation_rate = window_reader.GetInteger("window", "simulation_rate", 60);
+    _frame_statistics = window_reader.GetBoolean("window", "frame_statistics", false);
     std::string init_camera_filepath = "assets/settings/camera_front.ini";
     if (cmdline_args.init_camera) {
         init_camera_filepath = cmdline_args.init_camera_filepath;
@@ -89,6 +133,15 @@ int main(int argc, char** argv) {
     float farZ = float(camera_reader.GetReal("camera", "far", 100.0f));
     float camera_yaw = static_cast<float>(camera_reader.GetReal("camera", "yaw", 0.0f));
     float camera_pitch = static_cast<float>(camera_reader.GetReal("camera", "pitch", 0.0f));
+    CameraPath camera_path(camera_reader);
+    if (engine_args.benchmark) {
+        // as many frames as possible, each one advances the simulation by exactly one step
+        swap_interval = 0;
+        frame_rate_limit = 0.0;
+        if (camera_path.isEmpty()) {
+            std::cout << "Benchmark: " << init_camera_filepath << " has no camera path, the camera stays fixed" << std::endl;
+        }
+    }
 
     std::string init_renderer_filepath = "assets/settings/renderer_standard.ini";
     if (cmdline_args.init_renderer) {
@@ -101,6 +154,37 @@ int main(int argc, char** argv) {
     _draw_normals = renderer_reader.GetBoolean("renderer", "normals", false);
     _draw_texcoords = renderer_reader.GetBoolean("renderer", "texcoords", false);
     bool _depthtest = renderer_reader.GetBoolean("renderer", "depthtest", true);
+    _occlusion_culling = renderer_reader.GetBoolean("renderer", "occlusion_culling", false);
+    int occlusion_width = renderer_reader.GetInteger("renderer", "occlusion_width", 256);
+    int occlusion_height = renderer_reader.GetInteger("renderer", "occlusion_height", 128);
+    _occlusion_queries = renderer_reader.GetBoolean("renderer", "occlusion_queries", false);
+    int occlusion_query_threshold = renderer_reader.GetInteger("renderer", "occlusion_query_threshold", 3000);
+    bool _depth_prepass = renderer_reader.GetBoolean("renderer", "depth_prepass", false) && _depthtest;
+    GLenum depth_prepass_func = renderer_reader.Get("renderer", "depth_prepass_func", "equal") == "lequal" ? GL_LEQUAL : GL_EQUAL;
+    int extra_point_lights = renderer_reader.GetInteger("renderer", "extra_point_lights", 0);
+    _shadows = renderer_reader.GetBoolean("renderer", "shadows", true);
+    int shadow_resolution = renderer_reader.GetInteger("renderer", "shadow_resolution", 2048);
+    int shadow_cascades = renderer_reader.GetInteger("renderer", "shadow_cascades", 4);
+    float shadow_distance = float(renderer_reader.GetReal("renderer", "shadow_distance", 20.0));
+    bool dynamic_resolution = renderer_reader.GetBoolean("renderer", "dynamic_resolution", false);
+    float resolution_scale_min = float(renderer_reader.GetReal("renderer", "resolution_scale_min", 0.5));
+    float resolution_scale_max = float(renderer_reader.GetReal("renderer", "resolution_scale_max", 1.0));
+    float gpu_frame_budget = float(renderer_reader.GetReal("renderer", "gpu_frame_budget_ms", 1000.0 / std::max(1, refresh_rate) * 0.9)) * 0.001f;
+    float sharpness = float(renderer_reader.GetReal("renderer", "sharpness", 0.5));
+    int msaa_samples = renderer_reader.GetInteger("renderer", "msaa_samples", 4);
+    bool gpu_profiler = renderer_reader.GetBoolean("renderer", "gpu_profiler", false);
+    bool gpu_profile_draws = renderer_reader.GetBoolean("renderer", "gpu_profile_draws", false);
+    std::string gpu_profiler_csv = renderer_reader.Get("renderer", "gpu_profiler_csv", "");
+    // linked programs are cached across runs, empty disables the cache
+    getShaderCache().setDirectory(renderer_reader.Get("renderer", "shader_cache", "shader_cache"));
+    // shader variants needed mid-session compile in the background, objects are drawn with a fallback meanwhile
+    bool async_shaders = renderer_reader.GetBoolean("renderer", "async_shaders", true);
+    // model textures start at their small mip levels and stream in finer ones within the budget, 0 loads them completely
+    getTextureStreamer().setBudget(
+        size_t(std::max(0L, renderer_reader.GetInteger("renderer", "texture_budget_mb", 256))) << 20,
+        size_t(std::max(1L, renderer_reader.GetInteger("renderer", "texture_upload_mb", 16))) << 20,
+        unsigned(std::max(1L, renderer_reader.GetInteger("renderer", "texture_floor_size", 64)))
+    );
 
     /* --------------------------------------------- */
     // Create context
@@ -121,8 +205,8 @@ int main(int argc, char** argv) {
     glfwWindowHint(GLFW_REFRESH_RATE, refresh_rate);               // Set refresh rate
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-    // Enable antialiasing (4xMSAA)
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // Enable antialiasing (4xMSAA), with dynamic resolution the offscreen framebuffer is multisampled instead
+    glfwWindowHint(GLFW_SAMPLES, dynamic_resolution ? 0 : msaa_samples);
 
     // Open window
     GLFWmonitor* monitor = nullptr;
@@ -148,6 +232,16 @@ int main(int argc, char** argv) {
     }
     std::cout << "GLEW was initialized." << std::endl;
 
+    // Without the parallel compile extension shaders are built on a hidden window's context that shares the objects
+    GLFWwindow* shader_context = nullptr;
+    if (async_shaders) {
+        if (!GLEW_KHR_parallel_shader_compile) {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            shader_context = glfwCreateWindow(1, 1, "Shader compiler", nullptr, window);
+        }
+        getShaderCompiler().enableAsync(shader_context);
+    }
+
     // Debug callback
     if (glDebugMessageCallback != NULL) {
         // Register your callback function.
@@ -193,16 +287,49 @@ int main(int argc, char** argv) {
     // Initialize scene and render loop
     /* --------------------------------------------- */
     {
+        // Scene graph, holds the transforms of all objects
+        SceneGraph scene;
+        // Entity component system, holds the per-object data used by the per-frame systems
+        EntityWorld entities;
+
         // Modell laden
-        Player player("../assets/models/playermodel/scene.gltf");
+        Player player(scene, entities, "../assets/models/playermodel/scene.gltf");
+        // the player's textures are in texture arrays, its meshes are drawn with the matching variant of the texture shader
+        uint32_t playerShaderFeatures = player.getShaderFeatures();
 
         // Load shader(s)
-        std::shared_ptr<Shader> cornellShader = std::make_shared<Shader>("assets/shaders/cornellGouraud.vert", "assets/shaders/cornellGouraud.frag");
-        std::shared_ptr<Shader> textureShader = std::make_shared<Shader>("assets/shaders/texture.vert", "assets/shaders/texture.frag");
+        std::shared_ptr<ShaderVariants> cornellShader, textureShader;
+        std::shared_ptr<Shader> depthShader, fallbackShader;
+        {
+            PROFILE_ZONE("Compile shaders");
+            fallbackShader = std::make_shared<Shader>("assets/shaders/fallback.vert", "assets/shaders/fallback.frag");
+            cornellShader = std::make_shared<ShaderVariants>("assets/shaders/cornellGouraud.vert", "assets/shaders/cornellGouraud.frag", SHADER_FEATURE_DRAW_NORMALS, fallbackShader);
+            textureShader = std::make_shared<ShaderVariants>(
+                "assets/shaders/texture.vert",
+                "assets/shaders/texture.frag",
+                SHADER_FEATURE_DRAW_NORMALS | SHADER_FEATURE_DRAW_TEXCOORDS | SHADER_FEATURE_SHADOWS | SHADER_FEATURE_TEXTURE_ARRAY,
+                fallbackShader
+            );
+            depthShader = std::make_shared<Shader>("assets/shaders/depth.vert", "assets/shaders/depth.frag");
+
+            // the directional light starts enabled, the other variants are compiled when a debug view or shadows are toggled
+            // both start compiling before the first one is waited for
+            uint32_t initialFeatures = getShaderFeatures(_shadows);
+            cornellShader->get(initialFeatures);
+            textureShader->get(initialFeatures);
+            textureShader->get(initialFeatures | playerShaderFeatures);
+            cornellShader->load(initialFeatures);
+            textureShader->load(initialFeatures);
+            textureShader->load(initialFeatures | playerShaderFeatures);
+        }
 
         // Create textures
-        std::shared_ptr<Texture> woodTexture = std::make_shared<Texture>("assets/textures/wood_texture.dds");
-        std::shared_ptr<Texture> tileTexture = std::make_shared<Texture>("assets/textures/tiles_diffuse.dds");
+        std::shared_ptr<Texture> woodTexture, tileTexture;
+        {
+            PROFILE_ZONE("Load textures");
+            woodTexture = std::make_shared<Texture>("assets/textures/wood_texture.dds");
+            tileTexture = std::make_shared<Texture>("assets/textures/tiles_diffuse.dds");
+        }
 
         // Create materials
         std::shared_ptr<Material> cornellMaterial = std::make_shared<Material>(cornellShader, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.1f, 0.9f, 0.3f), 10.0f);
@@ -218,25 +345,40 @@ int main(int argc, char** argv) {
             glm::vec3(0.0f, -0.5f, 0.0f),
         };
         int numSegments = 42;
-        Geometry cornellBox = Geometry(glm::mat4(1), Geometry::createCornellBoxGeometry(3, 3, 3), cornellMaterial);
+        Geometry cornellBox = Geometry(scene, entities, glm::mat4(1), Geometry::createCornellBoxGeometry(3, 3, 3), cornellMaterial);
+        GeometryData cylinderBezierData = Geometry::createBezierCylinderGeometry(18, controlPoints, numSegments, 0.2f);
         Geometry cube = Geometry(
+            scene,
+            entities,
             glm::rotate(glm::translate(glm::mat4(1), glm::vec3(-0.5f, -0.8f, 0)), glm::radians(45.0f), glm::vec3(0, 1, 0)),
             Geometry::createCubeGeometry(0.34f, 0.34f, 0.34f),
             woodTextureMaterial
         );
         Geometry sphere = Geometry(
-            glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.8f, 0.0f)), Geometry::createSphereGeometry(18, 8, 0.24f), tileTextureMaterial
+            scene,
+            entities,
+            glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, -0.8f, 0.0f)),
+            Geometry::createSphereGeometry(18, 8, 0.24f),
+            tileTextureMaterial
         );
         Geometry cylinderBezier = Geometry(
+            scene,
+            entities,
             glm::translate(glm::mat4(1.0f), glm::vec3(0.5f, 0.0f, 0.0f)),
-            Geometry::createBezierCylinderGeometry(18, controlPoints, numSegments, 0.2f),
+            cylinderBezierData,
             tileTextureMaterial
         );
         Geometry cylinder = Geometry(
+            scene,
+            entities,
             glm::translate(glm::mat4(1.0f), glm::vec3(-0.5f, 0.3f, 0.0f)),
             Geometry::createCylinderGeometry(18, 1.5f, 0.2f),
             woodTextureMaterial
         );
+        // only the bezier cylinder is part of the scene for now
+        for (Geometry* geometry : {&cornellBox, &cube, &sphere, &cylinder}) {
+            geometry->setEnabled(false);
+        }
 
         // Initialize camera
         Camera camera(fov, float(window_width) / float(window_height), nearZ, farZ);
@@ -246,58 +388,420 @@ int main(int argc, char** argv) {
         // Initialize lights
         DirectionalLight dirL(glm::vec3(0.8f), glm::vec3(0.0f, -1.0f, -1.0f));
         PointLight pointL(glm::vec3(1.0f), glm::vec3(0.0f), glm::vec3(1.0f, 0.4f, 0.1f));
+        std::vector<PointLight> pointLights = {pointL};
+        for (int i = 0; i < extra_point_lights; i++) {
+            // small colored lights, spread deterministically over the inside of the Cornell box
+            float angle = float(i) * 2.39996f;
+            float height = std::fmod(float(i) * 0.618034f, 1.0f) * 2.6f - 1.3f;
+            glm::vec3 position = glm::vec3(glm::cos(angle), 0.0f, glm::sin(angle)) * 1.3f + glm::vec3(0.0f, height, 0.0f);
+            glm::vec3 color = glm::vec3(0.5f) + 0.5f * glm::vec3(glm::cos(angle), glm::cos(angle + 2.094f), glm::cos(angle + 4.189f));
+            pointLights.push_back(PointLight(color * 0.5f, position, glm::vec3(1.0f, 4.0f, 60.0f)));
+        }
+        LightClusters lightClusters(fov, float(window_width) / float(window_height), nearZ, farZ);
+
+        // Initialize cascaded shadow maps
+        // static casters are rendered into the cached layers only, dynamic casters every time a cascade is updated
+        ShadowMaps shadowMaps(shadow_resolution, shadow_cascades, fov, float(window_width) / float(window_height), nearZ, farZ, shadow_distance);
+        std::vector<Geometry*> staticCasters = {&cylinderBezier};
+        AABB staticCasterBounds;
+        for (Geometry* caster : staticCasters) {
+            staticCasterBounds.expand(caster->getWorldBounds());
+        }
+        shadowMaps.setCasterBounds(staticCasterBounds);
+
+        // Initialize software occlusion culling
+        OcclusionCuller occlusionCuller(occlusion_width, occlusion_height);
+        // only geometry that is drawn may occlude, the bezier cylinder uses its own triangles and the player its inner hull
+        cylinderBezier.setOccluder(cylinderBezierData);
+        std::vector<const Geometry*> occluders = {&cylinderBezier};
+        auto isVisible = [&](const AABB& worldBounds) { return !_occlusion_culling || occlusionCuller.isVisible(worldBounds); };
+
+        // Initialize occlusion queries for expensive objects
+        OcclusionQueries occlusionQueries(occlusion_query_threshold, nearZ);
+
+        // Offscreen rendering at a resolution that follows the GPU frame time
+        std::unique_ptr<DynamicResolution> dynamicResolution;
+        if (dynamic_resolution) {
+            dynamicResolution.reset(new DynamicResolution(
+                window_width, window_height, resolution_scale_min, resolution_scale_max, gpu_frame_budget, sharpness, msaa_samples
+            ));
+        }
+
+        // GPU timing of the render passes, and optionally of every draw call
+        std::unique_ptr<GpuProfiler> gpuProfiler;
+        if (gpu_profiler) {
+            gpuProfiler.reset(new GpuProfiler(120, gpu_profiler_csv));
+            if (gpu_profile_draws) {
+                GpuProfiler::setDrawProfiler(gpuProfiler.get());
+            }
+        }
+
+        // all shaders of the scene are loaded at this point
+        getShaderCache().logStatistics();
+
+        // Timings of the benchmark run
+        std::unique_ptr<Benchmark> benchmark;
+        if (engine_args.benchmark) {
+            benchmark.reset(new Benchmark(engine_args.benchmark_warmup_frames, engine_args.benchmark_frames));
+        }
+
+        // Screenshots and captured frames are written on background threads
+        // the queue holds a few frames per thread, a slow disk throttles the render thread instead of filling the memory
+        unsigned int image_threads = engine_args.capture ? engine_args.capture_threads : 1;
+        ImageWriter imageWriter(image_threads, engine_args.capture ? image_threads * 2 : 0);
+        std::unique_ptr<FrameCapture> frameCapture;
+        if (engine_args.capture) {
+            // a benchmark frame is one simulation step, so its video plays in real time
+            int capture_rate = engine_args.benchmark ? simulation_rate : frame_rate_limit > 0.0 ? int(frame_rate_limit) : refresh_rate;
+            frameCapture.reset(new FrameCapture(engine_args.capture_path, unsigned(std::max(1, capture_rate)), engine_args.image_format, imageWriter.getEncoderThreadCount()));
+        }
+
+        // Pixels covered by one world unit at distance 1, the texture streamer derives the needed mip levels from it
+        float texture_pixels_per_unit = float(window_height) / (2.0f * std::tan(glm::radians(fov) * 0.5f));
+
+        // Simulation and rendering run on separate threads, connected by double-buffered snapshots
+        // the simulation of frame N+1 overlaps the GL submission of frame N
+        SnapshotBuffer<FrameSnapshot> snapshots;
+
+        // the render thread owns the GL context from here on
+        glfwMakeContextCurrent(nullptr);
+        std::thread renderThread([&]() {
+            glfwMakeContextCurrent(window);
+            glfwSwapInterval(swap_interval);
+            CpuProfiler::setThreadName("Render");
+            bool wireframe = _wireframe;
+            bool culling = _culling;
+
+            GpuProfiler* profiler = gpuProfiler.get();
+            // the pack buffers belong to this thread's context, they are deleted before it is released
+            std::unique_ptr<FrameReadback> frameReadback(new FrameReadback(imageWriter));
+
+            while (const FrameSnapshot* frame = snapshots.acquire()) {
+                PROFILE_ZONE("Render frame");
+                if (benchmark) {
+                    benchmark->beginFrame(frame->number, frame->simulationCpuTime);
+                }
+                if (profiler) {
+                    profiler->beginFrame();
+                }
+
+                // Uploads and other GL work scheduled by jobs
+                getJobSystem().runGLJobs();
+                frameReadback->update();
+                getTextureStreamer().update();
+
+                // Clear backbuffer, the offscreen framebuffer is cleared by begin()
+                if (!dynamicResolution) {
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                }
+
+                // Apply state toggled by the input callbacks
+                if (frame->wireframe != wireframe) {
+                    wireframe = frame->wireframe;
+                    glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+                }
+                if (frame->culling != culling) {
+                    culling = frame->culling;
+                    if (culling)
+                        glEnable(GL_CULL_FACE);
+                    else
+                        glDisable(GL_CULL_FACE);
+                }
+
+                // Update shadow maps
+                if (frame->shadows && frame->dirL.enabled) {
+                    PROFILE_ZONE("Shadows");
+                    GpuScope scope(profiler, "Shadows");
+                    shadowMaps.update(
+                        frame->viewProjMatrix,
+                        frame->dirL.direction,
+                        [&](Shader& shader) { DrawListBuilder::submitDepth(frame->staticCasters, shader); },
+                        [&](Shader& shader) { player.drawDepth(shader, frame->getPlayerModelMatrix()); }
+                    );
+                }
+
+                // Set per-frame uniforms
+                {
+                    GpuScope scope(profiler, "Light clusters");
+                    lightClusters.update(frame->viewProjMatrix, frame->pointLights);
+                }
+                // variants that finished compiling are drawn from this frame on
+                cornellShader->poll();
+                textureShader->poll();
+                setPerFrameUniforms(cornellShader->get(frame->shaderFeatures), *frame, lightClusters, shadowMaps);
+                setPerFrameUniforms(textureShader->get(frame->shaderFeatures), *frame, lightClusters, shadowMaps);
+                if (playerShaderFeatures) {
+                    setPerFrameUniforms(textureShader->get(frame->shaderFeatures | playerShaderFeatures), *frame, lightClusters, shadowMaps);
+                }
+
+                if (dynamicResolution) {
+                    dynamicResolution->begin();
+                }
+
+                if (frame->occlusionQueries) {
+                    occlusionQueries.beginFrame(frame->viewProjMatrix, frame->cameraPosition);
+                } else {
+                    occlusionQueries.skipFrame();
+                }
+
+                // Depth pre-pass, sorted front to back
+                if (_depth_prepass) {
+                    PROFILE_ZONE("Depth pre-pass");
+                    GpuScope scope(profiler, "Depth pre-pass");
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    depthShader->use();
+                    depthShader->setUniform("viewProjMatrix", frame->viewProjMatrix);
+                    // the player's meshes are not part of the draw list, they follow it
+                    frame->drawList.submitDepth(*depthShader, frame->interpolation);
+                    if (frame->playerVisible) {
+                        player.drawDepth(*depthShader, frame->getPlayerModelMatrix());
+                    }
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+                    // shade every pixel only once, the depth buffer is complete already
+                    glDepthFunc(depth_prepass_func);
+                    glDepthMask(GL_FALSE);
+                }
+
+                // Render
+                {
+                    PROFILE_ZONE("Scene");
+                    GpuScope scope(profiler, "Scene");
+                    frame->drawList.submit(frame->shaderFeatures, frame->occlusionQueries ? &occlusionQueries : nullptr, frame->interpolation);
+                }
+
+                // Modell rendern
+                if (frame->playerVisible) {
+                    GpuScope scope(profiler, "Player");
+                    Shader& playerShader = *textureShader->get(frame->shaderFeatures | playerShaderFeatures);
+                    player.requestTextures(frame->getPlayerModelMatrix(), frame->cameraPosition, texture_pixels_per_unit);
+                    if (frame->occlusionQueries) {
+                        player.draw(playerShader, frame->getPlayerModelMatrix(), frame->playerNormalMatrix, occlusionQueries);
+                    } else {
+                        player.draw(playerShader, frame->getPlayerModelMatrix(), frame->playerNormalMatrix);
+                    }
+                }
+
+                if (_depth_prepass) {
+                    // depth writes have to be enabled again for glClear
+                    glDepthMask(GL_TRUE);
+                    glDepthFunc(GL_LESS);
+                }
+
+                if (frame->occlusionQueries) {
+                    occlusionQueries.endFrame(glfwGetTime());
+                }
+
+                if (dynamicResolution) {
+                    GpuScope scope(profiler, "Upscale");
+                    dynamicResolution->end();
+                    if (frame->frameStatistics) {
+                        dynamicResolution->logStatistics(glfwGetTime());
+                    }
+                }
+
+                // Read back the finished frame, the copy completes in the background
+                if (frame->screenshot || cmdline_args.run_headless) {
+                    std::string screenshot_filename = "screenshot_" + std::to_string(frame->number);
+                    if (cmdline_args.run_headless) {
+                        screenshot_filename = cmdline_args.set_filename ? cmdline_args.filename : "screenshot";
+                    }
+                    frameReadback->capture(window_width, window_height, screenshot_filename + "." + engine_args.image_format);
+                }
+                if (frameCapture) {
+                    frameReadback->capture(window_width, window_height, frameCapture->nextFrame());
+                }
+
+                if (profiler) {
+                    profiler->endFrame();
+                    profiler->logStatistics(glfwGetTime());
+                }
+                if (frame->frameStatistics) {
+                    getTextureStreamer().logStatistics(glfwGetTime());
+                }
+
+                if (benchmark) {
+                    benchmark->endFrame();
+                }
+
+                // Swap buffers
+                {
+                    PROFILE_ZONE("glfwSwapBuffers");
+                    glfwSwapBuffers(window);
+                }
 
-        // Render loop
-        float t = float(glfwGetTime());
-        float dt = 0.0f;
-        float t_sum = 0.0f;
+                if (benchmark) {
+                    benchmark->framePresented();
+                    if (benchmark->isFinished()) {
+                        glfwSetWindowShouldClose(window, true);
+                        break;
+                    }
+                } else if (cmdline_args.run_headless) {
+                    glfwSetWindowShouldClose(window, true);
+                    break;
+                }
+            }
+
+            // the writer finishes the queued images on its own
+            frameReadback->flush();
+            if (frameCapture) {
+                std::cout << "Captured " << frameCapture->getFrameCount() << " frames, " << frameReadback->getStallCount()
+                          << " readback stalls, " << imageWriter.getWaitCount() << " waits for the encoders" << std::endl;
+            }
+            frameReadback.reset();
+
+            // stops the simulation thread if the render thread ended first
+            snapshots.close();
+            glfwMakeContextCurrent(nullptr);
+        });
+
+        // Simulation loop
+        // the simulation advances in fixed steps, the render thread blends the transforms of the last two steps
+        FramePacer framePacer(frame_rate_limit);
+        double simulation_step = 1.0 / std::max(1, simulation_rate);
+        double simulation_time = 0.0;
+        double accumulator = 0.0;
+        double t = glfwGetTime();
         double mouse_x, mouse_y;
 
+        // CPU trace of the startup phase or of a range of frames
+        unsigned int simulation_frame = 0;
+        auto finishTrace = [&]() {
+            CpuProfiler::setEnabled(false);
+            CpuProfiler::writeChromeTrace(engine_args.trace_filepath);
+        };
+
         while (!glfwWindowShouldClose(window)) {
-            // Clear backbuffer
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (engine_args.trace) {
+                if (engine_args.trace_startup && simulation_frame == 0) {
+                    finishTrace();
+                } else if (!engine_args.trace_startup && engine_args.trace_frame_count > 0) {
+                    if (simulation_frame == engine_args.trace_first_frame) {
+                        CpuProfiler::setEnabled(true);
+                    } else if (simulation_frame == engine_args.trace_first_frame + engine_args.trace_frame_count) {
+                        finishTrace();
+                    }
+                }
+            }
+            PROFILE_ZONE("Simulation frame");
+
+            // Waits until the render thread picked up the previous frame
+            FrameSnapshot* frame;
+            {
+                PROFILE_ZONE("Wait for render thread");
+                frame = snapshots.beginWrite();
+            }
+            if (!frame)
+                break;
+
+            // Wait for the frame limiter first, input is sampled as late as possible
+            {
+                PROFILE_ZONE("Frame pacing");
+                framePacer.waitForNextFrame();
+            }
+            if (_frame_statistics) {
+                framePacer.logStatistics(glfwGetTime());
+            }
+
+            double frame_start = glfwGetTime();
 
             // Poll events
             glfwPollEvents();
 
-            // Update camera
+            // Update camera, every frame for the lowest latency
             glfwGetCursorPos(window, &mouse_x, &mouse_y);
-            camera.update(int(mouse_x), int(mouse_y), _zoom, _dragging, _strafing);
-
-            // Set per-frame uniforms
-            setPerFrameUniforms(cornellShader.get(), camera, dirL, pointL);
-            setPerFrameUniforms(textureShader.get(), camera, dirL, pointL);
-
-            // Render
-            /*
-            cornellBox.draw();
-            cube.draw();
-            cylinder.draw();
-            sphere.draw();
-            */
-            cylinderBezier.draw();
-
-            // Modell rendern
-            player.draw(*textureShader);
-
-            // Compute frame time
-            dt = t;
-            t = float(glfwGetTime());
-            dt = t - dt;
-            t_sum += dt;
-
-            // Swap buffers
-            glfwSwapBuffers(window);
-
-            if (cmdline_args.run_headless) {
-                std::string screenshot_filename = "screenshot";
-                if (cmdline_args.set_filename) {
-                    screenshot_filename = cmdline_args.filename;
+            {
+                PROFILE_ZONE("Camera::update");
+                if (benchmark && !camera_path.isEmpty()) {
+                    // the path follows the simulation time, the mouse is ignored
+                    CameraKeyframe keyframe = camera_path.evaluate(simulation_frame * simulation_step);
+                    camera.setYaw(keyframe.yaw);
+                    camera.setPitch(keyframe.pitch);
+                    camera.update(int(mouse_x), int(mouse_y), keyframe.zoom, false, false);
+                } else if (benchmark) {
+                    camera.update(int(mouse_x), int(mouse_y), _zoom, false, false);
+                } else {
+                    camera.update(int(mouse_x), int(mouse_y), _zoom, _dragging, _strafing);
                 }
-                saveScreenshot(screenshot_filename, window_width, window_height);
-                break;
             }
+
+            // Fixed simulation steps for the elapsed time, long stalls are not caught up
+            // the benchmark advances exactly one step per frame, independent of the frame rate
+            double now = glfwGetTime();
+            accumulator += benchmark ? simulation_step : std::min(now - t, 0.25);
+            t = now;
+            while (accumulator >= simulation_step) {
+                PROFILE_ZONE("Simulation step");
+                // Update world matrices and bounds
+                updatePlayerTransforms(entities, scene);
+                scene.update();
+                updateWorldBounds(entities, scene);
+
+                simulation_time += simulation_step;
+                accumulator -= simulation_step;
+            }
+
+            // Rasterize occluders
+            if (_occlusion_culling) {
+                PROFILE_ZONE("Rasterize occluders");
+                occlusionCuller.beginFrame(camera.getViewProjectionMatrix());
+                for (const Geometry* occluder : occluders) {
+                    if (!occluder->isEnabled())
+                        continue;
+                    occlusionCuller.addOccluder(*occluder->getOccluder(), occluder->getModelMatrix());
+                }
+                if (player.getOccluder() != nullptr) {
+                    occlusionCuller.addOccluder(*player.getOccluder(), player.getModelMatrix());
+                }
+                occlusionCuller.rasterizeOccluders();
+            }
+
+            frame->viewProjMatrix = camera.getViewProjectionMatrix();
+            frame->cameraPosition = camera.getPosition();
+            frame->dirL = dirL;
+            frame->pointLights = pointLights;
+
+            // Cull and record the draw calls of all renderable entities in parallel
+            frame->drawList.build(entities, scene, frame->viewProjMatrix, frame->cameraPosition, farZ, isVisible);
+            frame->staticCasters.clear();
+            for (Geometry* caster : staticCasters) {
+                frame->staticCasters.push_back(caster->getDrawCommand());
+            }
+            frame->playerModelMatrix = player.getModelMatrix();
+            frame->playerPreviousModelMatrix = player.getNode().getPreviousWorldMatrix();
+            frame->playerNormalMatrix = player.getNode().getNormalMatrix();
+            frame->playerVisible = isVisible(player.getWorldBounds());
+
+            frame->wireframe = _wireframe;
+            frame->culling = _culling;
+            frame->shadows = _shadows;
+            frame->shaderFeatures = getShaderFeatures(_shadows && dirL.enabled);
+            frame->occlusionQueries = _occlusion_queries;
+            frame->frameStatistics = _frame_statistics;
+            frame->screenshot = _screenshot;
+            _screenshot = false;
+
+            frame->time = simulation_time;
+            frame->interpolation = float(accumulator / simulation_step);
+            frame->number = simulation_frame;
+            frame->simulationCpuTime = glfwGetTime() - frame_start;
+
+            snapshots.publish();
+            simulation_frame++;
         }
+
+        snapshots.close();
+        renderThread.join();
+        if (CpuProfiler::isEnabled()) {
+            // ended before the end of the traced range
+            finishTrace();
+        }
+        // the GL objects are destroyed on this thread
+        glfwMakeContextCurrent(window);
+        if (benchmark) {
+            benchmark->writeReport(engine_args.benchmark_filepath, init_renderer_filepath, window_width, window_height);
+        }
+        getTextureStreamer().clear();
     }
 
     /* --------------------------------------------- */
@@ -306,6 +810,12 @@ int main(int argc, char** argv) {
 
     destroyFramework();
 
+    // the worker's context is released before its window is destroyed
+    getShaderCompiler().shutdown();
+    if (shader_context) {
+        glfwDestroyWindow(shader_context);
+    }
+
     /* --------------------------------------------- */
     // Destroy context and exit
     /* --------------------------------------------- */
@@ -316,18 +826,27 @@ int main(int argc, char** argv) {
 }
 
 
-void setPerFrameUniforms(Shader* shader, Camera& camera, DirectionalLight& dirL, PointLight& pointL) {
+void setPerFrameUniforms(Shader* shader, const FrameSnapshot& frame, LightClusters& lightClusters, ShadowMaps& shadowMaps) {
+    PROFILE_FUNCTION();
     shader->use();
-    shader->setUniform("viewProjMatrix", camera.getViewProjectionMatrix());
-    shader->setUniform("camera_world", camera.getPosition());
-
-    shader->setUniform("dirL.color", dirL.color);
-    shader->setUniform("dirL.direction", dirL.direction);
-    shader->setUniform("pointL.color", pointL.color);
-    shader->setUniform("pointL.position", pointL.position);
-    shader->setUniform("pointL.attenuation", pointL.attenuation);
-    shader->setUniform("draw_normals", _draw_normals);
-    shader->setUniform("draw_texcoords", _draw_texcoords);
+    shader->setUniform("viewProjMatrix", frame.viewProjMatrix);
+    shader->setUniform("camera_world", frame.cameraPosition);
+
+    shader->setUniform("dirL.color", frame.dirL.color);
+    shader->setUniform("dirL.direction", frame.dirL.direction);
+    lightClusters.setUniforms(*shader, 4);
+    shadowMaps.setUniforms(*shader, 7);
+}
+
+uint32_t getShaderFeatures(bool shadows) {
+    uint32_t features = 0;
+    if (_draw_normals)
+        features |= SHADER_FEATURE_DRAW_NORMALS;
+    if (_draw_texcoords)
+        features |= SHADER_FEATURE_DRAW_TEXCOORDS;
+    if (shadows)
+        features |= SHADER_FEATURE_SHADOWS;
+    return features;
 }
 
 
@@ -348,6 +867,10 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) { _zoom
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     // F1 - Wireframe
     // F2 - Culling
+    // O - Occlusion culling
+    // Q - Occlusion queries
+    // H - Shadows
+    // F12 - Screenshot
     // Esc - Exit
 
     if (action != GLFW_RELEASE)
@@ -355,16 +878,12 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
     switch (key) {
         case GLFW_KEY_ESCAPE: glfwSetWindowShouldClose(window, true); break;
+        // the GL state is applied by the render thread
         case GLFW_KEY_F1:
             _wireframe = !_wireframe;
-            glPolygonMode(GL_FRONT_AND_BACK, _wireframe ? GL_LINE : GL_FILL);
             break;
         case GLFW_KEY_F2:
             _culling = !_culling;
-            if (_culling)
-                glEnable(GL_CULL_FACE);
-            else
-                glDisable(GL_CULL_FACE);
             break;
         case GLFW_KEY_N:
             _draw_normals = !_draw_normals;
@@ -372,6 +891,18 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         case GLFW_KEY_T:
             _draw_texcoords = !_draw_texcoords;
             break;
+        case GLFW_KEY_O:
+            _occlusion_culling = !_occlusion_culling;
+            break;
+        case GLFW_KEY_Q:
+            _occlusion_queries = !_occlusion_queries;
+            break;
+        case GLFW_KEY_H:
+            _shadows = !_shadows;
+            break;
+        case GLFW_KEY_F12:
+            _screenshot = true;
+            break;
     }
 }
 
@@ -9,40 +9,42 @@
 // Base material
 /* --------------------------------------------- */
 
-Material::Material(std::shared_ptr<Shader> shader, glm::vec3 color, glm::vec3 materialCoefficients, float alpha)
+Material::Material(std::shared_ptr<ShaderVariants> shader, glm::vec3 color, glm::vec3 materialCoefficients, float alpha)
     : _shader(shader)
     , _color(color)
     , _materialCoefficients(materialCoefficients)
     , _alpha(alpha) {}
 
-Material::Material(std::shared_ptr<Shader> shader, glm::vec3 materialCoefficients, float alpha)
+Material::Material(std::shared_ptr<ShaderVariants> shader, glm::vec3 materialCoefficients, float alpha)
     : _shader(shader)
     , _materialCoefficients(materialCoefficients)
     , _alpha(alpha) {}
 
 Material::~Material() {}
 
-Shader* Material::getShader() { return _shader.get(); }
+Shader* Material::getShader(uint32_t features) { return _shader->get(features); }
 
-void Material::setUniforms() {
-    _shader->setUniform("materialCoefficients", _materialCoefficients);
-    _shader->setUniform("specularAlpha", _alpha);
+ShaderVariants* Material::getShaderVariants() { return _shader.get(); }
+
+void Material::setUniforms(Shader& shader) {
+    shader.setUniform("materialCoefficients", _materialCoefficients);
+    shader.setUniform("specularAlpha", _alpha);
 }
 
 /* --------------------------------------------- */
 // Texture material
 /* --------------------------------------------- */
 
-TextureMaterial::TextureMaterial(std::shared_ptr<Shader> shader, glm::vec3 materialCoefficients, float alpha, std::shared_ptr<Texture> diffuseTexture)
+TextureMaterial::TextureMaterial(std::shared_ptr<ShaderVariants> shader, glm::vec3 materialCoefficients, float alpha, std::shared_ptr<Texture> diffuseTexture)
     : Material(shader, materialCoefficients, alpha)
     , _diffuseTexture(diffuseTexture) {}
 
 TextureMaterial::~TextureMaterial() {}
 
-void TextureMaterial::setUniforms() {
-    Material::setUniforms();
+void TextureMaterial::setUniforms(Shader& shader) {
+    Material::setUniforms(shader);
 
     _diffuseTexture->bind(0);
-    _shader->setUniform("diffuseTexture", 0);
+    shader.setUniform("diffuseTexture", 0);
 }
 
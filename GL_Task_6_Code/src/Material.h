@@ -6,6 +6,7 @@
 #pragma once
 
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include <glm/glm.hpp>
 #include <memory>
 #include "Texture.h"
@@ -17,9 +18,9 @@
 class Material {
   protected:
     /*!
-     * The shader used for rendering this material
+     * The shader used for rendering this material, the variant is chosen per frame
      */
-    std::shared_ptr<Shader> _shader;
+    std::shared_ptr<ShaderVariants> _shader;
     /*!
      * The material's color
      */
@@ -43,26 +44,33 @@ class Material {
      * @param materialCoefficients: The material's coefficients (x = ambient, y = diffuse, z = specular)
      * @param alpha: Alpha value, i.e. the shininess constant
      */
-    Material(std::shared_ptr<Shader> shader, glm::vec3 color, glm::vec3 materialCoefficients, float alpha);
+    Material(std::shared_ptr<ShaderVariants> shader, glm::vec3 color, glm::vec3 materialCoefficients, float alpha);
     /*!
      * Base material constructor
      * @param shader: The shader used for rendering this material
      * @param materialCoefficients: The material's coefficients (x = ambient, y = diffuse, z = specular)
      * @param alpha: Alpha value, i.e. the shininess constant
      */
-    Material(std::shared_ptr<Shader> shader, glm::vec3 materialCoefficients, float alpha);
+    Material(std::shared_ptr<ShaderVariants> shader, glm::vec3 materialCoefficients, float alpha);
 
     virtual ~Material();
 
     /*!
      * @return The shader associated with this material
+     * @param features: combination of ShaderFeature bits selecting the variant
      */
-    Shader* getShader();
+    Shader* getShader(uint32_t features = 0);
+
+    /*!
+     * @return All variants of the shader associated with this material
+     */
+    ShaderVariants* getShaderVariants();
 
     /*!
      * Sets this material's parameters as uniforms in the shader
+     * @param shader: the variant of this material's shader that is in use
      */
-    virtual void setUniforms();
+    virtual void setUniforms(Shader& shader);
 };
 
 
@@ -84,13 +92,14 @@ class TextureMaterial : public Material {
      * @param alpha: Alpha value, i.e. the shininess constant
      * @param diffuseTexture: The diffuse texture of this material
      */
-    TextureMaterial(std::shared_ptr<Shader> shader, glm::vec3 materialCoefficients, float alpha, std::shared_ptr<Texture> diffuseTexture);
+    TextureMaterial(std::shared_ptr<ShaderVariants> shader, glm::vec3 materialCoefficients, float alpha, std::shared_ptr<Texture> diffuseTexture);
 
     virtual ~TextureMaterial();
 
     /*!
      * Set's this material's parameters as uniforms in the shader
+     * @param shader: the variant of this material's shader that is in use
      */
-    virtual void setUniforms();
+    virtual void setUniforms(Shader& shader);
 };
 
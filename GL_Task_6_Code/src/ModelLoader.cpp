@@ -1,9 +1,18 @@
 #include "ModelLoader.h"
+#include "CpuProfiler.h"
+#include "GpuProfiler.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
+#include "TextureAtlas.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -12,7 +21,22 @@ ModelLoader::ModelLoader(const std::string& path) {
     loadModel(path);
 }
 
+ModelLoader::~ModelLoader() {
+    for (TextureArray& textureArray : textureArrays) {
+        // gestreamte Textur-Arrays löscht der Texture Streamer
+        if (!textureArray.streamedTexture) {
+            glDeleteTextures(1, &textureArray.handle);
+        }
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &depthVAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &positionVBO);
+}
+
 void ModelLoader::loadModel(const std::string& path) {
+    PROFILE_FUNCTION();
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(path,
         aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
@@ -23,6 +47,8 @@ void ModelLoader::loadModel(const std::string& path) {
     }
 
     processNode(scene->mRootNode, scene);
+    loadTextures();
+    setupBuffers();
 }
 
 void ModelLoader::processNode(aiNode* node, const aiScene* scene) {
@@ -39,6 +65,7 @@ void ModelLoader::processNode(aiNode* node, const aiScene* scene) {
 }
 
 Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
+    PROFILE_FUNCTION();
     Mesh resultMesh;
 
 
@@ -64,6 +91,7 @@ Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
         }
 
         resultMesh.vertices.push_back(vertex);
+        resultMesh.bounds.expand(glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]));
     }
 
     // Extrahiere Indizes
@@ -74,6 +102,21 @@ Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
         }
     }
 
+    // UV-Dichte: Verhältnis der Dreiecksflächen im Texturraum und im Modellraum
+    double uvArea = 0.0, modelArea = 0.0;
+    for (size_t i = 0; i + 2 < resultMesh.indices.size(); i += 3) {
+        const Vertex& a = resultMesh.vertices[resultMesh.indices[i]];
+        const Vertex& b = resultMesh.vertices[resultMesh.indices[i + 1]];
+        const Vertex& c = resultMesh.vertices[resultMesh.indices[i + 2]];
+        glm::vec3 ab = glm::vec3(b.position[0], b.position[1], b.position[2]) - glm::vec3(a.position[0], a.position[1], a.position[2]);
+        glm::vec3 ac = glm::vec3(c.position[0], c.position[1], c.position[2]) - glm::vec3(a.position[0], a.position[1], a.position[2]);
+        glm::vec2 uvAB = glm::vec2(b.texCoords[0] - a.texCoords[0], b.texCoords[1] - a.texCoords[1]);
+        glm::vec2 uvAC = glm::vec2(c.texCoords[0] - a.texCoords[0], c.texCoords[1] - a.texCoords[1]);
+        modelArea += 0.5 * glm::length(glm::cross(ab, ac));
+        uvArea += 0.5 * std::abs(uvAB.x * uvAC.y - uvAB.y * uvAC.x);
+    }
+    resultMesh.uvDensity = modelArea > 0.0 ? float(std::sqrt(uvArea / modelArea)) : 0.0f;
+
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         unsigned int textureCount = material->GetTextureCount(aiTextureType_DIFFUSE);
@@ -88,42 +131,318 @@ Mesh ModelLoader::processMesh(aiMesh* mesh, const aiScene* scene) {
             std::cout << "Versuche, Textur zu laden: " << textureName << std::endl;
 
 
-            std::string fullPath = modelDirectory + textureName;
-
-            resultMesh.textureID = loadTextureFromFile(fullPath);
+            // geladen wird erst in loadTextures(), zusammen mit den Texturen gleicher Größe
+            resultMesh.texturePath = modelDirectory + textureName;
         }
     }
 
-    resultMesh.setupMesh();
+    bounds.expand(resultMesh.bounds);
     return resultMesh;
 }
 
-GLuint ModelLoader::loadTextureFromFile(const std::string& filename) {
+void ModelLoader::loadTextures() {
+    PROFILE_FUNCTION();
+    // Größe jeder Textur, und ob sie in den Atlas darf: klein, und jedes Mesh mit ihr bleibt innerhalb von [0, 1]
+    // (der Atlas kann die Textur nicht wiederholen)
+    struct TextureInfo {
+        int width = 0, height = 0;
+        bool atlas = false;
+    };
+    std::map<std::string, TextureInfo> textures;
+    for (Mesh& mesh : meshes) {
+        if (mesh.texturePath.empty())
+            continue;
+        auto inserted = textures.emplace(mesh.texturePath, TextureInfo());
+        TextureInfo& info = inserted.first->second;
+        if (inserted.second) {
+            int channels = 0;
+            if (!stbi_info(mesh.texturePath.c_str(), &info.width, &info.height, &channels)) {
+                std::cerr << "Fehler beim Laden der Textur: " << mesh.texturePath << " - " << stbi_failure_reason() << std::endl;
+                info.width = info.height = 0;
+            }
+            info.atlas = info.width > 0 && unsigned(std::max(info.width, info.height)) <= ATLAS_MAX_TEXTURE_SIZE;
+        }
+        for (const Vertex& vertex : mesh.vertices) {
+            if (!info.atlas)
+                break;
+            for (float uv : vertex.texCoords) {
+                if (uv < -ATLAS_UV_TOLERANCE || uv > 1.0f + ATLAS_UV_TOLERANCE) {
+                    info.atlas = false;
+                }
+            }
+        }
+    }
+
+    // kleine Texturen teilen sich die Seiten eines Atlas, erst ab zwei Texturen spart das etwas
+    TextureAtlas atlas;
+    std::map<std::string, size_t> atlasImages;
+    if (std::count_if(textures.begin(), textures.end(), [](const std::pair<const std::string, TextureInfo>& entry) { return entry.second.atlas; }) >= 2) {
+        for (auto& entry : textures) {
+            if (!entry.second.atlas)
+                continue;
+            int width, height, nrChannels;
+            unsigned char* data = stbi_load(entry.first.c_str(), &width, &height, &nrChannels, 4);
+            if (data) {
+                atlasImages[entry.first] = atlas.add(std::vector<uint8_t>(data, data + size_t(width) * height * 4), unsigned(width), unsigned(height));
+            } else {
+                std::cerr << "Fehler beim Laden der Textur: " << entry.first << " - " << stbi_failure_reason() << std::endl;
+                entry.second.width = entry.second.height = 0;
+            }
+            stbi_image_free(data);
+        }
+    }
+    int atlasArray = -1;
+    if (!atlasImages.empty()) {
+        atlas.build(ATLAS_MAX_PAGE_SIZE);
+        std::vector<unsigned char> pixels;
+        for (const std::vector<uint8_t>& page : atlas.getPages()) {
+            pixels.insert(pixels.end(), page.begin(), page.end());
+        }
+        // ab der Mip-Stufe getMaxLevel() würden sich benachbarte Texturen mischen, der Atlas wird nicht gestreamt
+        TextureArray textureArray;
+        int pageSize = int(atlas.getPageSize()), pageCount = int(atlas.getPages().size());
+        textureArray.handle = createTextureArray(pixels, pageSize, pageSize, pageCount, int(TextureAtlas::getMaxLevel()));
+        atlasArray = int(textureArrays.size());
+        textureArrays.push_back(textureArray);
+        std::cout << "Textur-Atlas " << pageSize << "x" << pageSize << " mit " << atlasImages.size() << " Texturen auf " << pageCount << " Seiten" << std::endl;
+    }
+
+    // die übrigen Texturen gleicher Größe kommen als Layer in ein gemeinsames Textur-Array, alle werden zu RGBA8 dekodiert
+    struct Group {
+        int width, height;
+        std::vector<std::string> paths;
+    };
+    std::vector<Group> groups;
+    int firstGroupArray = int(textureArrays.size());
+    for (Mesh& mesh : meshes) {
+        if (mesh.texturePath.empty())
+            continue;
+        const TextureInfo& info = textures[mesh.texturePath];
+        if (info.width == 0)
+            continue;
+
+        auto image = atlasImages.find(mesh.texturePath);
+        if (image != atlasImages.end()) {
+            // die Texturkoordinaten zeigen ab jetzt in die Seite des Atlas
+            const AtlasTile& tile = atlas.getTile(image->second);
+            mesh.textureArray = atlasArray;
+            mesh.textureLayer = tile.page;
+            for (Vertex& vertex : mesh.vertices) {
+                vertex.texCoords[0] = vertex.texCoords[0] * tile.uvScale.x + tile.uvOffset.x;
+                vertex.texCoords[1] = vertex.texCoords[1] * tile.uvScale.y + tile.uvOffset.y;
+            }
+            continue;
+        }
+
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const Group& g) { return g.width == info.width && g.height == info.height; });
+        if (group == groups.end()) {
+            group = groups.insert(groups.end(), Group{info.width, info.height, {}});
+        }
+        auto layer = std::find(group->paths.begin(), group->paths.end(), mesh.texturePath);
+        if (layer == group->paths.end()) {
+            layer = group->paths.insert(group->paths.end(), mesh.texturePath);
+        }
+        mesh.textureArray = firstGroupArray + int(group - groups.begin());
+        mesh.textureLayer = unsigned(layer - group->paths.begin());
+    }
+
+    // mit Streaming sind anfangs nur die kleinen Mip-Levels geladen
+    bool streaming = getTextureStreamer().isEnabled();
+    for (const Group& group : groups) {
+        TextureArray textureArray;
+        if (streaming) {
+            textureArray.streamedTexture = getTextureStreamer().loadArray(group.paths);
+            textureArray.handle = textureArray.streamedTexture ? textureArray.streamedTexture->handle : 0;
+        } else {
+            textureArray.handle = loadTextureArray(group.paths, group.width, group.height);
+        }
+        textureArrays.push_back(textureArray);
+        std::cout << "Textur-Array " << group.width << "x" << group.height << " mit " << group.paths.size() << " Layern" << std::endl;
+    }
+
+    for (Mesh& mesh : meshes) {
+        if (mesh.textureArray < 0)
+            continue;
+        mesh.streamedTexture = textureArrays[mesh.textureArray].streamedTexture;
+        for (Vertex& vertex : mesh.vertices) {
+            vertex.textureLayer = mesh.textureLayer;
+        }
+    }
+}
+
+GLuint ModelLoader::loadTextureArray(const std::vector<std::string>& paths, int width, int height) {
+    PROFILE_FUNCTION();
+    size_t layerBytes = size_t(width) * height * 4;
+    std::vector<unsigned char> pixels(layerBytes * paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); i++) {
+        int layerWidth, layerHeight, nrChannels;
+        unsigned char* data = stbi_load(paths[i].c_str(), &layerWidth, &layerHeight, &nrChannels, 4);
+        if (data && layerWidth == width && layerHeight == height) {
+            std::memcpy(&pixels[i * layerBytes], data, layerBytes);
+        } else {
+            std::cerr << "Fehler beim Laden der Textur: " << paths[i] << " - " << (data ? "falsche Größe" : stbi_failure_reason()) << std::endl;
+        }
+        stbi_image_free(data);
+    }
+    return createTextureArray(pixels, width, height, int(paths.size()));
+}
+
+GLuint ModelLoader::createTextureArray(const std::vector<unsigned char>& pixels, int width, int height, int layers, int maxLevel) {
     GLuint textureID;
     glGenTextures(1, &textureID);
-
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = nrChannels == 3 ? GL_RGB : GL_RGBA;
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        std::cerr << "Fehler beim Laden der Textur: " << filename << " - " << stbi_failure_reason() << std::endl;
-
-    }
-    stbi_image_free(data);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
     return textureID;
 }
 
+void ModelLoader::setupBuffers() {
+    PROFILE_FUNCTION();
+    // Meshes mit demselben Textur-Array liegen hintereinander im Index Buffer, Meshes ohne Textur am Ende
+    std::vector<Mesh*> order;
+    for (Mesh& mesh : meshes) {
+        order.push_back(&mesh);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const Mesh* a, const Mesh* b) {
+        int arrayA = a->textureArray, arrayB = b->textureArray;
+        return (arrayA < 0 ? INT_MAX : arrayA) < (arrayB < 0 ? INT_MAX : arrayB);
+    });
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (Mesh* mesh : order) {
+        unsigned int baseVertex = static_cast<unsigned int>(vertices.size());
+        mesh->firstIndex = indices.size();
+        for (unsigned int index : mesh->indices) {
+            indices.push_back(baseVertex + index);
+        }
+        vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
+
+        int textureArray = mesh->textureArray;
+        if (batches.empty() || batches.back().textureArray != textureArray) {
+            batches.push_back(Batch{textureArray, mesh->firstIndex, 0});
+        }
+        batches.back().indexCount += static_cast<GLsizei>(mesh->indices.size());
+    }
+    indexCount = static_cast<GLsizei>(indices.size());
+    if (vertices.empty() || indices.empty())
+        return;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    // VBO für Vertex-Daten
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+
+    // EBO für Indizes
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // Vertex-Attribute (Position, Normal, TexCoords, Tangent, Bitangent, Textur-Array und Layer)
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(Vertex), (void*)offsetof(Vertex, textureLayer));
+
+    glBindVertexArray(0);
+
+    // Eigener, dicht gepackter Positions-Stream für den Depth Pre-Pass
+    std::vector<float> positions;
+    positions.reserve(vertices.size() * 3);
+    for (const Vertex& vertex : vertices) {
+        positions.insert(positions.end(), vertex.position, vertex.position + 3);
+    }
+
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+
+    glBindVertexArray(depthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    glBindVertexArray(0);
+}
+
+uint32_t ModelLoader::getShaderFeatures() const {
+    if (textureArrays.empty())
+        return 0;
+    return SHADER_FEATURE_TEXTURE_ARRAY;
+}
+
+void ModelLoader::bindTextures(Shader& shader, int textureArray) {
+    if (textureArray < 0)
+        return;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArrays[textureArray].handle);
+    shader.setUniform("diffuseTextureArray", 0);
+}
+
 void ModelLoader::Draw(Shader& shader) {
-    for (unsigned int i = 0; i < meshes.size(); i++) {
-        meshes[i].Draw(shader);
+    GpuScope scope(GpuProfiler::getDrawProfiler(), "ModelLoader::Draw");
+    glBindVertexArray(VAO);
+    for (const Batch& batch : batches) {
+        bindTextures(shader, batch.textureArray);
+        glDrawElements(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT, (void*)(batch.firstIndex * sizeof(unsigned int)));
     }
+    glBindVertexArray(0);
+}
+
+void ModelLoader::DrawDepth() {
+    // die Tiefe hängt von keiner Textur ab, ein Draw Call für alle Meshes
+    glBindVertexArray(depthVAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
 }
 
+void ModelLoader::Draw(Shader& shader, const glm::mat4& modelMatrix, OcclusionQueries& queries) {
+    for (Mesh& mesh : meshes) {
+        queries.draw(&mesh, mesh.bounds.transformed(modelMatrix), static_cast<unsigned int>(mesh.indices.size()), [&]() {
+            shader.use();
+            bindTextures(shader, mesh.textureArray);
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, (void*)(mesh.firstIndex * sizeof(unsigned int)));
+            glBindVertexArray(0);
+        });
+    }
+}
+
+void ModelLoader::requestTextures(const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit) {
+    // Skalierung der Model-Matrix, die UV-Dichte ist im Modellraum gemessen
+    float scale = std::cbrt(std::abs(glm::determinant(glm::mat3(modelMatrix))));
+    if (scale <= 0.0f || pixelsPerUnit <= 0.0f)
+        return;
+    for (Mesh& mesh : meshes) {
+        if (!mesh.streamedTexture)
+            continue;
+        // der nächste Punkt der Bounding Box bestimmt die größte Darstellung auf dem Bildschirm
+        AABB bounds = mesh.bounds.transformed(modelMatrix);
+        float distance = glm::length(glm::clamp(cameraPosition, bounds.min, bounds.max) - cameraPosition);
+        getTextureStreamer().request(*mesh.streamedTexture, mesh.uvDensity / scale * distance / pixelsPerUnit);
+    }
+}
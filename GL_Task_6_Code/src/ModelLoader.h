@@ -9,7 +9,10 @@
 #include <iostream>
 #include <GL/glew.h>
 
+#include "Bounds.h"
+#include "OcclusionQueries.h"
 #include "Shader.h"
+#include "TextureStreamer.h"
 
 // Struktur für Vertex-Daten
 struct Vertex {
@@ -18,87 +21,96 @@ struct Vertex {
     float texCoords[2];    // Texturkoordinaten
     float tangent[3];      // Tangente für die Texturkoordinaten
     float bitangent[3];    // Bitangente für die Texturkoordinaten
+    unsigned int textureLayer = 0;  // Layer im Textur-Array des Meshes
 };
 
-// Struktur für ein Mesh
+// Struktur für ein Mesh, die Bufferobjekte teilen sich alle Meshes eines Modells
 struct Mesh {
     std::vector<Vertex> vertices;  // Alle Vertices des Meshes
-    std::vector<unsigned int> indices;  // Alle Indices des Meshes
-
-    GLuint VAO, VBO, EBO;  // OpenGL Bufferobjekte (VAO, VBO, EBO)
-    GLuint textureID = 0;   // Textur-ID (0 = keine Textur)
-
-    // Initialisiere Bufferdaten
-    void setupMesh() {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-
-        // VBO für Vertex-Daten
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        // EBO für Indizes
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // Vertex-Attribute (Position, Normal, TexCoords, Tangent, Bitangent)
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-
-        glBindVertexArray(0);
-    }
-
-    // Draw Methode für das Mesh
-    void Draw(Shader& shader) {
-        if (textureID != 0) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            shader.setUniform("diffuseTexture", 0);
-        }
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-    }
+    std::vector<unsigned int> indices;  // Alle Indices des Meshes (bezogen auf seine eigenen Vertices)
+
+    size_t firstIndex = 0;  // Beginn der Indices im gemeinsamen Index Buffer
+    std::string texturePath;  // Diffuse-Textur (leer = keine Textur)
+    int textureArray = -1;    // Index des Textur-Arrays im ModelLoader (-1 = keine Textur)
+    unsigned int textureLayer = 0;  // Layer im Textur-Array
+    StreamedTexture* streamedTexture = nullptr;  // gestreamtes Textur-Array, nullptr = komplett geladen
+    float uvDensity = 0.0f; // Texturkoordinaten-Einheiten pro Längeneinheit im Modellraum
+    AABB bounds;            // Bounding Box im Modellraum
 };
 
 class ModelLoader {
 public:
     // Konstruktor
     ModelLoader(const std::string& path);
+    ~ModelLoader();
+
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    // Texturen bis zu dieser Breite und Höhe werden in einem Atlas zusammengefasst
+    static const unsigned int ATLAS_MAX_TEXTURE_SIZE = 64;
+    // Größe der Atlas-Seiten, reicht eine Seite nicht, kommen weitere als Layer dazu
+    static const unsigned int ATLAS_MAX_PAGE_SIZE = 1024;
+    // Texturkoordinaten so knapp außerhalb von [0, 1] landen noch im Rand der Atlas-Kachel
+    static constexpr float ATLAS_UV_TOLERANCE = 0.01f;
 
     // Laden des Modells
     void loadModel(const std::string& path);
 
     // Zugriff auf die geladenen Meshes
     const std::vector<Mesh>& getMeshes() const { return meshes; }
+
+    // Bounding Box über alle Meshes im Modellraum
+    const AABB& getBounds() const { return bounds; }
     std::string modelDirectory;
 
-    // Draw Methode zum Rendern aller Meshes
+    // ShaderFeature-Bits, mit denen der Shader zum Zeichnen kompiliert sein muss (Textur-Arrays)
+    uint32_t getShaderFeatures() const;
+
+    // Draw Methode zum Rendern aller Meshes, ein Draw Call pro Textur-Array
     void Draw(Shader& shader);
 
+    // Rendert nur die Tiefe aller Meshes
+    void DrawDepth();
+
+    // Rendert alle Meshes, teure Meshes über Occlusion Queries (modelMatrix für die Bounding Boxen)
+    void Draw(Shader& shader, const glm::mat4& modelMatrix, OcclusionQueries& queries);
+
+    // Meldet dem Texture Streamer die benötigten Mip-Levels (pixelsPerUnit: Pixel pro Längeneinheit in Abstand 1)
+    void requestTextures(const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit);
+
 private:
+    // Alle Diffuse-Texturen einer Größe, jede als eigener Layer
+    struct TextureArray {
+        GLuint handle = 0;
+        StreamedTexture* streamedTexture = nullptr;  // gehört dem Texture Streamer, nullptr = komplett geladen
+    };
+
+    // Zusammenhängender Bereich des Index Buffers, der mit einem Draw Call gezeichnet wird
+    struct Batch {
+        int textureArray;  // Textur-Array des Draw Calls (-1 = keine Textur)
+        size_t firstIndex;
+        GLsizei indexCount;
+    };
+
     std::vector<Mesh> meshes; // Alle geladenen Meshes
+    AABB bounds;              // Bounding Box aller Meshes
+    std::vector<TextureArray> textureArrays;
+    std::vector<Batch> batches;
+
+    GLuint VAO = 0, VBO = 0, EBO = 0;  // gemeinsame Bufferobjekte aller Meshes
+    GLuint depthVAO = 0, positionVBO = 0;  // Nur Positionen, für den Depth Pre-Pass
+    GLsizei indexCount = 0;   // Anzahl aller Indices
 
     // Hilfsfunktionen
     void processNode(aiNode* node, const aiScene* scene);
     Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    static GLuint loadTextureFromFile(const std::string& filename);
+    void loadTextures();
+    void setupBuffers();
+    void bindTextures(Shader& shader, int textureArray);
+    static GLuint loadTextureArray(const std::vector<std::string>& paths, int width, int height);
+    // Textur-Array aus RGBA8-Daten, alle Layer hintereinander (maxLevel: gröbste verwendete Mip-Stufe, 1000 ist der GL-Standard)
+    static GLuint createTextureArray(const std::vector<unsigned char>& pixels, int width, int height, int layers, int maxLevel = 1000);
 };
 
 #endif // MODELLOADER_H
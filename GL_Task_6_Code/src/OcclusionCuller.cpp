@@ -0,0 +1,286 @@
+#include "OcclusionCuller.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OCCLUSION_NEON
+#include <arm_neon.h>
+#endif
+
+#undef min
+#undef max
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : _tilesX((std::max(width, 1u) + TILE_WIDTH - 1) / TILE_WIDTH)
+    , _tilesY((std::max(height, 1u) + TILE_HEIGHT - 1) / TILE_HEIGHT)
+    , _viewProjMatrix(1.0f)
+    , _testedObjects(0)
+    , _culledObjects(0) {
+    _width = _tilesX * TILE_WIDTH;
+    _height = _tilesY * TILE_HEIGHT;
+    _depth.assign(size_t(_width) * _height, 1.0f);
+    _tileMaxDepth.assign(size_t(_tilesX) * _tilesY, 1.0f);
+    _bins.resize(size_t(_tilesX) * _tilesY);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjMatrix) {
+    _viewProjMatrix = viewProjMatrix;
+    std::fill(_depth.begin(), _depth.end(), 1.0f);
+    std::fill(_tileMaxDepth.begin(), _tileMaxDepth.end(), 1.0f);
+    _triangles.clear();
+    for (std::vector<unsigned int>& bin : _bins) {
+        bin.clear();
+    }
+    _testedObjects = 0;
+    _culledObjects = 0;
+}
+
+void OcclusionCuller::addOccluder(const OccluderMesh& occluder, const glm::mat4& modelMatrix) {
+    glm::mat4 mvp = _viewProjMatrix * modelMatrix;
+
+    std::vector<glm::vec4> clip(occluder.positions.size());
+    for (size_t i = 0; i < occluder.positions.size(); i++) {
+        clip[i] = mvp * glm::vec4(occluder.positions[i], 1.0f);
+    }
+
+    auto toScreen = [this](const glm::vec4& c) {
+        glm::vec3 ndc = glm::vec3(c) / c.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * float(_width), (ndc.y * 0.5f + 0.5f) * float(_height), ndc.z * 0.5f + 0.5f);
+    };
+
+    for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+        const glm::vec4 tri[3] = {clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]]};
+
+        // trivially reject triangles outside of one of the side planes
+        if ((tri[0].x < -tri[0].w && tri[1].x < -tri[1].w && tri[2].x < -tri[2].w) ||
+            (tri[0].x > tri[0].w && tri[1].x > tri[1].w && tri[2].x > tri[2].w) ||
+            (tri[0].y < -tri[0].w && tri[1].y < -tri[1].w && tri[2].y < -tri[2].w) ||
+            (tri[0].y > tri[0].w && tri[1].y > tri[1].w && tri[2].y > tri[2].w)) {
+            continue;
+        }
+
+        // clip against the near plane (z >= -w), which yields at most four vertices
+        glm::vec4 polygon[4];
+        unsigned int count = 0;
+        for (unsigned int j = 0; j < 3; j++) {
+            const glm::vec4& a = tri[j];
+            const glm::vec4& b = tri[(j + 1) % 3];
+            float da = a.z + a.w;
+            float db = b.z + b.w;
+            if (da >= 0.0f) {
+                polygon[count++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                polygon[count++] = a + (b - a) * (da / (da - db));
+            }
+        }
+        if (count < 3)
+            continue;
+
+        glm::vec3 first = toScreen(polygon[0]);
+        for (unsigned int j = 1; j + 1 < count; j++) {
+            addScreenTriangle(first, toScreen(polygon[j]), toScreen(polygon[j + 1]));
+        }
+    }
+}
+
+void OcclusionCuller::addScreenTriangle(const glm::vec3& v0, const glm::vec3& in1, const glm::vec3& in2) {
+    glm::vec3 v1 = in1;
+    glm::vec3 v2 = in2;
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::abs(area) < 1e-6f)
+        return;
+    // occluders are double sided, so bring every triangle into counter-clockwise order
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    // pixel (x, y) is sampled at its center (x + 0.5, y + 0.5)
+    float minX = std::max(std::ceil(std::min({v0.x, v1.x, v2.x}) - 0.5f), 0.0f);
+    float minY = std::max(std::ceil(std::min({v0.y, v1.y, v2.y}) - 0.5f), 0.0f);
+    float maxX = std::min(std::floor(std::max({v0.x, v1.x, v2.x}) - 0.5f), float(_width - 1));
+    float maxY = std::min(std::floor(std::max({v0.y, v1.y, v2.y}) - 0.5f), float(_height - 1));
+    if (minX > maxX || minY > maxY)
+        return;
+
+    ScreenTriangle tri;
+    tri.minX = int(minX);
+    tri.minY = int(minY);
+    tri.maxX = int(maxX);
+    tri.maxY = int(maxY);
+
+    const glm::vec3* v[3] = {&v0, &v1, &v2};
+    for (unsigned int i = 0; i < 3; i++) {
+        const glm::vec3& a = *v[i];
+        const glm::vec3& b = *v[(i + 1) % 3];
+        tri.edgeA[i] = a.y - b.y;
+        tri.edgeB[i] = b.x - a.x;
+        tri.edgeC[i] = -(tri.edgeA[i] * a.x + tri.edgeB[i] * a.y);
+    }
+
+    glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+    tri.zA = -n.x / n.z;
+    tri.zB = -n.y / n.z;
+    tri.zC = v0.z - tri.zA * v0.x - tri.zB * v0.y;
+
+    unsigned int index = static_cast<unsigned int>(_triangles.size());
+    _triangles.push_back(tri);
+    for (int ty = tri.minY / int(TILE_HEIGHT); ty <= tri.maxY / int(TILE_HEIGHT); ty++) {
+        for (int tx = tri.minX / int(TILE_WIDTH); tx <= tri.maxX / int(TILE_WIDTH); tx++) {
+            _bins[size_t(ty) * _tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeOccluders() {
+    parallelFor(_tilesX * _tilesY, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int tile = begin; tile < end; tile++) {
+            rasterizeTile(tile);
+        }
+    });
+}
+
+void OcclusionCuller::rasterizeTile(unsigned int tile) {
+    const int tileX0 = int((tile % _tilesX) * TILE_WIDTH);
+    const int tileY0 = int((tile / _tilesX) * TILE_HEIGHT);
+    float* depth = &_depth[size_t(tile) * TILE_WIDTH * TILE_HEIGHT];
+
+    for (unsigned int index : _bins[tile]) {
+        const ScreenTriangle& tri = _triangles[index];
+        // the tile origin is a multiple of four, so aligning the first column keeps whole quads inside the tile
+        int minX = std::max(tri.minX, tileX0) & ~3;
+        int maxX = std::min(tri.maxX, tileX0 + int(TILE_WIDTH) - 1);
+        int minY = std::max(tri.minY, tileY0);
+        int maxY = std::min(tri.maxY, tileY0 + int(TILE_HEIGHT) - 1);
+
+        for (int y = minY; y <= maxY; y++) {
+            float py = float(y) + 0.5f;
+            float rowE0 = tri.edgeB[0] * py + tri.edgeC[0];
+            float rowE1 = tri.edgeB[1] * py + tri.edgeC[1];
+            float rowE2 = tri.edgeB[2] * py + tri.edgeC[2];
+            float rowZ = tri.zB * py + tri.zC;
+            float* row = depth + (y - tileY0) * int(TILE_WIDTH) - tileX0;
+
+            for (int x = minX; x <= maxX; x += 4) {
+#if defined(OCCLUSION_SSE2)
+                __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edgeA[0]), px), _mm_set1_ps(rowE0));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edgeA[1]), px), _mm_set1_ps(rowE1));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edgeA[2]), px), _mm_set1_ps(rowE2));
+                __m128 zero = _mm_setzero_ps();
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.zA), px), _mm_set1_ps(rowZ));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+#elif defined(OCCLUSION_NEON)
+                const float offsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+                float32x4_t px = vaddq_f32(vdupq_n_f32(float(x)), vld1q_f32(offsets));
+                float32x4_t e0 = vaddq_f32(vmulq_f32(vdupq_n_f32(tri.edgeA[0]), px), vdupq_n_f32(rowE0));
+                float32x4_t e1 = vaddq_f32(vmulq_f32(vdupq_n_f32(tri.edgeA[1]), px), vdupq_n_f32(rowE1));
+                float32x4_t e2 = vaddq_f32(vmulq_f32(vdupq_n_f32(tri.edgeA[2]), px), vdupq_n_f32(rowE2));
+                float32x4_t zero = vdupq_n_f32(0.0f);
+                uint32x4_t inside = vandq_u32(vandq_u32(vcgeq_f32(e0, zero), vcgeq_f32(e1, zero)), vcgeq_f32(e2, zero));
+                float32x4_t z = vaddq_f32(vmulq_f32(vdupq_n_f32(tri.zA), px), vdupq_n_f32(rowZ));
+                float32x4_t old = vld1q_f32(row + x);
+                vst1q_f32(row + x, vbslq_f32(inside, vminq_f32(old, z), old));
+#else
+                for (int lane = 0; lane < 4; lane++) {
+                    float px = float(x) + (float(lane) + 0.5f);
+                    bool inside = tri.edgeA[0] * px + rowE0 >= 0.0f && tri.edgeA[1] * px + rowE1 >= 0.0f && tri.edgeA[2] * px + rowE2 >= 0.0f;
+                    float z = tri.zA * px + rowZ;
+                    if (inside && z < row[x + lane]) {
+                        row[x + lane] = z;
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    _tileMaxDepth[tile] = *std::max_element(depth, depth + TILE_WIDTH * TILE_HEIGHT);
+}
+
+bool OcclusionCuller::isVisible(const AABB& worldBounds) const {
+    _testedObjects++;
+
+    float minX = std::numeric_limits<float>::max(), minY = minX, minZ = minX;
+    float maxX = -minX, maxY = -minX;
+    for (unsigned int i = 0; i < 8; i++) {
+        glm::vec4 clip = _viewProjMatrix * glm::vec4(worldBounds.getCorner(i), 1.0f);
+        if (clip.z < -clip.w) {
+            // the box reaches through the near plane, so we can't say anything about it
+            return true;
+        }
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * float(_width);
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * float(_height);
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    // clamp before converting, the projected box may be huge
+    float fx0 = std::floor(std::max(minX, 0.0f));
+    float fy0 = std::floor(std::max(minY, 0.0f));
+    float fx1 = std::floor(std::min(maxX, float(_width - 1)));
+    float fy1 = std::floor(std::min(maxY, float(_height - 1)));
+    if (fx0 > fx1 || fy0 > fy1 || minZ > 1.0f) {
+        // outside of the view frustum
+        _culledObjects++;
+        return false;
+    }
+    int x0 = int(fx0), y0 = int(fy0), x1 = int(fx1), y1 = int(fy1);
+
+    for (int ty = y0 / int(TILE_HEIGHT); ty <= y1 / int(TILE_HEIGHT); ty++) {
+        for (int tx = x0 / int(TILE_WIDTH); tx <= x1 / int(TILE_WIDTH); tx++) {
+            unsigned int tile = unsigned(ty) * _tilesX + unsigned(tx);
+            if (minZ > _tileMaxDepth[tile])
+                continue; // every pixel of this tile is in front of the box
+
+            const int tileX0 = tx * int(TILE_WIDTH);
+            const int tileY0 = ty * int(TILE_HEIGHT);
+            const float* depth = &_depth[size_t(tile) * TILE_WIDTH * TILE_HEIGHT];
+            for (int y = std::max(y0, tileY0); y <= std::min(y1, tileY0 + int(TILE_HEIGHT) - 1); y++) {
+                const float* row = depth + (y - tileY0) * int(TILE_WIDTH) - tileX0;
+                for (int x = std::max(x0, tileX0); x <= std::min(x1, tileX0 + int(TILE_WIDTH) - 1); x++) {
+                    if (minZ <= row[x])
+                        return true;
+                }
+            }
+        }
+    }
+
+    _culledObjects++;
+    return false;
+}
+
+float OcclusionCuller::getDepth(unsigned int x, unsigned int y) const {
+    unsigned int tile = (y / TILE_HEIGHT) * _tilesX + x / TILE_WIDTH;
+    return _depth[size_t(tile) * TILE_WIDTH * TILE_HEIGHT + (y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH];
+}
+
+OccluderMesh OcclusionCuller::createBoxOccluder(const AABB& box) {
+    OccluderMesh mesh;
+    for (unsigned int i = 0; i < 8; i++) {
+        mesh.positions.push_back(box.getCorner(i));
+    }
+    // clang-format off
+    mesh.indices = {
+        0, 2, 1, 1, 2, 3, // -z
+        4, 5, 6, 5, 7, 6, // +z
+        0, 1, 4, 1, 5, 4, // -y
+        2, 6, 3, 3, 6, 7, // +y
+        0, 4, 2, 2, 4, 6, // -x
+        1, 3, 5, 3, 7, 5  // +x
+    };
+    // clang-format on
+    return mesh;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Bounds.h"
+#include <atomic>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*!
+ * Triangle mesh used to occlude other objects in the software depth buffer.
+ * Occluders should lie inside the rendered geometry (e.g. a box or a simplified hull)
+ * so that they never hide anything that would be visible on screen.
+ */
+struct OccluderMesh {
+    /*!
+     * Vertex positions in object space
+     */
+    std::vector<glm::vec3> positions;
+    /*!
+     * Triangle indices
+     */
+    std::vector<unsigned int> indices;
+};
+
+/*!
+ * CPU occlusion culling with a low resolution software depth buffer.
+ * Occluders are rasterized into a tiled depth buffer (4-wide SIMD, tiles processed in parallel)
+ * and bounding boxes are then tested against it before their objects are drawn.
+ * The result does not depend on the number of threads, and no GL context is needed.
+ */
+class OcclusionCuller {
+  public:
+    /*!
+     * Width of a depth buffer tile in pixels
+     */
+    static const unsigned int TILE_WIDTH = 32;
+    /*!
+     * Height of a depth buffer tile in pixels
+     */
+    static const unsigned int TILE_HEIGHT = 8;
+
+  protected:
+    /*!
+     * Screen space triangle, set up for rasterization
+     */
+    struct ScreenTriangle {
+        // edge functions e(x, y) = a * x + b * y + c, all >= 0 inside
+        float edgeA[3], edgeB[3], edgeC[3];
+        // depth plane z(x, y) = zA * x + zB * y + zC
+        float zA, zB, zC;
+        // covered pixel range (inclusive)
+        int minX, minY, maxX, maxY;
+    };
+
+    unsigned int _width, _height;
+    unsigned int _tilesX, _tilesY;
+
+    /*!
+     * Depth values in [0, 1], stored tile by tile (TILE_WIDTH * TILE_HEIGHT floats per tile)
+     */
+    std::vector<float> _depth;
+    /*!
+     * Farthest depth value of every tile, used to skip fully covered tiles when testing
+     */
+    std::vector<float> _tileMaxDepth;
+
+    glm::mat4 _viewProjMatrix;
+    std::vector<ScreenTriangle> _triangles;
+    /*!
+     * Indices into _triangles for every tile, in submission order
+     */
+    std::vector<std::vector<unsigned int>> _bins;
+
+    mutable std::atomic<unsigned int> _testedObjects;
+    mutable std::atomic<unsigned int> _culledObjects;
+
+    /*!
+     * Sets up a screen space triangle and adds it to the bins of the tiles it overlaps
+     */
+    void addScreenTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+
+    /*!
+     * Rasterizes all binned triangles of one tile
+     * @param tile: index of the tile
+     */
+    void rasterizeTile(unsigned int tile);
+
+  public:
+    /*!
+     * Occlusion culler constructor
+     * @param width: width of the depth buffer in pixels, rounded up to whole tiles
+     * @param height: height of the depth buffer in pixels, rounded up to whole tiles
+     */
+    OcclusionCuller(unsigned int width, unsigned int height);
+
+    /*!
+     * Clears the depth buffer and all occluders and sets the camera for the new frame
+     * @param viewProjMatrix: the view-projection matrix of the camera
+     */
+    void beginFrame(const glm::mat4& viewProjMatrix);
+
+    /*!
+     * Transforms, clips and bins the triangles of an occluder
+     * @param occluder: the occluder triangles in object space
+     * @param modelMatrix: model matrix of the occluder
+     */
+    void addOccluder(const OccluderMesh& occluder, const glm::mat4& modelMatrix);
+
+    /*!
+     * Rasterizes all occluders added since beginFrame into the depth buffer
+     */
+    void rasterizeOccluders();
+
+    /*!
+     * Tests a bounding box against the depth buffer.
+     * Boxes that intersect the near plane are always reported as visible.
+     * @param worldBounds: the bounding box in world space
+     * @return false if the box is outside the view or completely hidden behind occluders
+     */
+    bool isVisible(const AABB& worldBounds) const;
+
+    /*!
+     * @return the width of the depth buffer in pixels
+     */
+    unsigned int getWidth() const { return _width; }
+
+    /*!
+     * @return the height of the depth buffer in pixels
+     */
+    unsigned int getHeight() const { return _height; }
+
+    /*!
+     * @param x: pixel column, 0 is the left border
+     * @param y: pixel row, 0 is the bottom border
+     * @return the depth value of the pixel in [0, 1]
+     */
+    float getDepth(unsigned int x, unsigned int y) const;
+
+    /*!
+     * @return the number of occluder triangles submitted this frame (after clipping)
+     */
+    unsigned int getTriangleCount() const { return static_cast<unsigned int>(_triangles.size()); }
+
+    /*!
+     * @return the number of isVisible calls since beginFrame
+     */
+    unsigned int getTestedCount() const { return _testedObjects; }
+
+    /*!
+     * @return the number of isVisible calls since beginFrame that returned false
+     */
+    unsigned int getCulledCount() const { return _culledObjects; }
+
+    /*!
+     * Creates an occluder from a box, e.g. a conservative inner hull of a character
+     * @param box: the box in object space
+     * @return the twelve triangles of the box
+     */
+    static OccluderMesh createBoxOccluder(const AABB& box);
+};
@@ -0,0 +1,150 @@
+#include "OcclusionQueries.h"
+
+OcclusionQueries::OcclusionQueries(unsigned int costThreshold, float nearPlane)
+    : _costThreshold(costThreshold)
+    , _cameraMargin(nearPlane * 2.0f)
+    , _frame(0)
+    , _cameraPosition(0.0f)
+    , _viewProjMatrix(1.0f)
+    , _directDraws(0)
+    , _queriedDraws(0)
+    , _visibleResults(0)
+    , _occludedResults(0)
+    , _pendingResults(0)
+    , _lastLogTime(0.0) {
+    _boundsShader = std::make_shared<Shader>("assets/shaders/bounds.vert", "assets/shaders/bounds.frag");
+
+    // unit cube, scaled to the bounding box in the vertex shader
+    // clang-format off
+    const float positions[] = {
+        0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+        0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1
+    };
+    const unsigned int indices[] = {
+        0, 2, 1, 1, 2, 3,
+        4, 5, 6, 5, 7, 6,
+        0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,
+        0, 4, 2, 2, 4, 6,
+        1, 3, 5, 3, 7, 5
+    };
+    // clang-format on
+
+    glGenVertexArrays(1, &_boxVao);
+    glBindVertexArray(_boxVao);
+
+    glGenBuffers(1, &_boxVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _boxVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glGenBuffers(1, &_boxEbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _boxEbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+OcclusionQueries::~OcclusionQueries() {
+    for (auto& entry : _entries) {
+        glDeleteQueries(2, entry.second.queries);
+    }
+    glDeleteBuffers(1, &_boxVbo);
+    glDeleteBuffers(1, &_boxEbo);
+    glDeleteVertexArrays(1, &_boxVao);
+}
+
+void OcclusionQueries::beginFrame(const glm::mat4& viewProjMatrix, const glm::vec3& cameraPosition) {
+    _frame++;
+    _viewProjMatrix = viewProjMatrix;
+    _cameraPosition = cameraPosition;
+    _directDraws = 0;
+    _queriedDraws = 0;
+    _visibleResults = 0;
+    _occludedResults = 0;
+    _pendingResults = 0;
+
+    _boundsShader->use();
+    _boundsShader->setUniform("viewProjMatrix", viewProjMatrix);
+}
+
+void OcclusionQueries::draw(const void* key, const AABB& worldBounds, unsigned int cost, const std::function<void()>& drawCall) {
+    AABB expanded(worldBounds.min - glm::vec3(_cameraMargin), worldBounds.max + glm::vec3(_cameraMargin));
+    if (cost < _costThreshold || expanded.contains(_cameraPosition)) {
+        _directDraws++;
+        drawCall();
+        return;
+    }
+
+    Entry& entry = _entries[key];
+    if (entry.queries[0] == 0) {
+        glGenQueries(2, entry.queries);
+    }
+    unsigned int current = _frame & 1;
+    unsigned int previous = current ^ 1;
+
+    // issue this frame's query with the bounding box, it is consumed next frame
+    GLboolean culling = glIsEnabled(GL_CULL_FACE);
+    GLboolean depthMask = GL_TRUE;
+    GLint depthFunc = GL_LESS;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glDisable(GL_CULL_FACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+
+    // grow the box a little, faces coinciding with the object's surface (e.g. after a depth pre-pass) must not fail the test
+    glm::vec3 padding = worldBounds.getExtents() * 0.01f + glm::vec3(1e-3f);
+    _boundsShader->use();
+    _boundsShader->setUniform("boundsMin", worldBounds.min - padding);
+    _boundsShader->setUniform("boundsMax", worldBounds.max + padding);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, entry.queries[current]);
+    glBindVertexArray(_boxVao);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(depthMask);
+    glDepthFunc(depthFunc);
+    if (culling) {
+        glEnable(GL_CULL_FACE);
+    }
+
+    _queriedDraws++;
+    if (entry.issuedFrame[previous] != _frame - 1) {
+        // first frame of this object or it was not drawn last frame, the old result may be stale
+        drawCall();
+    } else {
+        // peek at the previous result for the statistics only, this never blocks
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(entry.queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint samplesPassed = 0;
+            glGetQueryObjectuiv(entry.queries[previous], GL_QUERY_RESULT, &samplesPassed);
+            if (samplesPassed)
+                _visibleResults++;
+            else
+                _occludedResults++;
+        } else {
+            _pendingResults++;
+        }
+
+        glBeginConditionalRender(entry.queries[previous], GL_QUERY_NO_WAIT);
+        drawCall();
+        glEndConditionalRender();
+    }
+    entry.issuedFrame[current] = _frame;
+}
+
+void OcclusionQueries::endFrame(double time) {
+    if (time - _lastLogTime < 1.0)
+        return;
+    _lastLogTime = time;
+
+    std::cout << "Occlusion queries: " << _queriedDraws << " queried, " << _directDraws << " drawn directly | last results: " << _visibleResults
+              << " visible, " << _occludedResults << " occluded, " << _pendingResults << " pending" << std::endl;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Shader.h"
+#include <GL/glew.h>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
+
+/*!
+ * GPU occlusion culling with hardware occlusion queries.
+ * Every expensive object first draws its bounding box (depth test only, no writes) inside an occlusion query.
+ * The object itself is drawn with conditional rendering on the query of the previous frame,
+ * so the GPU skips hidden objects without the CPU ever waiting for a query result.
+ */
+class OcclusionQueries {
+  protected:
+    /*!
+     * Query state of a single object, queries alternate between even and odd frames
+     * The frame a query was issued in tells whether its result still belongs to the previous frame, NOT_ISSUED if never issued.
+     */
+    struct Entry {
+        static const unsigned int NOT_ISSUED = ~0u;
+        GLuint queries[2] = {0, 0};
+        unsigned int issuedFrame[2] = {NOT_ISSUED, NOT_ISSUED};
+    };
+
+    /*!
+     * Objects drawn with fewer indices than this are drawn directly
+     */
+    unsigned int _costThreshold;
+
+    /*!
+     * Bounding boxes closer than this to the camera would be clipped by the near plane and are never queried
+     */
+    float _cameraMargin;
+
+    std::unordered_map<const void*, Entry> _entries;
+    std::shared_ptr<Shader> _boundsShader;
+    GLuint _boxVao, _boxVbo, _boxEbo;
+
+    unsigned int _frame;
+    glm::vec3 _cameraPosition;
+    glm::mat4 _viewProjMatrix;
+
+    // statistics of the current frame
+    unsigned int _directDraws, _queriedDraws, _visibleResults, _occludedResults, _pendingResults;
+    double _lastLogTime;
+
+  public:
+    /*!
+     * Occlusion queries constructor, creates the bounding box geometry and shader
+     * @param costThreshold: minimum number of indices of an object to be drawn with occlusion queries
+     * @param nearPlane: distance of the camera's near plane
+     */
+    OcclusionQueries(unsigned int costThreshold, float nearPlane);
+    ~OcclusionQueries();
+
+    /*!
+     * Starts a new frame and resets the per-frame statistics
+     * @param viewProjMatrix: view-projection matrix of the camera
+     * @param cameraPosition: position of the camera in world space
+     */
+    void beginFrame(const glm::mat4& viewProjMatrix, const glm::vec3& cameraPosition);
+
+    /*!
+     * Counts a frame rendered without occlusion queries, so results from before it are not used once they are back on
+     */
+    void skipFrame() { _frame++; }
+
+    /*!
+     * Draws an object under an occlusion query
+     * The draw call has to set up its own shader, since the bounding box shader is bound before.
+     * @param key: identifies the object across frames (e.g. its address)
+     * @param worldBounds: bounding box of the object in world space
+     * @param cost: number of indices drawn by the object
+     * @param drawCall: issues the actual draw call(s) of the object
+     */
+    void draw(const void* key, const AABB& worldBounds, unsigned int cost, const std::function<void()>& drawCall);
+
+    /*!
+     * Ends the frame and logs the statistics (at most once per second)
+     * @param time: current time in seconds
+     */
+    void endFrame(double time);
+
+    /*!
+     * @return the number of objects whose last available query result was visible
+     */
+    unsigned int getVisibleCount() const { return _visibleResults; }
+
+    /*!
+     * @return the number of objects whose last available query result was occluded
+     */
+    unsigned int getOccludedCount() const { return _occludedResults; }
+};
@@ -0,0 +1,38 @@
+#include "Parallel.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+unsigned int getWorkerThreadCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+void parallelFor(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)>& func, unsigned int maxChunks) {
+    if (count == 0)
+        return;
+
+    unsigned int chunks = std::min(count, getWorkerThreadCount());
+    if (maxChunks > 0) {
+        chunks = std::min(chunks, maxChunks);
+    }
+    if (chunks == 1) {
+        func(0, count);
+        return;
+    }
+
+    JobSystem& jobSystem = getJobSystem();
+    std::vector<JobHandle> jobs;
+    jobs.reserve(chunks - 1);
+    for (unsigned int i = 1; i < chunks; i++) {
+        unsigned int begin = unsigned(uint64_t(count) * i / chunks);
+        unsigned int end = unsigned(uint64_t(count) * (i + 1) / chunks);
+        jobs.push_back(jobSystem.run("parallelFor", [&func, begin, end]() { func(begin, end); }));
+    }
+    func(0, unsigned(count / chunks));
+
+    // helps with other jobs while waiting, so parallelFor can be nested inside jobs
+    for (const JobHandle& job : jobs) {
+        jobSystem.wait(job);
+    }
+}
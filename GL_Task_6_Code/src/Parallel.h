@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+/*!
+ * @return the number of threads used by the parallel helpers (at least 1)
+ */
+unsigned int getWorkerThreadCount();
+
+/*!
+ * Splits the range [0, count) into contiguous chunks and processes them in parallel.
+ * There are at most getWorkerThreadCount() chunks, or maxChunks if it is smaller.
+ * The other chunks run as jobs on the job system, the calling thread works on the first chunk
+ * and helps with other jobs until all chunks are done.
+ * @param count: number of items
+ * @param func: called once per chunk with the half-open item range [begin, end)
+ * @param maxChunks: limits the number of chunks, 0 for no limit
+ */
+void parallelFor(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)>& func, unsigned int maxChunks = 0);
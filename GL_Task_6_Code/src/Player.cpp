@@ -1,24 +1,79 @@
 #include "Player.h"
+#include "Components.h"
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 
-Player::Player(const std::string& modelPath) : model_(modelPath) {}
+Player::Player(SceneGraph& scene, EntityWorld& entities, const std::string& modelPath) : node_(scene), entities_(&entities), model_(modelPath) {
+    const AABB& bounds = model_.getBounds();
+    entity_ = entities.create(PlayerStateComponent{}, TransformComponent{node_.getId()}, BoundsComponent{bounds, bounds.transformed(node_.getWorldMatrix())});
 
-glm::vec3 Player::getPosition() const { return position_; }
-float Player::getRotationY() const { return rotationY_; }
-void Player::setPosition(const glm::vec3& pos) { position_ = pos; }
+    // grobe Hülle als Occluder: ein schmaler Kern entlang der längsten Achse (der Körper), Arme und Beine ragen darüber hinaus
+    glm::vec3 extents = bounds.getExtents();
+    float longest = std::max(extents.x, std::max(extents.y, extents.z));
+    glm::vec3 scale(extents.x == longest ? OCCLUDER_LENGTH_SCALE : OCCLUDER_WIDTH_SCALE, extents.y == longest ? OCCLUDER_LENGTH_SCALE : OCCLUDER_WIDTH_SCALE,
+                    extents.z == longest ? OCCLUDER_LENGTH_SCALE : OCCLUDER_WIDTH_SCALE);
+    glm::vec3 center = bounds.getCenter();
+    occluder_ = OcclusionCuller::createBoxOccluder(AABB(center - extents * scale, center + extents * scale));
+}
+
+Player::~Player() { entities_->destroy(entity_); }
+
+glm::vec3 Player::getPosition() const { return entities_->get<PlayerStateComponent>(entity_)->position; }
+float Player::getRotationY() const { return entities_->get<PlayerStateComponent>(entity_)->rotationY; }
+
+const glm::mat4& Player::getModelMatrix() const { return node_.getWorldMatrix(); }
+const SceneNode& Player::getNode() const { return node_; }
+Entity Player::getEntity() const { return entity_; }
+
+AABB Player::getWorldBounds() const { return entities_->get<BoundsComponent>(entity_)->world; }
+
+void Player::setOccluder(const OccluderMesh& occluder) { occluder_ = occluder; }
+const OccluderMesh* Player::getOccluder() const { return occluder_.indices.empty() ? nullptr : &occluder_; }
+
+void Player::setPosition(const glm::vec3& pos) {
+    PlayerStateComponent* state = entities_->get<PlayerStateComponent>(entity_);
+    state->position = pos;
+    state->dirty = true;
+}
 
 void Player::setRotationY(float degrees) {
     // Berechne den Unterschied zur aktuellen Rotation und wende ihn auf die Kamera an
-    float deltaRotation = degrees - rotationY_;
-    rotationY_ = degrees;
+    PlayerStateComponent* state = entities_->get<PlayerStateComponent>(entity_);
+    float deltaRotation = degrees - state->rotationY;
+    state->rotationY = degrees;
+    state->dirty = true;
     //camera_->addAngleAroundPlayer(deltaRotation);  // Kamera mitrotieren lassen
 }
 
-void Player::draw(Shader& shader) {
+uint32_t Player::getShaderFeatures() const { return model_.getShaderFeatures(); }
+
+void Player::draw(Shader& shader) { draw(shader, getModelMatrix(), node_.getNormalMatrix()); }
+
+void Player::drawDepth(Shader& depthShader) { drawDepth(depthShader, getModelMatrix()); }
+
+void Player::draw(Shader& shader, OcclusionQueries& queries) { draw(shader, getModelMatrix(), node_.getNormalMatrix(), queries); }
+
+void Player::draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix) {
     shader.use();
-    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position_);
-    modelMatrix = glm::rotate(modelMatrix, glm::radians(rotationY_), glm::vec3(0, 1, 0));
     shader.setUniform("modelMatrix", modelMatrix);
+    shader.setUniform("normalMatrix", normalMatrix);
 
     model_.Draw(shader);
-}
\ No newline at end of file
+}
+
+void Player::drawDepth(Shader& depthShader, const glm::mat4& modelMatrix) {
+    depthShader.setUniform("modelMatrix", modelMatrix);
+    model_.DrawDepth();
+}
+
+void Player::draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, OcclusionQueries& queries) {
+    shader.use();
+    shader.setUniform("modelMatrix", modelMatrix);
+    shader.setUniform("normalMatrix", normalMatrix);
+
+    model_.Draw(shader, modelMatrix, queries);
+}
+
+void Player::requestTextures(const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit) {
+    model_.requestTextures(modelMatrix, cameraPosition, pixelsPerUnit);
+}
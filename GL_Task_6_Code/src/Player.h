@@ -3,32 +3,67 @@
 
 #include <glm/glm.hpp>
 #include "ModelLoader.h"
+#include "OcclusionCuller.h"
 #include "Shader.h"
+#include "SceneGraph.h"
+#include "EntityWorld.h"
 //#include "PlayerCamera.h"
 
 
 class Player {
 private:
-    glm::vec3 position_ = glm::vec3(0.0f);
-    float rotationY_ = 0.0f;
+    SceneNode node_;  // Knoten im Szenengraph, wird von updatePlayerTransforms() gesetzt
+    EntityWorld* entities_;
+    Entity entity_;  // Position/Rotation (PlayerStateComponent), Transform und Bounds
     ModelLoader model_;
+    OccluderMesh occluder_;  // vereinfachte Hülle für das Occlusion Culling (leer = kein Occluder)
+
+    // Anteil der Bounding Box, den die Hülle entlang der längsten bzw. der anderen Achsen abdeckt
+    static constexpr float OCCLUDER_LENGTH_SCALE = 0.7f;
+    static constexpr float OCCLUDER_WIDTH_SCALE = 0.2f;
     //PlayerCamera* camera_;  // Zeiger auf die Kamera
 
 public:
-    // Konstruktor lädt das Modell
-    Player(const std::string& modelPath);
+    // Konstruktor lädt das Modell und legt einen Knoten im Szenengraph und eine Entity an
+    Player(SceneGraph& scene, EntityWorld& entities, const std::string& modelPath);
+    ~Player();
 
     // Getter
     glm::vec3 getPosition() const;
     float getRotationY() const;
+    const glm::mat4& getModelMatrix() const;
+    const SceneNode& getNode() const;
+    Entity getEntity() const;
+    AABB getWorldBounds() const;
+
+    // Occluder für das Software Occlusion Culling, muss innerhalb des Modells liegen (Standard: Kern der Bounding Box)
+    void setOccluder(const OccluderMesh& occluder);
+    const OccluderMesh* getOccluder() const;
 
-    // Setter
+    // Setter, die Model-Matrix wird erst durch updatePlayerTransforms() und SceneGraph::update() aktualisiert
     void setPosition(const glm::vec3& pos);
     void setRotationY(float degrees);
 
+    // ShaderFeature-Bits, mit denen die Shader-Variante zum Zeichnen des Modells ausgewählt werden muss
+    uint32_t getShaderFeatures() const;
+
     // Zeichnet das Modell
     void draw(Shader& shader);
 
+    // Zeichnet nur die Tiefe des Modells (Depth Pre-Pass, viewProjMatrix muss gesetzt sein)
+    void drawDepth(Shader& depthShader);
+
+    // Zeichnet das Modell, teure Meshes werden über Occlusion Queries bedingt gerendert
+    void draw(Shader& shader, OcclusionQueries& queries);
+
+    // Varianten mit vorgegebenen Matrizen (z.B. aus dem Snapshot des Render-Threads), lesen den Szenengraph nicht
+    void draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix);
+    void drawDepth(Shader& depthShader, const glm::mat4& modelMatrix);
+    void draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat3& normalMatrix, OcclusionQueries& queries);
+
+    // Meldet die für diese Darstellung benötigten Mip-Levels der Texturen an den Texture Streamer
+    void requestTextures(const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, float pixelsPerUnit);
+
     //PlayerCamera* getCamera() const { return camera_; }
 };
 
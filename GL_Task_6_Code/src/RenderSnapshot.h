@@ -0,0 +1,161 @@
+#pragma once
+
+#include "DrawList.h"
+#include "Light.h"
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+
+/*!
+ * Everything the render thread needs to draw one frame, written by the simulation thread
+ * The render thread never touches the scene graph, the entity world or the camera, only this copy.
+ */
+struct FrameSnapshot {
+    glm::mat4 viewProjMatrix;
+    glm::vec3 cameraPosition;
+
+    DirectionalLight dirL;
+    std::vector<PointLight> pointLights;
+
+    /*!
+     * Culled and sorted draw calls of all renderable entities
+     */
+    DrawListBuilder drawList;
+    /*!
+     * Objects rendered into the cached static shadow layers
+     */
+    std::vector<DrawCommand> staticCasters;
+
+    /*!
+     * The player is drawn through its model loader, not through the draw list
+     */
+    glm::mat4 playerModelMatrix;
+    glm::mat4 playerPreviousModelMatrix;
+    glm::mat3 playerNormalMatrix;
+    bool playerVisible;
+
+    bool wireframe;
+    bool culling;
+    bool shadows;
+    /*!
+     * ShaderFeature bits of the variants the scene is drawn with
+     */
+    uint32_t shaderFeatures;
+    bool occlusionQueries;
+    bool frameStatistics;
+    /*!
+     * Set for one frame when a screenshot was requested
+     */
+    bool screenshot;
+
+    /*!
+     * Simulation time of the snapshot in seconds
+     */
+    double time;
+    /*!
+     * Position of the frame between the last two simulation steps, transforms are blended by it
+     */
+    float interpolation;
+    /*!
+     * Number of the simulation frame, counting from 0
+     */
+    unsigned int number;
+    /*!
+     * CPU time the simulation thread spent on the snapshot in seconds, without waiting
+     */
+    double simulationCpuTime;
+
+    /*!
+     * @return the player's model matrix blended between the last two simulation steps
+     */
+    glm::mat4 getPlayerModelMatrix() const { return playerPreviousModelMatrix + (playerModelMatrix - playerPreviousModelMatrix) * interpolation; }
+};
+
+/*!
+ * Double buffer for handing snapshots from one producer thread to one consumer thread
+ * The producer fills one slot while the consumer reads the other. The producer waits in beginWrite()
+ * until the consumer has picked up the previous snapshot, so it runs at most one frame ahead and no frame is skipped.
+ */
+template <typename T> class SnapshotBuffer {
+  protected:
+    static constexpr int SLOT_COUNT = 2;
+
+    T _slots[SLOT_COUNT];
+    int _writing;
+    int _reading;
+    int _latest;
+    /*!
+     * Set when the latest snapshot has not been acquired yet
+     */
+    bool _fresh;
+    bool _closed;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+
+  public:
+    SnapshotBuffer()
+        : _writing(-1)
+        , _reading(-1)
+        , _latest(-1)
+        , _fresh(false)
+        , _closed(false) {}
+
+    SnapshotBuffer(const SnapshotBuffer&) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+    /*!
+     * Waits until the previous snapshot was acquired and returns a slot to fill
+     * The slot still holds an older snapshot, so persistent allocations can be reused.
+     * @return the slot, or nullptr once the buffer is closed
+     */
+    T* beginWrite() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&]() { return !_fresh || _closed; });
+        if (_closed)
+            return nullptr;
+        _writing = _reading == 0 ? 1 : 0;
+        return &_slots[_writing];
+    }
+
+    /*!
+     * Hands the slot returned by beginWrite() to the consumer
+     */
+    void publish() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _latest = _writing;
+            _writing = -1;
+            _fresh = true;
+        }
+        _condition.notify_all();
+    }
+
+    /*!
+     * Waits for a new snapshot, the previously acquired one is released
+     * @return the snapshot, valid until the next call, or nullptr once the buffer is closed
+     */
+    const T* acquire() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _reading = -1;
+        _condition.wait(lock, [&]() { return _fresh || _closed; });
+        if (_closed)
+            return nullptr;
+        _reading = _latest;
+        _fresh = false;
+        _condition.notify_all();
+        return &_slots[_reading];
+    }
+
+    /*!
+     * Wakes up both threads, all further calls return nullptr
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _condition.notify_all();
+    }
+};
@@ -0,0 +1,90 @@
+#include "SceneGraph.h"
+#include "Parallel.h"
+
+namespace {
+
+/*!
+ * Levels with fewer nodes are updated on the calling thread, distributing them costs more than it saves
+ */
+const unsigned int PARALLEL_LEVEL_SIZE = 4096;
+
+} // namespace
+
+NodeId SceneGraph::createNode(const glm::mat4& localMatrix, NodeId parent) {
+    NodeId node = getNodeCount();
+    unsigned int level = parent == NO_PARENT ? 0 : _nodeLevels[parent] + 1;
+
+    _localMatrices.push_back(localMatrix);
+    _worldData.emplace_back();
+    _parents.push_back(parent);
+    _localDirty.push_back(1);
+    _worldChanged.push_back(0);
+    _normalDirty.push_back(0);
+    _nodeLevels.push_back(level);
+    if (_levels.size() <= level) {
+        _levels.resize(level + 1);
+    }
+    _levels[level].push_back(node);
+
+    // valid world matrices right away, so objects can be used before the first update
+    TransformData& world = _worldData[node];
+    world.model = parent == NO_PARENT ? localMatrix : _worldData[parent].model * localMatrix;
+    world.normal = glm::mat4(computeNormalMatrix(world.model));
+    world.previousModel = world.model;
+    return node;
+}
+
+void SceneGraph::setLocalMatrix(NodeId node, const glm::mat4& localMatrix) {
+    _localMatrices[node] = localMatrix;
+    _localDirty[node] = 1;
+}
+
+void SceneGraph::updateNodes(const std::vector<NodeId>& level, unsigned int begin, unsigned int end) {
+    for (unsigned int i = begin; i < end; i++) {
+        NodeId node = level[i];
+        NodeId parent = _parents[node];
+        TransformData& world = _worldData[node];
+        bool changed = _localDirty[node] || (parent != NO_PARENT && _worldChanged[parent]);
+
+        if (changed) {
+            world.previousModel = world.model;
+            world.model = parent == NO_PARENT ? _localMatrices[node] : _worldData[parent].model * _localMatrices[node];
+            _normalDirty[node] = 1;
+        } else if (_worldChanged[node]) {
+            // moved last frame, but not in this one
+            world.previousModel = world.model;
+        }
+        _localDirty[node] = 0;
+        _worldChanged[node] = changed ? 1 : 0;
+    }
+}
+
+void SceneGraph::update(unsigned int maxThreads) {
+    // a level only reads the world matrices of the level above, which is complete at this point
+    for (const std::vector<NodeId>& level : _levels) {
+        unsigned int count = static_cast<unsigned int>(level.size());
+        if (count < PARALLEL_LEVEL_SIZE) {
+            updateNodes(level, 0, count);
+        } else {
+            parallelFor(count, [&](unsigned int begin, unsigned int end) { updateNodes(level, begin, end); }, maxThreads);
+        }
+    }
+}
+
+glm::mat3 SceneGraph::getNormalMatrix(NodeId node) const {
+    TransformData& world = _worldData[node];
+    if (_normalDirty[node]) {
+        world.normal = glm::mat4(computeNormalMatrix(world.model));
+        _normalDirty[node] = 0;
+    }
+    return glm::mat3(world.normal);
+}
+
+const std::vector<TransformData>& SceneGraph::getWorldData() const {
+    for (NodeId node = 0; node < getNodeCount(); node++) {
+        if (_normalDirty[node]) {
+            getNormalMatrix(node);
+        }
+    }
+    return _worldData;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Transform.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*!
+ * Index of a node in a scene graph
+ */
+using NodeId = unsigned int;
+
+/*!
+ * Transform hierarchy, stored as structure of arrays
+ * Nodes are indices into parallel arrays of local matrices, world matrices, parents and dirty bits.
+ * The world matrices are propagated level by level (all nodes of one hierarchy depth at once),
+ * and the nodes of a level are processed in parallel. Normal matrices are only computed when they are asked for,
+ * most changed nodes (e.g. inner nodes of a hierarchy) are never drawn themselves.
+ */
+class SceneGraph {
+  public:
+    /*!
+     * Parent of root nodes
+     */
+    static const NodeId NO_PARENT = ~0u;
+
+  protected:
+    std::vector<glm::mat4> _localMatrices;
+    /*!
+     * World model, normal and previous model matrix of every node, contiguous for bulk uploads
+     * The normal matrices are filled in lazily, see _normalDirty.
+     */
+    mutable std::vector<TransformData> _worldData;
+    std::vector<NodeId> _parents;
+    /*!
+     * Set when the local matrix changed since the last update
+     */
+    std::vector<uint8_t> _localDirty;
+    /*!
+     * Set when the world matrix changed in the last update
+     */
+    std::vector<uint8_t> _worldChanged;
+    /*!
+     * Set when the stored normal matrix does not belong to the world matrix yet
+     */
+    mutable std::vector<uint8_t> _normalDirty;
+    /*!
+     * Nodes of every hierarchy depth, parents are always on a lower level than their children
+     */
+    std::vector<std::vector<NodeId>> _levels;
+    std::vector<unsigned int> _nodeLevels;
+
+    /*!
+     * Updates the nodes [begin, end) of a level
+     */
+    void updateNodes(const std::vector<NodeId>& level, unsigned int begin, unsigned int end);
+
+  public:
+    /*!
+     * Creates a node
+     * @param localMatrix: transformation relative to the parent
+     * @param parent: parent node, or NO_PARENT for a root node
+     * @return the new node
+     */
+    NodeId createNode(const glm::mat4& localMatrix = glm::mat4(1.0f), NodeId parent = NO_PARENT);
+
+    /*!
+     * Sets the local matrix of a node, the world matrices are updated by the next update()
+     * @param node: the node
+     * @param localMatrix: transformation relative to the parent
+     */
+    void setLocalMatrix(NodeId node, const glm::mat4& localMatrix);
+
+    /*!
+     * Propagates changed local matrices to the world matrices of the nodes and their descendants
+     * Has to be called once per frame, after all changes and before rendering.
+     * tests/SceneGraphTest.cpp times it for 100k changed nodes on 1 to getWorkerThreadCount() threads.
+     * @param maxThreads: number of threads a level is spread over, 0 for all worker threads
+     */
+    void update(unsigned int maxThreads = 0);
+
+    /*!
+     * @return the local matrix of a node
+     */
+    const glm::mat4& getLocalMatrix(NodeId node) const { return _localMatrices[node]; }
+
+    /*!
+     * @return the world matrix of a node as of the last update
+     */
+    const glm::mat4& getWorldMatrix(NodeId node) const { return _worldData[node].model; }
+
+    /*!
+     * @return the normal matrix of a node as of the last update, computed on first use after a change
+     * May be called on several threads at once, as long as they ask for different nodes.
+     */
+    glm::mat3 getNormalMatrix(NodeId node) const;
+
+    /*!
+     * @return the world matrix of a node in the frame before the last update
+     */
+    const glm::mat4& getPreviousWorldMatrix(NodeId node) const { return _worldData[node].previousModel; }
+
+    /*!
+     * @return the parent of a node, NO_PARENT for root nodes
+     */
+    NodeId getParent(NodeId node) const { return _parents[node]; }
+
+    /*!
+     * @return whether the world matrix of a node changed in the last update
+     */
+    bool hasChanged(NodeId node) const { return _worldChanged[node] != 0; }
+
+    /*!
+     * @return world matrices of all nodes, indexed by node, computes the pending normal matrices first
+     */
+    const std::vector<TransformData>& getWorldData() const;
+
+    /*!
+     * @return the number of nodes
+     */
+    unsigned int getNodeCount() const { return static_cast<unsigned int>(_parents.size()); }
+};
+
+/*!
+ * Handle to a node, used by objects that are placed in a scene graph
+ */
+class SceneNode {
+  protected:
+    SceneGraph* _graph;
+    NodeId _node;
+
+  public:
+    /*!
+     * Scene node constructor, creates a new node in a scene graph
+     * @param graph: the scene graph
+     * @param localMatrix: transformation relative to the parent
+     * @param parent: parent node, or SceneGraph::NO_PARENT for a root node
+     */
+    SceneNode(SceneGraph& graph, const glm::mat4& localMatrix = glm::mat4(1.0f), NodeId parent = SceneGraph::NO_PARENT)
+        : _graph(&graph)
+        , _node(graph.createNode(localMatrix, parent)) {}
+
+    void setLocalMatrix(const glm::mat4& localMatrix) { _graph->setLocalMatrix(_node, localMatrix); }
+    const glm::mat4& getLocalMatrix() const { return _graph->getLocalMatrix(_node); }
+    const glm::mat4& getWorldMatrix() const { return _graph->getWorldMatrix(_node); }
+    glm::mat3 getNormalMatrix() const { return _graph->getNormalMatrix(_node); }
+    const glm::mat4& getPreviousWorldMatrix() const { return _graph->getPreviousWorldMatrix(_node); }
+    NodeId getId() const { return _node; }
+    SceneGraph& getGraph() const { return *_graph; }
+};
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2023 Vienna University of Technology.
+ * Institute of Computer Graphics and Algorithms.
+ * This file is part of the GCG Lab Framework and must not be redistributed.
+ */
+#include "Shader.h"
+#include "CpuProfiler.h"
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+const char* DEFAULT_VERTEX_SHADER = R"(#version 330 core
+layout(location = 0) in vec3 position;
+uniform mat4 modelMatrix;
+uniform mat4 viewProjMatrix;
+void main() {
+	gl_Position = viewProjMatrix * modelMatrix * vec4(position, 1.0);
+}
+)";
+
+const char* DEFAULT_FRAGMENT_SHADER = R"(#version 330 core
+uniform vec3 color;
+out vec4 fragColor;
+void main() {
+	fragColor = vec4(color, 1.0);
+}
+)";
+
+bool readFile(const std::string& file, std::string& source) {
+    std::ifstream stream(file);
+    if (!stream) {
+        std::cerr << "Could not open shader file " << file << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    source = buffer.str();
+    return true;
+}
+
+/*!
+ * Inserts the defines after the #version directive, which has to stay the first statement
+ */
+std::string injectDefines(const std::string& source, const std::vector<std::string>& defines) {
+    if (defines.empty())
+        return source;
+
+    std::string block;
+    for (const std::string& define : defines) {
+        block += "#define " + define + "\n";
+    }
+    size_t insert = 0;
+    size_t version = source.find("#version");
+    if (version != std::string::npos) {
+        insert = source.find('\n', version);
+        insert = insert == std::string::npos ? source.size() : insert + 1;
+    }
+    // keeps the line numbers of compiler errors pointing at the file
+    std::string head = source.substr(0, insert);
+    size_t line = std::count(head.begin(), head.end(), '\n') + 1;
+    if (!head.empty() && head.back() != '\n') {
+        head += '\n';
+    }
+    return head + block + "#line " + std::to_string(line) + "\n" + source.substr(insert);
+}
+
+} // namespace
+
+namespace engine {
+
+Shader::Shader()
+    : _handle(0)
+    , _vs("default")
+    , _fs("default")
+    , _useFileAsSource(false) {
+    _handle = loadShaders();
+}
+
+Shader::Shader(std::string vs, std::string fs)
+    : _handle(0)
+    , _vs(vs)
+    , _fs(fs)
+    , _useFileAsSource(true) {
+    _handle = loadShaders();
+}
+
+Shader::Shader(std::string vs, std::string fs, std::vector<std::string> defines)
+    : _handle(0)
+    , _vs(vs)
+    , _fs(fs)
+    , _useFileAsSource(true)
+    , _defines(std::move(defines)) {
+    _handle = loadShaders();
+}
+
+Shader::Shader(std::string vs, std::string fs, std::vector<std::string> defines, bool async)
+    : _handle(0)
+    , _vs(vs)
+    , _fs(fs)
+    , _useFileAsSource(true)
+    , _defines(std::move(defines)) {
+    if (async) {
+        _build = startBuild();
+    } else {
+        _handle = loadShaders();
+    }
+}
+
+Shader::~Shader() {
+    // the shader objects of a pending build are only released by finishing it
+    wait();
+    glDeleteProgram(_handle);
+}
+
+GLuint Shader::loadShaders() {
+    PROFILE_FUNCTION();
+    std::shared_ptr<ShaderBuild> build = startBuild();
+    return build ? getShaderCompiler().finish(*build) : 0;
+}
+
+std::shared_ptr<ShaderBuild> Shader::startBuild() {
+    std::string vertexSource = DEFAULT_VERTEX_SHADER, fragmentSource = DEFAULT_FRAGMENT_SHADER;
+    if (_useFileAsSource && (!readFile(_vs, vertexSource) || !readFile(_fs, fragmentSource)))
+        return nullptr;
+    return getShaderCompiler().compile(injectDefines(vertexSource, _defines), injectDefines(fragmentSource, _defines), _vs, _fs);
+}
+
+bool Shader::isReady() {
+    if (_build && getShaderCompiler().isDone(*_build)) {
+        wait();
+    }
+    return !_build;
+}
+
+void Shader::wait() {
+    if (!_build)
+        return;
+    _handle = getShaderCompiler().finish(*_build);
+    _build.reset();
+}
+
+bool Shader::loadShader(std::string file, GLenum shaderType, GLuint& handle) {
+    std::string source;
+    return readFile(file, source) && ShaderCompiler::compileShader(source, shaderType, file, handle);
+}
+
+GLint Shader::getUniformLocation(std::string uniform) {
+    auto location = _locations.find(uniform);
+    if (location != _locations.end())
+        return location->second;
+
+    GLint id = glGetUniformLocation(_handle, uniform.c_str());
+    _locations[uniform] = id;
+    return id;
+}
+
+void Shader::use() const { glUseProgram(_handle); }
+
+void Shader::unuse() const { glUseProgram(0); }
+
+void Shader::setUniform(std::string uniform, const int i) { setUniform(getUniformLocation(uniform), i); }
+
+void Shader::setUniform(GLint location, const int i) { glUniform1i(location, i); }
+
+void Shader::setUniform(std::string uniform, const unsigned int i) { setUniform(getUniformLocation(uniform), i); }
+
+void Shader::setUniform(GLint location, const unsigned int i) { glUniform1ui(location, i); }
+
+void Shader::setUniform(std::string uniform, const float f) { setUniform(getUniformLocation(uniform), f); }
+
+void Shader::setUniform(GLint location, const float f) { glUniform1f(location, f); }
+
+void Shader::setUniform(std::string uniform, const glm::mat4& mat) { setUniform(getUniformLocation(uniform), mat); }
+
+void Shader::setUniform(GLint location, const glm::mat4& mat) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat)); }
+
+void Shader::setUniform(std::string uniform, const glm::mat3& mat) { setUniform(getUniformLocation(uniform), mat); }
+
+void Shader::setUniform(GLint location, const glm::mat3& mat) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(mat)); }
+
+void Shader::setUniform(std::string uniform, const glm::vec2& vec) { setUniform(getUniformLocation(uniform), vec); }
+
+void Shader::setUniform(GLint location, const glm::vec2& vec) { glUniform2fv(location, 1, glm::value_ptr(vec)); }
+
+void Shader::setUniform(std::string uniform, const glm::vec3& vec) { setUniform(getUniformLocation(uniform), vec); }
+
+void Shader::setUniform(GLint location, const glm::vec3& vec) { glUniform3fv(location, 1, glm::value_ptr(vec)); }
+
+void Shader::setUniform(std::string uniform, const glm::vec4& vec) { setUniform(getUniformLocation(uniform), vec); }
+
+void Shader::setUniform(GLint location, const glm::vec4& vec) { glUniform4fv(location, 1, glm::value_ptr(vec)); }
+
+void Shader::setUniformArr(std::string arr, unsigned int i, std::string prop, const glm::vec3& vec) {
+    setUniform(arr + "[" + std::to_string(i) + "]." + prop, vec);
+}
+
+void Shader::setUniformArr(std::string arr, unsigned int i, std::string prop, const float f) {
+    setUniform(arr + "[" + std::to_string(i) + "]." + prop, f);
+}
+
+} // namespace engine
@@ -10,12 +10,22 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "ShaderCompiler.h"
 #include "Utils.h"
 
 
+/*!
+ * The framework library ships its own Shader, built against the original layout of this class.
+ * This implementation lives in a namespace, so none of its symbols match the library's and the library's
+ * Shader object is never linked.
+ */
+namespace engine {
+
 /*!
  * Shader class that encapsulates all shader access
  */
@@ -36,6 +46,16 @@ class Shader {
      */
     bool _useFileAsSource;
 
+    /*!
+     * Preprocessor symbols defined in both stages
+     */
+    std::vector<std::string> _defines;
+
+    /*!
+     * The build of an asynchronously compiled program, nullptr once the program is ready
+     */
+    std::shared_ptr<ShaderBuild> _build;
+
     /*!
      * Stores the shader location names with their location IDs
      */
@@ -47,6 +67,12 @@ class Shader {
      */
     GLuint loadShaders();
 
+    /*!
+     * Reads the sources and starts building the program
+     * @return the build, nullptr if a source could not be read
+     */
+    std::shared_ptr<ShaderBuild> startBuild();
+
     /*!
      * Loads a shader from a given file and compiles it
      * @param file: path to the shader
@@ -76,10 +102,45 @@ class Shader {
      */
     Shader(std::string vs, std::string fs);
 
+    /*!
+     * Shader constructor with specified vertex and fragment shader and preprocessor symbols
+     * Loads and compiles the shader, the symbols are defined right after the #version line of both stages
+     * @param vs: path to the vertex shader
+     * @param fs: path to the fragment shader
+     * @param defines: names of the defined symbols, optionally followed by a space and a value
+     */
+    Shader(std::string vs, std::string fs, std::vector<std::string> defines);
+
+    /*!
+     * Shader constructor with specified vertex and fragment shader and preprocessor symbols
+     * @param vs: path to the vertex shader
+     * @param fs: path to the fragment shader
+     * @param defines: names of the defined symbols, optionally followed by a space and a value
+     * @param async: whether the constructor returns before the program is compiled, see isReady()
+     */
+    Shader(std::string vs, std::string fs, std::vector<std::string> defines, bool async);
+
     ~Shader();
 
+    /*!
+     * Polls an asynchronous build without blocking
+     * @return whether the program is built, it may still have failed (see isValid())
+     */
+    bool isReady();
+
+    /*!
+     * Blocks until an asynchronous build is finished
+     */
+    void wait();
+
+    /*!
+     * @return whether the program is built and linked successfully
+     */
+    bool isValid() const { return !_build && _handle != 0; }
+
     /*!
      * Uses the shader with glUseProgram
+     * An asynchronously built shader has to be ready, otherwise no program is bound
      */
     void use() const;
 
@@ -201,3 +262,7 @@ class Shader {
      */
     void setUniformArr(std::string arr, unsigned int i, std::string prop, const float f);
 };
+
+} // namespace engine
+
+using engine::Shader;
@@ -0,0 +1,170 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const char MAGIC[4] = {'G', 'C', 'G', 'B'};
+
+uint64_t hashString(const char* text, size_t size, uint64_t hash = 14695981039346656037ull) {
+    // FNV-1a
+    for (size_t i = 0; i < size; i++) {
+        hash ^= uint8_t(text[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string getGLString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+} // namespace
+
+ShaderCache::ShaderCache()
+    : _directory("shader_cache")
+    , _driverHash(0)
+    , _supported(false)
+    , _initialized(false)
+    , _hits(0)
+    , _misses(0)
+    , _rejected(0) {}
+
+void ShaderCache::initialize() {
+    if (_initialized)
+        return;
+    _initialized = true;
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    _supported = formats > 0;
+
+    std::string driver = getGLString(GL_VENDOR) + "\n" + getGLString(GL_RENDERER) + "\n" + getGLString(GL_VERSION);
+    _driverHash = hashString(driver.data(), driver.size());
+}
+
+std::string ShaderCache::getFilepath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return (std::filesystem::path(_directory) / name).string();
+}
+
+uint64_t ShaderCache::getKey(const std::string& sources) {
+    initialize();
+    return hashString(sources.data(), sources.size(), _driverHash);
+}
+
+void ShaderCache::prepare(GLuint program) {
+    initialize();
+    if (_supported && !_directory.empty()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+bool ShaderCache::load(uint64_t key, GLuint program) {
+    initialize();
+    if (!_supported || _directory.empty())
+        return false;
+
+    std::string filepath = getFilepath(key);
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        _misses++;
+        return false;
+    }
+
+    char magic[4];
+    uint64_t storedKey = 0;
+    GLenum format = 0;
+    uint32_t size = 0;
+    file.read(magic, 4);
+    file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    std::vector<char> binary(size);
+    file.read(binary.data(), size);
+
+    GLint linked = GL_FALSE;
+    if (file && std::equal(magic, magic + 4, MAGIC) && storedKey == key) {
+        glProgramBinary(program, format, binary.data(), GLsizei(size));
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    file.close();
+
+    if (!linked) {
+        // drivers may reject binaries of an older build even though the version string did not change
+        _rejected++;
+        _misses++;
+        std::error_code error;
+        std::filesystem::remove(filepath, error);
+        return false;
+    }
+    _hits++;
+    return true;
+}
+
+void ShaderCache::store(uint64_t key, GLuint program) {
+    if (!_supported || _directory.empty())
+        return;
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return;
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, size, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+
+    std::string filepath = getFilepath(key);
+    // unique per process, concurrent instances never write into the same temporary file
+    std::string temporary = filepath + "." + std::to_string(std::random_device()()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        uint32_t binarySize = uint32_t(written);
+        file.write(MAGIC, 4);
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(reinterpret_cast<const char*>(&binarySize), sizeof(binarySize));
+        file.write(binary.data(), written);
+        if (!file) {
+            std::cerr << "Could not write shader cache file " << temporary << std::endl;
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, filepath, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+void ShaderCache::logStatistics() const {
+    if (!_supported) {
+        std::cout << "Shader cache: the driver supports no program binary formats" << std::endl;
+        return;
+    }
+    std::cout << "Shader cache: " << _hits << " hits, " << _misses << " misses";
+    if (_rejected > 0) {
+        std::cout << ", " << _rejected << " rejected binaries";
+    }
+    std::cout << std::endl;
+}
+
+ShaderCache& getShaderCache() {
+    static ShaderCache shaderCache;
+    return shaderCache;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+/*!
+ * Persistent cache of linked shader programs
+ * Programs are stored with glGetProgramBinary() under a hash of their sources and of the GL vendor, renderer and
+ * version string, so a driver update invalidates them. A binary the driver rejects is deleted and the program is
+ * compiled from source again. Cache files are written to a temporary file first and renamed, a crash or a second
+ * instance never leaves a truncated binary behind.
+ * All methods have to be called on a thread with a current GL context.
+ */
+class ShaderCache {
+  protected:
+    std::string _directory;
+    /*!
+     * Hash of the GL vendor, renderer and version, computed on first use
+     */
+    uint64_t _driverHash;
+    bool _supported;
+    bool _initialized;
+    unsigned int _hits, _misses, _rejected;
+
+    void initialize();
+    std::string getFilepath(uint64_t key) const;
+
+  public:
+    ShaderCache();
+
+    /*!
+     * @param directory: directory of the cache files, empty to disable the cache
+     */
+    void setDirectory(const std::string& directory) { _directory = directory; }
+
+    /*!
+     * @return the key of a program
+     * @param sources: all sources of the program and anything else that changes the binary (e.g. defines)
+     */
+    uint64_t getKey(const std::string& sources);
+
+    /*!
+     * Loads a cached binary into a program
+     * @param key: key from getKey()
+     * @param program: a program object without shaders
+     * @return whether the program is linked now
+     */
+    bool load(uint64_t key, GLuint program);
+
+    /*!
+     * Has to be called on a program before it is linked, otherwise the driver may not keep its binary
+     * @param program: the program object
+     */
+    void prepare(GLuint program);
+
+    /*!
+     * Stores the binary of a linked program
+     * @param key: key from getKey()
+     * @param program: the linked program
+     */
+    void store(uint64_t key, GLuint program);
+
+    /*!
+     * Prints the number of cache hits and misses
+     */
+    void logStatistics() const;
+};
+
+/*!
+ * @return the cache used by all shaders
+ */
+ShaderCache& getShaderCache();
@@ -0,0 +1,214 @@
+#include "ShaderCompiler.h"
+#include "CpuProfiler.h"
+#include "ShaderCache.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iostream>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Prints the info log of a shader that failed to compile
+ * @return whether the shader compiled
+ */
+bool checkShader(GLuint handle, const std::string& name) {
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(handle, GL_COMPILE_STATUS, &compiled);
+    if (compiled)
+        return true;
+
+    GLint length = 0;
+    glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(handle, length, nullptr, &log[0]);
+    std::cerr << "Shader compilation of " << name << " failed:\n" << log << std::endl;
+    return false;
+}
+
+GLuint createShader(const std::string& source, GLenum shaderType) {
+    GLuint handle = glCreateShader(shaderType);
+    const char* text = source.c_str();
+    glShaderSource(handle, 1, &text, nullptr);
+    glCompileShader(handle);
+    return handle;
+}
+
+} // namespace
+
+ShaderCompiler::ShaderCompiler()
+    : _mode(Mode::SYNCHRONOUS)
+    , _workerContext(nullptr)
+    , _stop(false) {}
+
+ShaderCompiler::~ShaderCompiler() { shutdown(); }
+
+void ShaderCompiler::enableAsync(GLFWwindow* workerContext) {
+    if (_mode != Mode::SYNCHRONOUS)
+        return;
+
+    if (GLEW_KHR_parallel_shader_compile) {
+        // lets the driver choose the number of compiler threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        _mode = Mode::PARALLEL_EXTENSION;
+        std::cout << "Shaders are compiled in parallel by the driver" << std::endl;
+    } else if (workerContext) {
+        _workerContext = workerContext;
+        _stop = false;
+        _mode = Mode::WORKER_CONTEXT;
+        _worker = std::thread(&ShaderCompiler::workerLoop, this);
+        std::cout << "Shaders are compiled on a worker thread" << std::endl;
+    }
+}
+
+void ShaderCompiler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+    _mode = Mode::SYNCHRONOUS;
+}
+
+void ShaderCompiler::issue(ShaderBuild& build) {
+    if (!build.program) {
+        build.program = glCreateProgram();
+    }
+    build.vertexShader = createShader(build.vertexSource, GL_VERTEX_SHADER);
+    build.fragmentShader = createShader(build.fragmentSource, GL_FRAGMENT_SHADER);
+    glAttachShader(build.program, build.vertexShader);
+    glAttachShader(build.program, build.fragmentShader);
+    getShaderCache().prepare(build.program);
+    // a stage that failed to compile makes the link fail, finish() reports which one
+    glLinkProgram(build.program);
+}
+
+void ShaderCompiler::workerLoop() {
+    glfwMakeContextCurrent(_workerContext);
+    CpuProfiler::setThreadName("Shader compiler");
+    while (true) {
+        std::shared_ptr<ShaderBuild> build;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return _stop || !_queue.empty(); });
+            if (_queue.empty())
+                break;
+            build = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        {
+            PROFILE_ZONE("Compile shader");
+            issue(*build);
+            // the render context may only look at the program once the commands have completed
+            glFinish();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            build->issued.store(true, std::memory_order_release);
+        }
+        _issued.notify_all();
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+std::shared_ptr<ShaderBuild> ShaderCompiler::compile(const std::string& vertexSource, const std::string& fragmentSource, const std::string& vs, const std::string& fs) {
+    PROFILE_FUNCTION();
+    std::shared_ptr<ShaderBuild> build = std::make_shared<ShaderBuild>();
+    build->vertexSource = vertexSource;
+    build->fragmentSource = fragmentSource;
+    build->vs = vs;
+    build->fs = fs;
+
+    ShaderCache& cache = getShaderCache();
+    build->key = cache.getKey(vertexSource + '\0' + fragmentSource);
+    build->program = glCreateProgram();
+    if (cache.load(build->key, build->program)) {
+        build->cached = true;
+        return build;
+    }
+
+    if (_mode == Mode::WORKER_CONTEXT) {
+        // a rejected binary may have left this program in a failed state, the worker starts from a fresh one
+        glDeleteProgram(build->program);
+        build->program = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(build);
+        }
+        _wake.notify_one();
+    } else {
+        issue(*build);
+        build->issued.store(true, std::memory_order_release);
+    }
+    return build;
+}
+
+bool ShaderCompiler::isDone(ShaderBuild& build) {
+    if (build.cached)
+        return true;
+    if (!build.issued.load(std::memory_order_acquire))
+        return false;
+    if (_mode == Mode::PARALLEL_EXTENSION) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+    return true;
+}
+
+GLuint ShaderCompiler::finish(ShaderBuild& build) {
+    PROFILE_FUNCTION();
+    if (build.cached)
+        return build.program;
+    if (!build.issued.load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _issued.wait(lock, [&]() { return build.issued.load(std::memory_order_acquire); });
+    }
+
+    // waits for the driver's compiler threads if the build is not done yet
+    GLint linked = GL_FALSE;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+    if (!linked && checkShader(build.vertexShader, build.vs) && checkShader(build.fragmentShader, build.fs)) {
+        GLint length = 0;
+        glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &length);
+        std::string log(std::max(length, 1), '\0');
+        glGetProgramInfoLog(build.program, length, nullptr, &log[0]);
+        std::cerr << "Shader linking of " << build.vs << " and " << build.fs << " failed:\n" << log << std::endl;
+    }
+
+    glDetachShader(build.program, build.vertexShader);
+    glDetachShader(build.program, build.fragmentShader);
+    glDeleteShader(build.vertexShader);
+    glDeleteShader(build.fragmentShader);
+    build.vertexShader = build.fragmentShader = 0;
+
+    if (!linked) {
+        glDeleteProgram(build.program);
+        build.program = 0;
+        return 0;
+    }
+    getShaderCache().store(build.key, build.program);
+    return build.program;
+}
+
+bool ShaderCompiler::compileShader(const std::string& source, GLenum shaderType, const std::string& name, GLuint& handle) {
+    handle = createShader(source, shaderType);
+    if (!checkShader(handle, name)) {
+        glDeleteShader(handle);
+        handle = 0;
+        return false;
+    }
+    return true;
+}
+
+ShaderCompiler& getShaderCompiler() {
+    static ShaderCompiler shaderCompiler;
+    return shaderCompiler;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GLFWwindow;
+
+/*!
+ * A program that is being compiled and linked, created by ShaderCompiler::compile()
+ */
+struct ShaderBuild {
+    std::string vertexSource, fragmentSource;
+    /*!
+     * Names of the stages for error messages, usually the file paths
+     */
+    std::string vs, fs;
+    uint64_t key = 0;
+    GLuint program = 0;
+    GLuint vertexShader = 0, fragmentShader = 0;
+    /*!
+     * Loaded from the shader cache, there is nothing left to compile
+     */
+    bool cached = false;
+    /*!
+     * Set once compiling and linking are issued in the render context, or by the worker thread once they completed
+     */
+    std::atomic<bool> issued{false};
+};
+
+/*!
+ * Compiles and links shader programs without blocking the render thread
+ * With GL_KHR_parallel_shader_compile the driver compiles on its own threads and the completion status is polled.
+ * Without it, a worker thread with a context that shares objects with the render context builds the programs one
+ * after another, the finished program handle is valid in both contexts. Until enableAsync() is called (or if neither
+ * is available) every program is built synchronously in compile().
+ * Status queries, error logs and the shader cache files are only touched on the thread that owns the render context.
+ */
+class ShaderCompiler {
+  public:
+    enum class Mode {
+        SYNCHRONOUS,
+        PARALLEL_EXTENSION,
+        WORKER_CONTEXT,
+    };
+
+  protected:
+    Mode _mode;
+    GLFWwindow* _workerContext;
+    std::thread _worker;
+    std::mutex _mutex;
+    std::condition_variable _wake, _issued;
+    std::deque<std::shared_ptr<ShaderBuild>> _queue;
+    bool _stop;
+
+    /*!
+     * Creates the shader objects and issues compiling and linking, without any status query that would wait for it
+     */
+    static void issue(ShaderBuild& build);
+    void workerLoop();
+
+  public:
+    ShaderCompiler();
+    ~ShaderCompiler();
+
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    /*!
+     * Switches to asynchronous builds, has to be called with the render context current
+     * @param workerContext: hidden window whose context shares objects with the render context, used if the driver
+     * lacks GL_KHR_parallel_shader_compile, may be nullptr
+     */
+    void enableAsync(GLFWwindow* workerContext);
+
+    /*!
+     * Stops the worker thread, builds still in the queue are issued first
+     */
+    void shutdown();
+
+    Mode getMode() const { return _mode; }
+
+    /*!
+     * Starts building a program, a cached binary is loaded right away
+     * @param vertexSource: the vertex shader source
+     * @param fragmentSource: the fragment shader source
+     * @param vs: name of the vertex shader for error messages
+     * @param fs: name of the fragment shader for error messages
+     * @return the build, pass it to isDone() and finish()
+     */
+    std::shared_ptr<ShaderBuild> compile(const std::string& vertexSource, const std::string& fragmentSource, const std::string& vs, const std::string& fs);
+
+    /*!
+     * @return whether finish() would return without waiting
+     * @param build: the build
+     */
+    bool isDone(ShaderBuild& build);
+
+    /*!
+     * Waits for the build if necessary, prints its errors and stores a new binary in the shader cache
+     * @param build: the build, must not be finished twice
+     * @return the linked program, 0 if compiling or linking failed
+     */
+    GLuint finish(ShaderBuild& build);
+
+    /*!
+     * Compiles a single shader and waits for the result
+     * @param source: the shader source
+     * @param shaderType: type of the shader (e.g. GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
+     * @param name: name of the shader for error messages
+     * @param handle: the shader handle, 0 if compiling failed
+     * @return if the shader could be compiled
+     */
+    static bool compileShader(const std::string& source, GLenum shaderType, const std::string& name, GLuint& handle);
+};
+
+/*!
+ * @return the compiler used by all shaders
+ */
+ShaderCompiler& getShaderCompiler();
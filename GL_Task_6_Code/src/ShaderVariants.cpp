@@ -0,0 +1,61 @@
+#include "ShaderVariants.h"
+
+#include <vector>
+
+namespace {
+
+const struct {
+    ShaderFeature feature;
+    const char* define;
+} FEATURE_DEFINES[] = {
+    {SHADER_FEATURE_DRAW_NORMALS, "DRAW_NORMALS"},
+    {SHADER_FEATURE_DRAW_TEXCOORDS, "DRAW_TEXCOORDS"},
+    {SHADER_FEATURE_SHADOWS, "SHADOWS"},
+    {SHADER_FEATURE_TEXTURE_ARRAY, "TEXTURE_ARRAY"},
+};
+
+} // namespace
+
+ShaderVariants::ShaderVariants(const std::string& vs, const std::string& fs, uint32_t supportedFeatures, std::shared_ptr<Shader> fallback)
+    : _vs(vs)
+    , _fs(fs)
+    , _supportedFeatures(supportedFeatures)
+    , _fallback(fallback) {}
+
+Shader* ShaderVariants::getVariant(uint32_t features) {
+    features = getVariantFeatures(features);
+    auto variant = _variants.find(features);
+    if (variant != _variants.end())
+        return variant->second.get();
+
+    std::vector<std::string> defines;
+    for (const auto& entry : FEATURE_DEFINES) {
+        if (features & entry.feature) {
+            defines.push_back(entry.define);
+        }
+    }
+    Shader* shader = new Shader(_vs, _fs, defines, true);
+    _variants.emplace(features, std::unique_ptr<Shader>(shader));
+    return shader;
+}
+
+Shader* ShaderVariants::get(uint32_t features) {
+    Shader* shader = getVariant(features);
+    if (!_fallback) {
+        shader->wait();
+        return shader;
+    }
+    return shader->isValid() ? shader : _fallback.get();
+}
+
+Shader* ShaderVariants::load(uint32_t features) {
+    Shader* shader = getVariant(features);
+    shader->wait();
+    return shader;
+}
+
+void ShaderVariants::poll() {
+    for (auto& variant : _variants) {
+        variant.second->isReady();
+    }
+}
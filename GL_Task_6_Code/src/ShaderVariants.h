@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Shader.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/*!
+ * Optional shader code, each feature is compiled in with a #define of its name instead of branching on a uniform
+ */
+enum ShaderFeature : uint32_t {
+    /*!
+     * DRAW_NORMALS: outputs the world space normal as color
+     */
+    SHADER_FEATURE_DRAW_NORMALS = 1u << 0,
+    /*!
+     * DRAW_TEXCOORDS: outputs the texture coordinates as color
+     */
+    SHADER_FEATURE_DRAW_TEXCOORDS = 1u << 1,
+    /*!
+     * SHADOWS: samples the cascaded shadow maps for the directional light
+     */
+    SHADER_FEATURE_SHADOWS = 1u << 2,
+    /*!
+     * TEXTURE_ARRAY: samples the diffuse texture from a layer of a texture array, given per vertex
+     */
+    SHADER_FEATURE_TEXTURE_ARRAY = 1u << 3,
+};
+
+/*!
+ * The permutations of a shader, one program per combination of features
+ * Variants are compiled on first use, features the shader does not support are ignored so they never produce a
+ * duplicate program. With a fallback shader the compilation does not block: the fallback is returned until poll()
+ * finds the variant's program ready (or forever if it failed to build). Polling once per frame, before the per-frame
+ * uniforms are set, keeps every draw of a frame on the same program.
+ * All methods have to be called on the thread that owns the GL context.
+ */
+class ShaderVariants {
+  protected:
+    std::string _vs, _fs;
+    uint32_t _supportedFeatures;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> _variants;
+    std::shared_ptr<Shader> _fallback;
+
+    Shader* getVariant(uint32_t features);
+
+  public:
+    /*!
+     * Shader variants constructor, compiles nothing yet
+     * @param vs: path to the vertex shader
+     * @param fs: path to the fragment shader
+     * @param supportedFeatures: the ShaderFeature bits the sources check for
+     * @param fallback: cheap shader with the same vertex inputs used while a variant compiles, nullptr to wait instead
+     */
+    ShaderVariants(const std::string& vs, const std::string& fs, uint32_t supportedFeatures, std::shared_ptr<Shader> fallback = nullptr);
+
+    /*!
+     * @return the variant with the given features, or the fallback shader while the variant is compiling
+     * @param features: combination of ShaderFeature bits
+     */
+    Shader* get(uint32_t features);
+
+    /*!
+     * @return the variant with the given features, waits until it is compiled
+     * @param features: combination of ShaderFeature bits
+     */
+    Shader* load(uint32_t features);
+
+    /*!
+     * Checks the variants that are still compiling, get() returns the finished ones from now on
+     */
+    void poll();
+
+    /*!
+     * @return the features a variant is compiled with
+     * @param features: combination of ShaderFeature bits
+     */
+    uint32_t getVariantFeatures(uint32_t features) const { return features & _supportedFeatures; }
+};
@@ -0,0 +1,215 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Part of the cascade's extent that is kept as a margin around the frustum slice,
+ * the cascade is only moved (and its cache invalidated) when the camera leaves this margin
+ */
+const float CASCADE_MARGIN = 0.25f;
+
+} // namespace
+
+ShadowMaps::ShadowMaps(unsigned int resolution, unsigned int cascadeCount, float fov, float aspect, float nearZ, float farZ, float shadowDistance, float splitLambda)
+    : _resolution(resolution)
+    , _cascadeCount(std::max(1u, std::min(cascadeCount, MAX_CASCADES)))
+    , _projMatrix(glm::perspective(glm::radians(fov), aspect, nearZ, farZ))
+    , _frame(0)
+    , _staticRenders(0)
+    , _dynamicRenders(0) {
+    _depthShader = std::make_shared<Shader>("assets/shaders/depth.vert", "assets/shaders/depth.frag");
+
+    // practical split scheme, blend of uniform and logarithmic splits
+    shadowDistance = std::min(shadowDistance, farZ);
+    float k = std::tan(glm::radians(fov) * 0.5f) * std::sqrt(1.0f + aspect * aspect);
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        Cascade& cascade = _cascades[i];
+        cascade.splitNear = i == 0 ? nearZ : _cascades[i - 1].splitFar;
+        float f = float(i + 1) / float(_cascadeCount);
+        float uniformSplit = nearZ + (shadowDistance - nearZ) * f;
+        float logSplit = nearZ * std::pow(shadowDistance / nearZ, f);
+        cascade.splitFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+
+        // smallest sphere around the slice, its center lies on the view axis
+        // k is the ratio between the half diagonal of a slice plane and its depth
+        float n = cascade.splitNear;
+        float d = cascade.splitFar;
+        cascade.centerDepth = std::min(0.5f * (n + d) * (1.0f + k * k), d);
+        float toFar = std::sqrt((d - cascade.centerDepth) * (d - cascade.centerDepth) + d * d * k * k);
+        float toNear = std::sqrt((cascade.centerDepth - n) * (cascade.centerDepth - n) + n * n * k * k);
+        cascade.radius = std::max(toFar, toNear);
+    }
+
+    auto createArray = [&](GLuint& texture) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, _resolution, _resolution, _cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    };
+    createArray(_staticTexture);
+    createArray(_shadowTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    auto createFramebuffer = [&](GLuint& fbo, GLuint texture, unsigned int layer) {
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Shadow map framebuffer " << layer << " is incomplete" << std::endl;
+        }
+    };
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        createFramebuffer(_cascades[i].staticFbo, _staticTexture, i);
+        createFramebuffer(_cascades[i].shadowFbo, _shadowTexture, i);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+ShadowMaps::~ShadowMaps() {
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        glDeleteFramebuffers(1, &_cascades[i].staticFbo);
+        glDeleteFramebuffers(1, &_cascades[i].shadowFbo);
+    }
+    glDeleteTextures(1, &_staticTexture);
+    glDeleteTextures(1, &_shadowTexture);
+}
+
+void ShadowMaps::setCasterBounds(const AABB& bounds) {
+    _casterBounds = bounds;
+    invalidateStatic();
+}
+
+void ShadowMaps::invalidateStatic() {
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        _cascades[i].staticValid = false;
+    }
+}
+
+glm::mat4 ShadowMaps::computeCascadeMatrix(const Cascade& cascade, const glm::mat4& invViewMatrix, const glm::vec3& lightDirection) const {
+    glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+    // the extent only depends on the slice, so the texel size never changes
+    float extent = cascade.radius * (1.0f + CASCADE_MARGIN);
+    float texelSize = 2.0f * extent / float(_resolution);
+    float step = texelSize * std::max(1.0f, std::floor(cascade.radius * CASCADE_MARGIN / texelSize));
+
+    // move the cascade in whole texels only, and only once the slice leaves the margin
+    glm::vec3 center = glm::vec3(lightView * (invViewMatrix * glm::vec4(0.0f, 0.0f, -cascade.centerDepth, 1.0f)));
+    center = glm::floor(center / step + glm::vec3(0.5f)) * step;
+
+    // light space looks down -z, casters between the light and the cascade must not be clipped
+    float zNear = center.z + extent;
+    float zFar = center.z - extent;
+    if (_casterBounds.isValid()) {
+        for (unsigned int i = 0; i < 8; i++) {
+            zNear = std::max(zNear, (lightView * glm::vec4(_casterBounds.getCorner(i), 1.0f)).z);
+        }
+    }
+
+    glm::mat4 lightProj = glm::ortho(center.x - extent, center.x + extent, center.y - extent, center.y + extent, -zNear, -zFar);
+    return lightProj * lightView;
+}
+
+void ShadowMaps::renderLayer(GLuint fbo, const glm::mat4& viewProjMatrix, const DrawCallback& draw, bool clear) {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (clear) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    _depthShader->use();
+    _depthShader->setUniform("viewProjMatrix", viewProjMatrix);
+    draw(*_depthShader);
+}
+
+void ShadowMaps::update(const glm::mat4& viewProjMatrix, const glm::vec3& lightDirection, const DrawCallback& drawStatic, const DrawCallback& drawDynamic) {
+    _frame++;
+    _staticRenders = 0;
+    _dynamicRenders = 0;
+
+    glm::mat4 invViewMatrix = glm::inverse(glm::inverse(_projMatrix) * viewProjMatrix);
+
+    // the nearest cascade is refreshed every frame, one of the others in turns
+    unsigned int roundRobin = _cascadeCount > 1 ? 1 + _frame % (_cascadeCount - 1) : 0;
+
+    GLint viewport[4];
+    GLint depthFunc = GL_LESS;
+    GLboolean depthMask = GL_TRUE;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+    glViewport(0, 0, _resolution, _resolution);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    // casters in front of the near plane are clamped instead of clipped
+    glEnable(GL_DEPTH_CLAMP);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        Cascade& cascade = _cascades[i];
+        glm::mat4 cascadeMatrix = computeCascadeMatrix(cascade, invViewMatrix, lightDirection);
+        bool moved = !cascade.rendered || cascadeMatrix != cascade.viewProjMatrix;
+        if (i != 0 && i != roundRobin && !moved && cascade.staticValid) {
+            continue;
+        }
+
+        if (moved || !cascade.staticValid) {
+            cascade.viewProjMatrix = cascadeMatrix;
+            renderLayer(cascade.staticFbo, cascadeMatrix, drawStatic, true);
+            cascade.staticValid = true;
+            _staticRenders++;
+        }
+
+        // start from the cached static casters and add the dynamic ones
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, cascade.staticFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.shadowFbo);
+        glBlitFramebuffer(0, 0, _resolution, _resolution, 0, 0, _resolution, _resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        renderLayer(cascade.shadowFbo, cascadeMatrix, drawDynamic, false);
+        cascade.rendered = true;
+        _dynamicRenders++;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glDepthFunc(depthFunc);
+    glDepthMask(depthMask);
+    if (!depthTest) {
+        glDisable(GL_DEPTH_TEST);
+    }
+}
+
+void ShadowMaps::setUniforms(Shader& shader, unsigned int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _shadowTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glm::vec4 splits(0.0f);
+    for (unsigned int i = 0; i < _cascadeCount; i++) {
+        shader.setUniform("shadowMatrices[" + std::to_string(i) + "]", _cascades[i].viewProjMatrix);
+        splits[i] = _cascades[i].splitFar;
+    }
+    shader.setUniform("shadowMap", int(textureUnit));
+    shader.setUniform("shadowCascadeCount", int(_cascadeCount));
+    shader.setUniform("shadowSplits", splits);
+}
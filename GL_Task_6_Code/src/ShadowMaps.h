@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Shader.h"
+#include <GL/glew.h>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+/*!
+ * Cascaded shadow maps for a directional light.
+ * Every cascade keeps two layers: a cached layer with the static shadow casters, which is only re-rendered when the
+ * cascade moves, and the sampled layer, which is a copy of the cached layer with the dynamic casters drawn on top.
+ * The nearest cascade is refreshed every frame, the farther cascades take turns (round-robin).
+ * Cascades are snapped to a grid of whole texels, so they neither shimmer nor invalidate the cache on small camera moves.
+ */
+class ShadowMaps {
+  public:
+    static const unsigned int MAX_CASCADES = 4;
+
+    /*!
+     * Draws shadow casters with the given depth shader, the shader is in use and its viewProjMatrix is set
+     */
+    using DrawCallback = std::function<void(Shader& depthShader)>;
+
+  protected:
+    /*!
+     * State of a single cascade
+     */
+    struct Cascade {
+        float splitNear = 0.0f, splitFar = 0.0f;
+        /*!
+         * Radius of the bounding sphere of the cascade's frustum slice, independent of the camera orientation
+         */
+        float radius = 0.0f;
+        /*!
+         * View depth of the bounding sphere's center
+         */
+        float centerDepth = 0.0f;
+        glm::mat4 viewProjMatrix = glm::mat4(1.0f);
+        bool staticValid = false;
+        bool rendered = false;
+        GLuint staticFbo = 0, shadowFbo = 0;
+    };
+
+    unsigned int _resolution;
+    unsigned int _cascadeCount;
+    glm::mat4 _projMatrix;
+
+    /*!
+     * Static casters lying outside the cascade's box towards the light still have to cast shadows into it
+     */
+    AABB _casterBounds;
+
+    Cascade _cascades[MAX_CASCADES];
+    unsigned int _frame;
+    unsigned int _staticRenders, _dynamicRenders;
+
+    GLuint _staticTexture, _shadowTexture;
+    std::shared_ptr<Shader> _depthShader;
+
+    /*!
+     * Computes the snapped light view-projection matrix of a cascade
+     */
+    glm::mat4 computeCascadeMatrix(const Cascade& cascade, const glm::mat4& invViewMatrix, const glm::vec3& lightDirection) const;
+
+    /*!
+     * Renders casters into one layer
+     */
+    void renderLayer(GLuint fbo, const glm::mat4& viewProjMatrix, const DrawCallback& draw, bool clear);
+
+  public:
+    /*!
+     * Shadow maps constructor, the cascade splits follow the camera's projection
+     * @param resolution: width and height of each cascade in texels
+     * @param cascadeCount: number of cascades, at most MAX_CASCADES
+     * @param fov: field of view of the camera, in degrees
+     * @param aspect: aspect ratio of the camera
+     * @param nearZ: near plane distance of the camera
+     * @param farZ: far plane distance of the camera
+     * @param shadowDistance: distance up to which shadows are drawn
+     * @param splitLambda: blend between uniform (0) and logarithmic (1) cascade splits
+     */
+    ShadowMaps(unsigned int resolution, unsigned int cascadeCount, float fov, float aspect, float nearZ, float farZ, float shadowDistance, float splitLambda = 0.75f);
+    ~ShadowMaps();
+
+    /*!
+     * Sets the world space bounds of all static shadow casters and invalidates the cached layers
+     * @param bounds: bounds of the static casters
+     */
+    void setCasterBounds(const AABB& bounds);
+
+    /*!
+     * Invalidates the cached layers, e.g. after a static caster was moved
+     */
+    void invalidateStatic();
+
+    /*!
+     * Updates the cascades that are due this frame
+     * Leaves the default framebuffer bound and restores the viewport.
+     * @param viewProjMatrix: view-projection matrix of the camera
+     * @param lightDirection: direction of the directional light
+     * @param drawStatic: draws the static casters, only called when a cached layer is re-rendered
+     * @param drawDynamic: draws the dynamic casters
+     */
+    void update(const glm::mat4& viewProjMatrix, const glm::vec3& lightDirection, const DrawCallback& drawStatic, const DrawCallback& drawDynamic);
+
+    /*!
+     * Binds the shadow map and sets the shadow uniforms of a shader
+     * @param shader: the shader, which has to be in use
+     * @param textureUnit: the texture unit to bind the shadow map to
+     */
+    void setUniforms(Shader& shader, unsigned int textureUnit);
+
+    /*!
+     * @return number of cached layers re-rendered in the last update
+     */
+    unsigned int getStaticRenderCount() const { return _staticRenders; }
+
+    /*!
+     * @return number of cascades the dynamic casters were drawn into in the last update
+     */
+    unsigned int getDynamicRenderCount() const { return _dynamicRenders; }
+};
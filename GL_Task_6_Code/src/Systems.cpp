@@ -0,0 +1,22 @@
+#include "Systems.h"
+#include "Components.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+void updatePlayerTransforms(EntityWorld& entities, SceneGraph& scene) {
+    entities.each<PlayerStateComponent, TransformComponent>([&](Entity, PlayerStateComponent& state, TransformComponent& transform) {
+        if (!state.dirty)
+            return;
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), state.position);
+        scene.setLocalMatrix(transform.node, glm::rotate(modelMatrix, glm::radians(state.rotationY), glm::vec3(0, 1, 0)));
+        state.dirty = false;
+    });
+}
+
+void updateWorldBounds(EntityWorld& entities, const SceneGraph& scene) {
+    entities.parallelEach<TransformComponent, BoundsComponent>([&](Entity, TransformComponent& transform, BoundsComponent& bounds) {
+        if (scene.hasChanged(transform.node) || !bounds.world.isValid()) {
+            bounds.world = bounds.local.transformed(scene.getWorldMatrix(transform.node));
+        }
+    });
+}
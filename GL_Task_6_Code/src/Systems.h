@@ -0,0 +1,20 @@
+#pragma once
+
+#include "EntityWorld.h"
+#include "SceneGraph.h"
+
+/*!
+ * Writes changed player positions and rotations into the local matrices of their scene graph nodes
+ * Has to run before SceneGraph::update().
+ * @param entities: the entity world
+ * @param scene: the scene graph
+ */
+void updatePlayerTransforms(EntityWorld& entities, SceneGraph& scene);
+
+/*!
+ * Recomputes the world bounding boxes of all entities whose world matrix changed
+ * Has to run after SceneGraph::update().
+ * @param entities: the entity world
+ * @param scene: the scene graph
+ */
+void updateWorldBounds(EntityWorld& entities, const SceneGraph& scene);
@@ -0,0 +1,176 @@
+#include "TextureAtlas.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+#undef min
+#undef max
+
+SkylinePacker::SkylinePacker(unsigned int width, unsigned int height)
+    : _width(width)
+    , _height(height) {
+    _skyline.push_back(Segment{0, 0, width});
+}
+
+bool SkylinePacker::fits(size_t segment, unsigned int width, unsigned int height, unsigned int& y) const {
+    unsigned int x = _skyline[segment].x;
+    if (x + width > _width)
+        return false;
+
+    y = 0;
+    unsigned int covered = 0;
+    for (size_t i = segment; covered < width; i++) {
+        y = std::max(y, _skyline[i].y);
+        if (y + height > _height)
+            return false;
+        covered += _skyline[i].width;
+    }
+    return true;
+}
+
+bool SkylinePacker::insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y) {
+    // the lowest top edge wins, the narrower segment breaks ties to leave wide gaps for wide rectangles
+    size_t best = _skyline.size();
+    unsigned int bestTop = UINT_MAX, bestWidth = UINT_MAX;
+    for (size_t i = 0; i < _skyline.size(); i++) {
+        unsigned int top;
+        if (!fits(i, width, height, top))
+            continue;
+        if (top + height < bestTop || (top + height == bestTop && _skyline[i].width < bestWidth)) {
+            best = i;
+            bestTop = top + height;
+            bestWidth = _skyline[i].width;
+        }
+    }
+    if (best == _skyline.size())
+        return false;
+
+    x = _skyline[best].x;
+    y = bestTop - height;
+
+    // the new segment replaces the parts of the skyline below it
+    Segment placed{x, bestTop, width};
+    size_t end = best;
+    while (end < _skyline.size() && _skyline[end].x + _skyline[end].width <= x + width) {
+        end++;
+    }
+    if (end < _skyline.size() && _skyline[end].x < x + width) {
+        unsigned int right = _skyline[end].x + _skyline[end].width;
+        _skyline[end].x = x + width;
+        _skyline[end].width = right - _skyline[end].x;
+    }
+    _skyline.erase(_skyline.begin() + best, _skyline.begin() + end);
+    _skyline.insert(_skyline.begin() + best, placed);
+
+    // neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < _skyline.size();) {
+        if (_skyline[i].y == _skyline[i + 1].y) {
+            _skyline[i].width += _skyline[i + 1].width;
+            _skyline.erase(_skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+TextureAtlas::TextureAtlas()
+    : _pageSize(0) {}
+
+unsigned int TextureAtlas::getSlotSize(unsigned int size) { return (size + 2 * GUTTER + GUTTER - 1) / GUTTER * GUTTER; }
+
+unsigned int TextureAtlas::getMaxLevel() {
+    unsigned int level = 0;
+    while ((2u << level) <= GUTTER) {
+        level++;
+    }
+    return level;
+}
+
+size_t TextureAtlas::add(std::vector<uint8_t> pixels, unsigned int width, unsigned int height) {
+    _images.push_back(Image{std::move(pixels), width, height});
+    return _images.size() - 1;
+}
+
+unsigned int TextureAtlas::pack(const std::vector<size_t>& order, unsigned int pageSize, unsigned int maxPages, std::vector<glm::uvec2>& positions, std::vector<unsigned int>& pages) const {
+    std::vector<SkylinePacker> packers;
+    for (size_t image : order) {
+        unsigned int width = getSlotSize(_images[image].width), height = getSlotSize(_images[image].height);
+        bool placed = false;
+        for (size_t page = 0; page < packers.size() && !placed; page++) {
+            if (packers[page].insert(width, height, positions[image].x, positions[image].y)) {
+                pages[image] = unsigned(page);
+                placed = true;
+            }
+        }
+        if (placed)
+            continue;
+        if (packers.size() == maxPages)
+            return 0;
+        packers.emplace_back(pageSize, pageSize);
+        packers.back().insert(width, height, positions[image].x, positions[image].y);
+        pages[image] = unsigned(packers.size() - 1);
+    }
+    return unsigned(packers.size());
+}
+
+void TextureAtlas::build(unsigned int maxPageSize) {
+    PROFILE_FUNCTION();
+    _tiles.assign(_images.size(), AtlasTile());
+    _pages.clear();
+    if (_images.empty())
+        return;
+
+    // tall images first keep the skyline flat
+    std::vector<size_t> order(_images.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (_images[a].height != _images[b].height)
+            return _images[a].height > _images[b].height;
+        return _images[a].width > _images[b].width;
+    });
+
+    // the page has to hold the largest slot, beyond that it grows until everything fits into one page
+    unsigned int largestSlot = 0;
+    for (const Image& image : _images) {
+        largestSlot = std::max(largestSlot, std::max(getSlotSize(image.width), getSlotSize(image.height)));
+    }
+    _pageSize = 1;
+    while (_pageSize < largestSlot) {
+        _pageSize *= 2;
+    }
+    std::vector<glm::uvec2> positions(_images.size());
+    std::vector<unsigned int> pages(_images.size());
+    unsigned int pageCount;
+    while ((pageCount = pack(order, _pageSize, 1, positions, pages)) == 0 && _pageSize < maxPageSize) {
+        _pageSize *= 2;
+    }
+    if (pageCount == 0) {
+        pageCount = pack(order, _pageSize, unsigned(_images.size()), positions, pages);
+    }
+
+    _pages.assign(pageCount, std::vector<uint8_t>(size_t(_pageSize) * _pageSize * 4, 0));
+    float pageSize = float(_pageSize);
+    for (size_t i = 0; i < _images.size(); i++) {
+        const Image& image = _images[i];
+        AtlasTile& tile = _tiles[i];
+        tile.page = pages[i];
+        tile.uvScale = glm::vec2(float(image.width), float(image.height)) / pageSize;
+        tile.uvOffset = glm::vec2(float(positions[i].x + GUTTER), float(positions[i].y + GUTTER)) / pageSize;
+
+        // the whole slot is filled, the texels of its aligned blocks are averaged into the coarser levels
+        std::vector<uint8_t>& page = _pages[tile.page];
+        unsigned int slotWidth = getSlotSize(image.width), slotHeight = getSlotSize(image.height);
+        for (unsigned int y = 0; y < slotHeight; y++) {
+            unsigned int sourceY = unsigned(std::min(std::max(int(y) - int(GUTTER), 0), int(image.height) - 1));
+            for (unsigned int x = 0; x < slotWidth; x++) {
+                unsigned int sourceX = unsigned(std::min(std::max(int(x) - int(GUTTER), 0), int(image.width) - 1));
+                const uint8_t* source = &image.pixels[(size_t(sourceY) * image.width + sourceX) * 4];
+                uint8_t* target = &page[(size_t(positions[i].y + y) * _pageSize + positions[i].x + x) * 4];
+                std::copy(source, source + 4, target);
+            }
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*!
+ * Packs rectangles into a fixed area with the skyline bottom-left heuristic
+ * The skyline is the top edge of everything placed so far, a rectangle goes where its top ends lowest.
+ */
+class SkylinePacker {
+  protected:
+    struct Segment {
+        unsigned int x, y, width;
+    };
+
+    unsigned int _width, _height;
+    /*!
+     * Segments from left to right, covering the whole width
+     */
+    std::vector<Segment> _skyline;
+
+    /*!
+     * @return whether a rectangle with its left edge at the segment fits
+     * @param segment: index of the segment
+     * @param y: height the rectangle would be placed at, the highest segment below it
+     */
+    bool fits(size_t segment, unsigned int width, unsigned int height, unsigned int& y) const;
+
+  public:
+    SkylinePacker(unsigned int width, unsigned int height);
+
+    /*!
+     * Places a rectangle
+     * @param width: width of the rectangle
+     * @param height: height of the rectangle
+     * @param x: left edge of the placed rectangle
+     * @param y: top edge of the placed rectangle
+     * @return whether the rectangle fits
+     */
+    bool insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y);
+};
+
+/*!
+ * Where an image ended up in a TextureAtlas
+ */
+struct AtlasTile {
+    unsigned int page = 0;
+    /*!
+     * Texture coordinates of the image map to uv * uvScale + uvOffset in the page
+     */
+    glm::vec2 uvScale = glm::vec2(1.0f);
+    glm::vec2 uvOffset = glm::vec2(0.0f);
+};
+
+/*!
+ * Merges small RGBA8 images into square pages of the same size
+ * Every image gets a gutter of its replicated edge texels and a slot aligned to the gutter size, so neither bilinear
+ * filtering nor the mip levels up to getMaxLevel() mix neighbouring images. Texture coordinates outside of [0, 1]
+ * would sample the gutter instead of repeating the image, images that are drawn like that must not be added.
+ */
+class TextureAtlas {
+  public:
+    /*!
+     * Texels of replicated edge around every image
+     */
+    static const unsigned int GUTTER = 4;
+
+  protected:
+    struct Image {
+        std::vector<uint8_t> pixels;
+        unsigned int width, height;
+    };
+
+    std::vector<Image> _images;
+    std::vector<AtlasTile> _tiles;
+    std::vector<std::vector<uint8_t>> _pages;
+    unsigned int _pageSize;
+
+    /*!
+     * @return the size of an image's slot in one dimension, including the gutters
+     */
+    static unsigned int getSlotSize(unsigned int size);
+
+    /*!
+     * Packs the images in the given order into pages of the given size
+     * @param positions: slot corner of every image, x and y
+     * @param pages: page of every image
+     * @param maxPages: gives up once more pages would be needed
+     * @return the number of pages, 0 if more than maxPages would be needed
+     */
+    unsigned int pack(const std::vector<size_t>& order, unsigned int pageSize, unsigned int maxPages, std::vector<glm::uvec2>& positions, std::vector<unsigned int>& pages) const;
+
+  public:
+    TextureAtlas();
+
+    /*!
+     * Adds an image, it is placed by build()
+     * @param pixels: RGBA8 data of the image, rows from top to bottom
+     * @param width: width of the image
+     * @param height: height of the image
+     * @return index of the image for getTile()
+     */
+    size_t add(std::vector<uint8_t> pixels, unsigned int width, unsigned int height);
+
+    /*!
+     * Places the images and fills the pages
+     * The page size is doubled until all images fit into one page or maxPageSize is reached, more pages are added
+     * after that.
+     * @param maxPageSize: largest page size, a power of two
+     */
+    void build(unsigned int maxPageSize);
+
+    /*!
+     * @return the width and height of every page, 0 before build()
+     */
+    unsigned int getPageSize() const { return _pageSize; }
+
+    /*!
+     * @return the RGBA8 data of every page
+     */
+    const std::vector<std::vector<uint8_t>>& getPages() const { return _pages; }
+
+    /*!
+     * @return where an image was placed
+     * @param image: index returned by add()
+     */
+    const AtlasTile& getTile(size_t image) const { return _tiles[image]; }
+
+    /*!
+     * @return the finest mip level whose texels still contain a single image
+     */
+    static unsigned int getMaxLevel();
+};
@@ -0,0 +1,457 @@
+#include "TextureStreamer.h"
+#include "CpuProfiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#undef min
+#undef max
+
+namespace {
+
+/*!
+ * Halves an RGBA8 image with a box filter, an odd last row or column is averaged with itself
+ */
+std::vector<uint8_t> downsample(const std::vector<uint8_t>& source, unsigned int width, unsigned int height) {
+    unsigned int targetWidth = std::max(1u, width / 2), targetHeight = std::max(1u, height / 2);
+    std::vector<uint8_t> target(size_t(targetWidth) * targetHeight * 4);
+    for (unsigned int y = 0; y < targetHeight; y++) {
+        unsigned int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (unsigned int x = 0; x < targetWidth; x++) {
+            unsigned int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (unsigned int c = 0; c < 4; c++) {
+                unsigned int sum = source[(size_t(y0) * width + x0) * 4 + c] + source[(size_t(y0) * width + x1) * 4 + c] +
+                                   source[(size_t(y1) * width + x0) * 4 + c] + source[(size_t(y1) * width + x1) * 4 + c];
+                target[(size_t(y) * targetWidth + x) * 4 + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+    return target;
+}
+
+/*!
+ * Decodes an image and computes its mip levels
+ * @param firstLevel: first level that is returned, the finer ones are only computed to get there
+ * @param endLevel: level after the last one that is returned
+ * @return the RGBA8 data of the levels, empty if the file could not be read
+ */
+std::vector<std::vector<uint8_t>> decodeLevels(const std::string& path, unsigned int firstLevel, unsigned int endLevel) {
+    std::vector<std::vector<uint8_t>> levels;
+    int width = 0, height = 0, channels = 0;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        std::cerr << "Could not load texture " << path << ": " << stbi_failure_reason() << std::endl;
+        return levels;
+    }
+
+    std::vector<uint8_t> level(data, data + size_t(width) * height * 4);
+    stbi_image_free(data);
+    unsigned int levelWidth = unsigned(width), levelHeight = unsigned(height);
+    for (unsigned int i = 0; i < endLevel; i++) {
+        if (i >= firstLevel) {
+            levels.push_back(level);
+        }
+        if (i + 1 < endLevel) {
+            level = downsample(level, levelWidth, levelHeight);
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+    }
+    return levels;
+}
+
+/*!
+ * Decodes the levels of every layer of a texture
+ * @return the RGBA8 data of the levels with the layers one after another as glTexImage3D() expects them, empty if a
+ * file could not be read or is not of the texture's size
+ */
+std::vector<std::vector<uint8_t>> decodeLayers(const StreamedTexture& texture, unsigned int firstLevel, unsigned int endLevel) {
+    size_t firstLevelBytes = size_t(std::max(1u, texture.width >> firstLevel)) * std::max(1u, texture.height >> firstLevel) * 4;
+    std::vector<std::vector<uint8_t>> levels;
+    for (const std::string& path : texture.paths) {
+        std::vector<std::vector<uint8_t>> layer = decodeLevels(path, firstLevel, endLevel);
+        if (layer.size() != endLevel - firstLevel || layer[0].size() != firstLevelBytes) {
+            if (!layer.empty()) {
+                std::cerr << "Texture " << path << " does not have the size of the other layers" << std::endl;
+            }
+            return {};
+        }
+        if (levels.empty()) {
+            levels = std::move(layer);
+            continue;
+        }
+        for (size_t i = 0; i < layer.size(); i++) {
+            levels[i].insert(levels[i].end(), layer[i].begin(), layer[i].end());
+        }
+    }
+    return levels;
+}
+
+void uploadLevel(const StreamedTexture& texture, unsigned int level, const void* data) {
+    GLsizei width = data ? GLsizei(std::max(1u, texture.width >> level)) : 0;
+    GLsizei height = data ? GLsizei(std::max(1u, texture.height >> level)) : 0;
+    if (texture.target == GL_TEXTURE_2D_ARRAY) {
+        GLsizei layers = data ? GLsizei(texture.paths.size()) : 0;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(level), GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer()
+    : _budgetBytes(0)
+    , _uploadBytesPerFrame(0)
+    , _floorSize(64)
+    , _residentBytes(0)
+    , _deniedBytes(0)
+    , _frameNumber(0)
+    , _streamedLevels(0)
+    , _evictedLevels(0)
+    , _lastLogTime(0.0)
+    , _stop(false) {}
+
+TextureStreamer::~TextureStreamer() { stopThread(); }
+
+void TextureStreamer::setBudget(size_t budgetBytes, size_t uploadBytesPerFrame, unsigned int floorSize) {
+    _budgetBytes = budgetBytes;
+    _uploadBytesPerFrame = uploadBytesPerFrame;
+    _floorSize = std::max(1u, floorSize);
+}
+
+size_t TextureStreamer::getLevelBytes(const StreamedTexture& texture, unsigned int level) {
+    return size_t(std::max(1u, texture.width >> level)) * std::max(1u, texture.height >> level) * 4 * texture.paths.size();
+}
+
+size_t TextureStreamer::getBytes(const StreamedTexture& texture, unsigned int firstLevel, unsigned int endLevel) {
+    size_t bytes = 0;
+    for (unsigned int level = firstLevel; level < endLevel; level++) {
+        bytes += getLevelBytes(texture, level);
+    }
+    return bytes;
+}
+
+StreamedTexture* TextureStreamer::load(const std::string& path) { return load(GL_TEXTURE_2D, {path}); }
+
+StreamedTexture* TextureStreamer::loadArray(const std::vector<std::string>& paths) { return load(GL_TEXTURE_2D_ARRAY, paths); }
+
+StreamedTexture* TextureStreamer::load(GLenum target, const std::vector<std::string>& paths) {
+    if (paths.empty())
+        return nullptr;
+    // an array never shares the key of a single texture, paths do not start with a line break
+    std::string key = target == GL_TEXTURE_2D ? paths[0] : "";
+    if (target != GL_TEXTURE_2D) {
+        for (const std::string& path : paths) {
+            key += '\n' + path;
+        }
+    }
+    auto existing = _textures.find(key);
+    if (existing != _textures.end())
+        return existing->second.get();
+
+    PROFILE_FUNCTION();
+    // the layers are checked against the first one's size when they are decoded
+    int width = 0, height = 0, channels = 0;
+    if (!stbi_info(paths[0].c_str(), &width, &height, &channels) || width <= 0 || height <= 0) {
+        std::cerr << "Could not load texture " << paths[0] << ": " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<StreamedTexture> texture(new StreamedTexture());
+    texture->paths = paths;
+    texture->target = target;
+    texture->width = unsigned(width);
+    texture->height = unsigned(height);
+    texture->mipCount = 1;
+    while ((std::max(texture->width, texture->height) >> texture->mipCount) > 0) {
+        texture->mipCount++;
+    }
+    texture->floorMip = 0;
+    while (texture->floorMip + 1 < texture->mipCount && std::max(texture->width, texture->height) >> texture->floorMip > _floorSize) {
+        texture->floorMip++;
+    }
+
+    std::vector<std::vector<uint8_t>> levels = decodeLayers(*texture, texture->floorMip, texture->mipCount);
+    if (levels.empty())
+        return nullptr;
+
+    glGenTextures(1, &texture->handle);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(target, texture->handle);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, GLint(texture->floorMip));
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, GLint(texture->mipCount - 1));
+    for (unsigned int level = texture->floorMip; level < texture->mipCount; level++) {
+        uploadLevel(*texture, level, levels[level - texture->floorMip].data());
+    }
+    glBindTexture(target, 0);
+
+    texture->residentMip = texture->floorMip;
+    texture->wantedMip = texture->floorMip;
+    texture->requestedMip = texture->floorMip;
+    _residentBytes += getBytes(*texture, texture->floorMip, texture->mipCount);
+
+    StreamedTexture* result = texture.get();
+    _textures.emplace(key, std::move(texture));
+    return result;
+}
+
+void TextureStreamer::request(StreamedTexture& texture, float uvPerPixel) {
+    // one texel per pixel is the finest level that still adds detail
+    float texelsPerPixel = uvPerPixel * float(std::max(texture.width, texture.height));
+    unsigned int mip = texelsPerPixel > 1.0f ? unsigned(std::log2(texelsPerPixel)) : 0u;
+    texture.requestedMip = std::min(texture.requestedMip, std::min(mip, texture.floorMip));
+    texture.lastUsedFrame = _frameNumber;
+}
+
+void TextureStreamer::evict(StreamedTexture& texture, unsigned int residentMip) {
+    if (residentMip <= texture.residentMip)
+        return;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(texture.target, texture.handle);
+    // the levels below the base level do not count for completeness, defining them empty releases their memory
+    glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, GLint(residentMip));
+    for (unsigned int level = texture.residentMip; level < residentMip; level++) {
+        uploadLevel(texture, level, nullptr);
+    }
+    glBindTexture(texture.target, 0);
+
+    _residentBytes -= getBytes(texture, texture.residentMip, residentMip);
+    _evictedLevels += residentMip - texture.residentMip;
+    texture.residentMip = residentMip;
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, const StreamedTexture* keep) {
+    if (_residentBytes + bytes <= _budgetBytes)
+        return true;
+
+    // levels finer than what a texture was drawn with last frame, textures that were not drawn keep only the floor
+    std::vector<StreamedTexture*> candidates;
+    size_t evictable = 0;
+    for (auto& entry : _textures) {
+        StreamedTexture* texture = entry.second.get();
+        if (texture == keep || texture->streaming || texture->residentMip >= texture->wantedMip)
+            continue;
+        candidates.push_back(texture);
+        evictable += getBytes(*texture, texture->residentMip, texture->wantedMip);
+    }
+    // nothing is evicted for a stream-in that would not fit anyway
+    if (_residentBytes + bytes > _budgetBytes + evictable)
+        return false;
+
+    std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+    for (StreamedTexture* texture : candidates) {
+        unsigned int residentMip = texture->residentMip;
+        while (residentMip < texture->wantedMip && _residentBytes + bytes - getBytes(*texture, texture->residentMip, residentMip) > _budgetBytes) {
+            residentMip++;
+        }
+        evict(*texture, residentMip);
+        if (_residentBytes + bytes <= _budgetBytes)
+            return true;
+    }
+    return _residentBytes + bytes <= _budgetBytes;
+}
+
+void TextureStreamer::upload(StreamIn& streamIn) {
+    StreamedTexture& texture = *streamIn.texture;
+    texture.streaming = false;
+    unsigned int levelCount = texture.residentMip - streamIn.firstMip;
+    if (streamIn.levels.size() != levelCount) {
+        // decoding failed, give back the reserved memory
+        _residentBytes -= getBytes(texture, streamIn.firstMip, texture.residentMip);
+        return;
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(texture.target, texture.handle);
+    for (unsigned int i = 0; i < levelCount; i++) {
+        uploadLevel(texture, streamIn.firstMip + i, streamIn.levels[i].data());
+    }
+    glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, GLint(streamIn.firstMip));
+    glBindTexture(texture.target, 0);
+
+    _streamedLevels += levelCount;
+    texture.residentMip = streamIn.firstMip;
+}
+
+void TextureStreamer::update() {
+    if (!isEnabled())
+        return;
+    PROFILE_FUNCTION();
+
+    // the requests of the frame drawn last
+    for (auto& entry : _textures) {
+        StreamedTexture& texture = *entry.second;
+        texture.wantedMip = texture.lastUsedFrame == _frameNumber ? texture.requestedMip : texture.floorMip;
+        texture.requestedMip = texture.floorMip;
+    }
+    _frameNumber++;
+
+    // upload the levels decoded meanwhile, the rest waits for the next frame
+    {
+        std::vector<StreamIn> completed;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            completed.swap(_completed);
+        }
+        size_t uploadedBytes = 0;
+        std::vector<StreamIn> deferred;
+        for (StreamIn& streamIn : completed) {
+            size_t bytes = getBytes(*streamIn.texture, streamIn.firstMip, streamIn.texture->residentMip);
+            if (uploadedBytes > 0 && uploadedBytes + bytes > _uploadBytesPerFrame) {
+                deferred.push_back(std::move(streamIn));
+                continue;
+            }
+            upload(streamIn);
+            uploadedBytes += bytes;
+        }
+        if (!deferred.empty()) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _completed.insert(_completed.begin(), std::make_move_iterator(deferred.begin()), std::make_move_iterator(deferred.end()));
+        }
+    }
+
+    // the most recently drawn textures, and of those the blurriest, get the memory first
+    std::vector<StreamedTexture*> missing;
+    for (auto& entry : _textures) {
+        StreamedTexture* texture = entry.second.get();
+        if (!texture->streaming && texture->wantedMip < texture->residentMip) {
+            missing.push_back(texture);
+        }
+    }
+    std::sort(missing.begin(), missing.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+        if (a->lastUsedFrame != b->lastUsedFrame)
+            return a->lastUsedFrame > b->lastUsedFrame;
+        return a->residentMip - a->wantedMip > b->residentMip - b->wantedMip;
+    });
+
+    _deniedBytes = 0;
+    for (StreamedTexture* texture : missing) {
+        // a texture that does not fit completely streams in as many levels as fit
+        unsigned int firstMip = texture->wantedMip;
+        while (firstMip < texture->residentMip && !makeRoom(getBytes(*texture, firstMip, texture->residentMip), texture)) {
+            firstMip++;
+        }
+        _deniedBytes += getBytes(*texture, texture->wantedMip, firstMip);
+        if (firstMip == texture->residentMip)
+            continue;
+
+        // the memory is reserved now, the levels become resident once they are uploaded
+        _residentBytes += getBytes(*texture, firstMip, texture->residentMip);
+        texture->streaming = true;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _decodes.push_back(Decode{texture, firstMip, texture->residentMip});
+        }
+        if (!_thread.joinable()) {
+            _stop = false;
+            _thread = std::thread(&TextureStreamer::streamingLoop, this);
+        }
+        _wake.notify_one();
+    }
+}
+
+void TextureStreamer::streamingLoop() {
+    CpuProfiler::setThreadName("Texture streaming");
+    while (true) {
+        Decode decode;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&]() { return _stop || !_decodes.empty(); });
+            if (_stop)
+                break;
+            decode = _decodes.front();
+            _decodes.pop_front();
+        }
+
+        StreamIn streamIn;
+        streamIn.texture = decode.texture;
+        streamIn.firstMip = decode.firstMip;
+        {
+            PROFILE_ZONE("Stream texture");
+            streamIn.levels = decodeLayers(*decode.texture, decode.firstMip, decode.endMip);
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _completed.push_back(std::move(streamIn));
+    }
+}
+
+void TextureStreamer::stopThread() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _decodes.clear();
+    }
+    _wake.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void TextureStreamer::clear() {
+    stopThread();
+    _completed.clear();
+    for (auto& entry : _textures) {
+        glDeleteTextures(1, &entry.second->handle);
+    }
+    _textures.clear();
+    _residentBytes = 0;
+}
+
+TextureStreamerStatistics TextureStreamer::getStatistics() const {
+    TextureStreamerStatistics statistics;
+    statistics.budgetBytes = _budgetBytes;
+    statistics.residentBytes = _residentBytes;
+    statistics.deniedBytes = _deniedBytes;
+    statistics.streamedLevels = _streamedLevels;
+    statistics.evictedLevels = _evictedLevels;
+    for (const auto& entry : _textures) {
+        const StreamedTexture& texture = *entry.second;
+        StreamedTextureStatistics textureStatistics;
+        textureStatistics.path = texture.paths[0];
+        textureStatistics.layerCount = unsigned(texture.paths.size());
+        textureStatistics.residentMip = texture.residentMip;
+        textureStatistics.wantedMip = texture.wantedMip;
+        textureStatistics.mipCount = texture.mipCount;
+        textureStatistics.residentBytes = getBytes(texture, texture.residentMip, texture.mipCount);
+        statistics.textures.push_back(textureStatistics);
+        if (texture.streaming) {
+            statistics.streamingCount++;
+        }
+    }
+    return statistics;
+}
+
+void TextureStreamer::logStatistics(double time) {
+    if (!isEnabled() || time - _lastLogTime < 1.0)
+        return;
+    _lastLogTime = time;
+
+    TextureStreamerStatistics statistics = getStatistics();
+    double megabyte = 1.0 / (1024.0 * 1024.0);
+    std::cout << "Texture streaming: " << statistics.residentBytes * megabyte << " / " << statistics.budgetBytes * megabyte << " MB, "
+              << statistics.deniedBytes * megabyte << " MB over budget, " << statistics.streamingCount << " streaming, " << statistics.streamedLevels
+              << " levels streamed, " << statistics.evictedLevels << " evicted";
+    // resident / wanted level of every texture
+    for (const StreamedTextureStatistics& texture : statistics.textures) {
+        size_t slash = texture.path.find_last_of("/\\");
+        std::cout << " | " << (slash == std::string::npos ? texture.path : texture.path.substr(slash + 1));
+        if (texture.layerCount > 1) {
+            std::cout << " (+" << texture.layerCount - 1 << " layers)";
+        }
+        std::cout << " " << texture.residentMip << "/" << texture.wantedMip;
+    }
+    std::cout << std::endl;
+}
+
+TextureStreamer& getTextureStreamer() {
+    static TextureStreamer textureStreamer;
+    return textureStreamer;
+}
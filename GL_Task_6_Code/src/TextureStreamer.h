@@ -0,0 +1,216 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * A texture whose finest mip levels are loaded on demand, owned by the TextureStreamer
+ * The GL handle never changes, streaming only (re)defines levels and moves GL_TEXTURE_BASE_LEVEL.
+ */
+struct StreamedTexture {
+    /*!
+     * Image file of every layer, a GL_TEXTURE_2D has a single one
+     */
+    std::vector<std::string> paths;
+    /*!
+     * GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY, the layers of an array share their resident levels
+     */
+    GLenum target = GL_TEXTURE_2D;
+    GLuint handle = 0;
+    unsigned int width = 0, height = 0;
+    unsigned int mipCount = 0;
+    /*!
+     * The finest level that is resident, levels from here to mipCount - 1 are loaded
+     */
+    unsigned int residentMip = 0;
+    /*!
+     * The finest of the small levels that are loaded with the texture and never evicted
+     */
+    unsigned int floorMip = 0;
+    /*!
+     * The finest level any draw of the last frame asked for
+     */
+    unsigned int wantedMip = 0;
+    /*!
+     * Accumulates the requests of the current frame
+     */
+    unsigned int requestedMip = 0;
+    unsigned long long lastUsedFrame = 0;
+    /*!
+     * Whether finer levels are being decoded, the texture's levels are not evicted meanwhile
+     */
+    bool streaming = false;
+};
+
+/*!
+ * Residency of one texture, for the statistics
+ */
+struct StreamedTextureStatistics {
+    std::string path;
+    unsigned int layerCount;
+    unsigned int residentMip, wantedMip, mipCount;
+    size_t residentBytes;
+};
+
+/*!
+ * Memory statistics of the texture streamer
+ */
+struct TextureStreamerStatistics {
+    size_t budgetBytes = 0;
+    size_t residentBytes = 0;
+    /*!
+     * Bytes of levels that are wanted but could not be streamed in because of the budget
+     */
+    size_t deniedBytes = 0;
+    unsigned int streamingCount = 0;
+    unsigned long long streamedLevels = 0, evictedLevels = 0;
+    std::vector<StreamedTextureStatistics> textures;
+};
+
+/*!
+ * Streams the mip levels of textures within a fixed memory budget
+ * Textures start with only their small levels resident. Draws report how many UV units one pixel covers, from which
+ * the finest useful level follows. Once per frame update() queues the missing levels for decoding, uploads the decoded
+ * levels of earlier frames and, if the budget is exceeded, evicts the finest levels of the least recently drawn textures.
+ * Decoding takes milliseconds per texture and runs on a streaming thread of its own, on the job system a thread waiting
+ * for the frame's jobs would pick it up. Levels a texture is currently drawn with are never evicted for another texture, a texture
+ * that does not fit is left at a coarser level and counted as budget pressure.
+ * All methods except the constructor have to be called on the thread that owns the GL context.
+ */
+class TextureStreamer {
+  protected:
+    struct Decode {
+        StreamedTexture* texture;
+        unsigned int firstMip, endMip;
+    };
+
+    struct StreamIn {
+        StreamedTexture* texture;
+        unsigned int firstMip;
+        /*!
+         * RGBA8 data of the levels firstMip to texture->residentMip - 1
+         */
+        std::vector<std::vector<uint8_t>> levels;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<StreamedTexture>> _textures;
+    size_t _budgetBytes;
+    size_t _uploadBytesPerFrame;
+    unsigned int _floorSize;
+    /*!
+     * Memory of the resident levels and of the levels that are being streamed in
+     */
+    size_t _residentBytes;
+    size_t _deniedBytes;
+    unsigned long long _frameNumber;
+    unsigned long long _streamedLevels, _evictedLevels;
+    double _lastLogTime;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<Decode> _decodes;
+    std::vector<StreamIn> _completed;
+    bool _stop;
+
+    static size_t getLevelBytes(const StreamedTexture& texture, unsigned int level);
+    static size_t getBytes(const StreamedTexture& texture, unsigned int firstLevel, unsigned int endLevel);
+
+    /*!
+     * Frees the finest resident levels of a texture
+     * @param texture: the texture, must not be streaming
+     * @param residentMip: the new finest resident level, at most the floor level
+     */
+    void evict(StreamedTexture& texture, unsigned int residentMip);
+
+    /*!
+     * Evicts levels of least recently drawn textures until the given number of bytes fits into the budget
+     * @param bytes: bytes that are about to be allocated
+     * @param keep: texture that is not evicted from
+     * @return whether the bytes fit now
+     */
+    bool makeRoom(size_t bytes, const StreamedTexture* keep);
+
+    void upload(StreamIn& streamIn);
+
+    StreamedTexture* load(GLenum target, const std::vector<std::string>& paths);
+
+    void streamingLoop();
+
+    /*!
+     * Lets the streaming thread finish the decode it is working on and stops it, queued decodes are dropped
+     */
+    void stopThread();
+
+  public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /*!
+     * @param budgetBytes: memory all streamed textures may use together, the small levels are always loaded, 0 disables
+     * streaming
+     * @param uploadBytesPerFrame: decoded levels uploaded per frame, at least one texture is uploaded per frame
+     * @param floorSize: levels up to this width and height are loaded with the texture and never evicted
+     */
+    void setBudget(size_t budgetBytes, size_t uploadBytesPerFrame, unsigned int floorSize);
+
+    /*!
+     * @return whether textures are streamed, otherwise callers load them completely
+     */
+    bool isEnabled() const { return _budgetBytes > 0; }
+
+    /*!
+     * Loads the small levels of a texture, a texture that is loaded already is shared
+     * @param path: path to the image file
+     * @return the texture, nullptr if the file could not be read
+     */
+    StreamedTexture* load(const std::string& path);
+
+    /*!
+     * Loads the small levels of a texture array, an array with the same layers that is loaded already is shared
+     * @param paths: path to the image file of every layer, all images have to be of the same size
+     * @return the GL_TEXTURE_2D_ARRAY, nullptr if a file could not be read
+     */
+    StreamedTexture* loadArray(const std::vector<std::string>& paths);
+
+    /*!
+     * Reports a draw with the texture
+     * @param texture: the texture
+     * @param uvPerPixel: texture coordinate units covered by one pixel on screen, the smallest over the draw
+     */
+    void request(StreamedTexture& texture, float uvPerPixel);
+
+    /*!
+     * Starts streaming in the levels the last frame asked for and uploads finished ones, call once per frame
+     */
+    void update();
+
+    /*!
+     * Stops the streaming thread and deletes all textures, has to be called before the GL context is destroyed
+     */
+    void clear();
+
+    TextureStreamerStatistics getStatistics() const;
+
+    /*!
+     * Prints the memory statistics at most once per second
+     * @param time: current time in seconds
+     */
+    void logStatistics(double time);
+};
+
+/*!
+ * @return the streamer used by the model textures
+ */
+TextureStreamer& getTextureStreamer();
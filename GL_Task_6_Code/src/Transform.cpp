@@ -0,0 +1,32 @@
+#include "Transform.h"
+
+#include <atomic>
+#include <cmath>
+
+#undef min
+#undef max
+
+namespace {
+
+std::atomic<unsigned long long> inversionCount(0);
+
+} // namespace
+
+glm::mat3 computeNormalMatrix(const glm::mat4& modelMatrix) {
+    glm::mat3 m(modelMatrix);
+    float xx = glm::dot(m[0], m[0]);
+    float yy = glm::dot(m[1], m[1]);
+    float zz = glm::dot(m[2], m[2]);
+    float epsilon = 1e-4f * xx;
+    bool uniformScale = std::abs(xx - yy) <= epsilon && std::abs(xx - zz) <= epsilon;
+    bool orthogonal = std::abs(glm::dot(m[0], m[1])) <= epsilon && std::abs(glm::dot(m[0], m[2])) <= epsilon && std::abs(glm::dot(m[1], m[2])) <= epsilon;
+
+    if (uniformScale && orthogonal && xx > 0.0f) {
+        // m = s * R, so transpose(inverse(m)) = R / s = m / s^2
+        return m * (1.0f / xx);
+    }
+    inversionCount.fetch_add(1, std::memory_order_relaxed);
+    return glm::transpose(glm::inverse(m));
+}
+
+unsigned long long getNormalMatrixInversionCount() { return inversionCount; }
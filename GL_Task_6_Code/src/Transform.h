@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/*!
+ * Matrices of a transform, laid out for std140 so a whole block (or an array of blocks) can be uploaded at once
+ * The normal matrix is stored as a mat4, a std140 mat3 would be padded to three vec4 columns anyway.
+ */
+struct TransformData {
+    /*!
+     * Model matrix of the current frame
+     */
+    glm::mat4 model = glm::mat4(1.0f);
+    /*!
+     * Normal matrix of the current frame, the upper 3x3 part is used
+     */
+    glm::mat4 normal = glm::mat4(1.0f);
+    /*!
+     * Model matrix of the previous frame
+     */
+    glm::mat4 previousModel = glm::mat4(1.0f);
+};
+
+static_assert(sizeof(TransformData) == 3 * sizeof(glm::mat4), "TransformData must be tightly packed");
+
+/*!
+ * Computes the normal matrix of a model matrix
+ * Transforms without shear and with a uniform scale skip the inversion.
+ * @param modelMatrix: the model matrix
+ * @return transpose(inverse(mat3(modelMatrix)))
+ */
+glm::mat3 computeNormalMatrix(const glm::mat4& modelMatrix);
+
+/*!
+ * @return the number of normal matrices computed with a full inversion since the start of the program
+ */
+unsigned long long getNormalMatrixInversionCount();
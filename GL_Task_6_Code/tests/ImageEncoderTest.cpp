@@ -0,0 +1,441 @@
+// CPU-only test of the image encoders, decodes the PNG and QOI files again and compares the pixels
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        failures++;
+    }
+}
+
+void check(bool condition, const std::string& description) { check(condition, description.c_str()); }
+
+/* --------------------------------------------- */
+// Reference checksums, bitwise so they do not share tables with the encoder
+/* --------------------------------------------- */
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < size; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t readBigEndian(const uint8_t* data) { return uint32_t(data[0]) << 24 | uint32_t(data[1]) << 16 | uint32_t(data[2]) << 8 | data[3]; }
+
+/* --------------------------------------------- */
+// Inflate, only the block types the encoder writes: stored and fixed Huffman
+/* --------------------------------------------- */
+
+class BitReader {
+  protected:
+    const std::vector<uint8_t>& _data;
+    size_t _position;
+    unsigned int _bit;
+
+  public:
+    explicit BitReader(const std::vector<uint8_t>& data, size_t position)
+        : _data(data)
+        , _position(position)
+        , _bit(0) {}
+
+    bool atEnd() const { return _position >= _data.size(); }
+
+    /*!
+     * Reads bits least significant bit first, returns 0 past the end
+     */
+    uint32_t read(unsigned int count) {
+        uint32_t value = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            if (atEnd())
+                return value;
+            value |= uint32_t((_data[_position] >> _bit) & 1) << i;
+            if (++_bit == 8) {
+                _bit = 0;
+                _position++;
+            }
+        }
+        return value;
+    }
+
+    /*!
+     * Reads a Huffman code, most significant bit first
+     */
+    uint32_t readCode(unsigned int count) {
+        uint32_t code = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            code = (code << 1) | read(1);
+        }
+        return code;
+    }
+
+    void alignToByte() {
+        if (_bit > 0) {
+            _bit = 0;
+            _position++;
+        }
+    }
+
+    size_t getPosition() const { return _position; }
+};
+
+const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+unsigned int readFixedLiteralOrLength(BitReader& bits) {
+    uint32_t code = bits.readCode(7);
+    if (code < 0x18)
+        return 256 + code;
+    code = (code << 1) | bits.read(1);
+    if (code >= 0x30 && code < 0xC0)
+        return code - 0x30;
+    if (code >= 0xC0 && code < 0xC8)
+        return 280 + code - 0xC0;
+    code = (code << 1) | bits.read(1);
+    return 144 + code - 0x190;
+}
+
+/*!
+ * Inflates a zlib stream and checks its header and checksum
+ * @param emptyStoredBlocks: receives the number of empty stored blocks, the encoder ends every stripe with one
+ * @return whether the stream is valid
+ */
+bool inflateZlib(const std::vector<uint8_t>& zlib, std::vector<uint8_t>& out, unsigned int& emptyStoredBlocks) {
+    out.clear();
+    emptyStoredBlocks = 0;
+    if (zlib.size() < 6 || (zlib[0] & 0x0F) != 8 || (zlib[0] * 256 + zlib[1]) % 31 != 0)
+        return false;
+
+    BitReader bits(zlib, 2);
+    bool final = false;
+    while (!final) {
+        if (bits.atEnd())
+            return false;
+        final = bits.read(1) != 0;
+        uint32_t type = bits.read(2);
+        if (type == 0) {
+            bits.alignToByte();
+            uint32_t length = bits.read(16), complement = bits.read(16);
+            if ((length ^ 0xFFFF) != complement)
+                return false;
+            for (uint32_t i = 0; i < length; i++) {
+                out.push_back(uint8_t(bits.read(8)));
+            }
+            if (length == 0)
+                emptyStoredBlocks++;
+        } else if (type == 1) {
+            for (;;) {
+                unsigned int symbol = readFixedLiteralOrLength(bits);
+                if (symbol < 256) {
+                    out.push_back(uint8_t(symbol));
+                } else if (symbol == 256) {
+                    break;
+                } else if (symbol < 286) {
+                    unsigned int length = LENGTH_BASE[symbol - 257] + bits.read(LENGTH_EXTRA[symbol - 257]);
+                    unsigned int distanceCode = bits.readCode(5);
+                    if (distanceCode >= 30)
+                        return false;
+                    unsigned int distance = DISTANCE_BASE[distanceCode] + bits.read(DISTANCE_EXTRA[distanceCode]);
+                    if (distance > out.size())
+                        return false;
+                    for (unsigned int i = 0; i < length; i++) {
+                        out.push_back(out[out.size() - distance]);
+                    }
+                } else {
+                    return false;
+                }
+                if (bits.atEnd())
+                    return false;
+            }
+        } else {
+            // the encoder never writes dynamic Huffman blocks
+            return false;
+        }
+    }
+    bits.alignToByte();
+    return bits.getPosition() + 4 == zlib.size() && readBigEndian(&zlib[bits.getPosition()]) == adler32(out.data(), out.size());
+}
+
+/* --------------------------------------------- */
+// Decoders, both return top-down RGB rows
+/* --------------------------------------------- */
+
+uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p, pb = p > b ? p - b : b - p, pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc)
+        return uint8_t(a);
+    return uint8_t(pb <= pc ? b : c);
+}
+
+/*!
+ * Decodes an RGB PNG as written by encodePNG, checks the chunk CRCs on the way
+ * @return whether the file is valid
+ */
+bool decodePNG(const std::vector<uint8_t>& data, unsigned int& width, unsigned int& height, std::vector<uint8_t>& rgb, unsigned int& emptyStoredBlocks) {
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (data.size() < 8 || std::memcmp(data.data(), SIGNATURE, 8) != 0)
+        return false;
+
+    std::vector<uint8_t> zlib;
+    bool ended = false;
+    size_t position = 8;
+    while (position + 12 <= data.size() && !ended) {
+        uint32_t length = readBigEndian(&data[position]);
+        if (position + 12 + length > data.size())
+            return false;
+        const uint8_t* type = &data[position + 4];
+        const uint8_t* content = type + 4;
+        // the CRC covers the type and the content
+        if (readBigEndian(content + length) != crc32(type, length + 4))
+            return false;
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13 || content[8] != 8 || content[9] != 2 || content[12] != 0)
+                return false;
+            width = readBigEndian(content);
+            height = readBigEndian(content + 4);
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            zlib.insert(zlib.end(), content, content + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+        position += 12 + length;
+    }
+
+    std::vector<uint8_t> filtered;
+    if (!ended || !inflateZlib(zlib, filtered, emptyStoredBlocks))
+        return false;
+    size_t rowSize = size_t(width) * 3;
+    if (filtered.size() != size_t(height) * (rowSize + 1))
+        return false;
+
+    rgb.assign(size_t(height) * rowSize, 0);
+    for (unsigned int y = 0; y < height; y++) {
+        uint8_t filter = filtered[y * (rowSize + 1)];
+        const uint8_t* in = &filtered[y * (rowSize + 1) + 1];
+        uint8_t* row = &rgb[y * rowSize];
+        const uint8_t* above = y > 0 ? row - rowSize : nullptr;
+        for (size_t i = 0; i < rowSize; i++) {
+            int a = i >= 3 ? row[i - 3] : 0;
+            int b = above ? above[i] : 0;
+            int c = above && i >= 3 ? above[i - 3] : 0;
+            switch (filter) {
+            case 0: row[i] = in[i]; break;
+            case 1: row[i] = uint8_t(in[i] + a); break;
+            case 2: row[i] = uint8_t(in[i] + b); break;
+            case 3: row[i] = uint8_t(in[i] + (a + b) / 2); break;
+            case 4: row[i] = uint8_t(in[i] + paeth(a, b, c)); break;
+            default: return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * Decodes a QOI file
+ * @return whether the file is valid
+ */
+bool decodeQOI(const std::vector<uint8_t>& data, unsigned int& width, unsigned int& height, std::vector<uint8_t>& rgb) {
+    static const uint8_t END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    if (data.size() < 22 || std::memcmp(data.data(), "qoif", 4) != 0 || std::memcmp(&data[data.size() - 8], END, 8) != 0)
+        return false;
+    width = readBigEndian(&data[4]);
+    height = readBigEndian(&data[8]);
+    if (data[12] != 3)
+        return false;
+
+    uint8_t seen[64][4] = {};
+    uint8_t pixel[4] = {0, 0, 0, 255};
+    size_t pixelCount = size_t(width) * height, position = 14, end = data.size() - 8;
+    unsigned int run = 0;
+    rgb.clear();
+    while (rgb.size() < pixelCount * 3) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (position >= end)
+                return false;
+            uint8_t op = data[position++];
+            if (op == 0xFE) {
+                if (position + 3 > end)
+                    return false;
+                std::memcpy(pixel, &data[position], 3);
+                position += 3;
+            } else if (op == 0xFF) {
+                if (position + 4 > end)
+                    return false;
+                std::memcpy(pixel, &data[position], 4);
+                position += 4;
+            } else if ((op & 0xC0) == 0x00) {
+                std::memcpy(pixel, seen[op], 4);
+            } else if ((op & 0xC0) == 0x40) {
+                pixel[0] = uint8_t(pixel[0] + ((op >> 4) & 3) - 2);
+                pixel[1] = uint8_t(pixel[1] + ((op >> 2) & 3) - 2);
+                pixel[2] = uint8_t(pixel[2] + (op & 3) - 2);
+            } else if ((op & 0xC0) == 0x80) {
+                if (position >= end)
+                    return false;
+                int dg = (op & 0x3F) - 32;
+                uint8_t next = data[position++];
+                pixel[0] = uint8_t(pixel[0] + dg + (next >> 4) - 8);
+                pixel[1] = uint8_t(pixel[1] + dg);
+                pixel[2] = uint8_t(pixel[2] + dg + (next & 0x0F) - 8);
+            } else {
+                run = op & 0x3F;
+            }
+            std::memcpy(seen[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+        }
+        rgb.insert(rgb.end(), pixel, pixel + 3);
+    }
+    return position == end;
+}
+
+/* --------------------------------------------- */
+// Test images
+/* --------------------------------------------- */
+
+/*!
+ * A gradient with flat bands and noisy blocks, so the filters, matches, runs and every QOI op are used
+ */
+Image createImage(unsigned int width, unsigned int height) {
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    uint32_t random = 12345;
+    for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            uint8_t* p = &image.pixels[(size_t(y) * width + x) * 4];
+            random = random * 1664525u + 1013904223u;
+            if ((y / 8) % 3 == 0) {
+                p[0] = 40;
+                p[1] = 90;
+                p[2] = 200;
+            } else if ((x / 5 + y / 8) % 2 == 0) {
+                p[0] = uint8_t(x * 3 + y);
+                p[1] = uint8_t(x * 2);
+                p[2] = uint8_t(y * 5);
+            } else {
+                p[0] = uint8_t(random >> 24);
+                p[1] = uint8_t(random >> 16);
+                p[2] = uint8_t(random >> 8);
+            }
+            p[3] = 255;
+        }
+    }
+    return image;
+}
+
+/*!
+ * @return whether top-down RGB rows hold the pixels of an image
+ */
+bool matches(const Image& image, const std::vector<uint8_t>& rgb) {
+    if (rgb.size() != size_t(image.width) * image.height * 3)
+        return false;
+    for (unsigned int y = 0; y < image.height; y++) {
+        const uint8_t* source = &image.pixels[size_t(image.height - 1 - y) * image.width * 4];
+        const uint8_t* row = &rgb[size_t(y) * image.width * 3];
+        for (unsigned int x = 0; x < image.width; x++) {
+            if (std::memcmp(&source[x * 4], &row[x * 3], 3) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    // the reference checksums against known values
+    const char* text = "Wikipedia";
+    check(adler32(reinterpret_cast<const uint8_t*>(text), 9) == 0x11E60398u, "the reference Adler-32 is correct");
+    check(crc32(reinterpret_cast<const uint8_t*>("IEND"), 4) == 0xAE426082u, "the reference CRC-32 is correct");
+
+    // a known image: a single red pixel, the encoder output ends with the well-known IEND chunk
+    {
+        Image image;
+        image.width = 1;
+        image.height = 1;
+        image.pixels = {255, 0, 0, 255};
+        std::vector<uint8_t> png;
+        encodePNG(image, png);
+        static const uint8_t IEND[12] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82};
+        check(png.size() > 12 && std::memcmp(&png[png.size() - 12], IEND, 12) == 0, "the PNG ends with the IEND chunk");
+        unsigned int width = 0, height = 0, emptyStoredBlocks = 0;
+        std::vector<uint8_t> rgb;
+        check(decodePNG(png, width, height, rgb, emptyStoredBlocks) && width == 1 && height == 1 && matches(image, rgb), "a single pixel PNG decodes");
+    }
+
+    // heights around the minimum stripe height, on 1 to 6 threads
+    const unsigned int MIN_STRIPE_ROWS = 32;
+    const unsigned int HEIGHTS[] = {1, 31, 32, 33, 63, 64, 65, 95, 96, 97, 191, 192, 193};
+    for (unsigned int height : HEIGHTS) {
+        Image image = createImage(37, height);
+        for (unsigned int threads = 1; threads <= 6; threads++) {
+            std::string name = "37x" + std::to_string(height) + " on " + std::to_string(threads) + " thread(s)";
+            std::vector<uint8_t> png;
+            encodePNG(image, png, threads);
+            unsigned int width = 0, decodedHeight = 0, emptyStoredBlocks = 0;
+            std::vector<uint8_t> rgb;
+            bool valid = decodePNG(png, width, decodedHeight, rgb, emptyStoredBlocks);
+            check(valid, "the PNG of " + name + " is valid");
+            check(valid && width == image.width && decodedHeight == height && matches(image, rgb), "the PNG of " + name + " round trips");
+            unsigned int expectedStripes = std::max(1u, std::min(threads, height / MIN_STRIPE_ROWS));
+            check(emptyStoredBlocks == expectedStripes, "the PNG of " + name + " is split into " + std::to_string(expectedStripes) + " stripe(s)");
+        }
+
+        std::vector<uint8_t> qoi;
+        encodeQOI(image, qoi);
+        unsigned int width = 0, decodedHeight = 0;
+        std::vector<uint8_t> rgb;
+        bool valid = decodeQOI(qoi, width, decodedHeight, rgb);
+        check(valid && width == image.width && decodedHeight == height && matches(image, rgb), "the QOI of 37x" + std::to_string(height) + " round trips");
+    }
+
+    // a flat image has to be compressed with matches and runs
+    {
+        Image image;
+        image.width = 64;
+        image.height = 64;
+        image.pixels.assign(64 * 64 * 4, 128);
+        std::vector<uint8_t> png, qoi;
+        encodePNG(image, png, 2);
+        encodeQOI(image, qoi);
+        check(png.size() < 64 * 64 * 3 / 10, "a flat PNG is compressed");
+        check(qoi.size() < 64 * 64 * 3 / 10, "a flat QOI is compressed");
+        unsigned int width = 0, height = 0, emptyStoredBlocks = 0;
+        std::vector<uint8_t> rgb;
+        check(decodePNG(png, width, height, rgb, emptyStoredBlocks) && matches(image, rgb), "a flat PNG round trips");
+        check(decodeQOI(qoi, width, height, rgb) && matches(image, rgb), "a flat QOI round trips");
+    }
+
+    if (failures == 0) {
+        std::cout << "ImageEncoder: all checks passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+// CPU-only test of the software occlusion culler, needs neither a window nor a GL context
+#include "OcclusionCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        failures++;
+    }
+}
+
+} // namespace
+
+int main() {
+    // camera at the origin looking down -z
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    OcclusionCuller culler(256, 128);
+    culler.beginFrame(projection * view);
+    // a wall in front of the camera, covering the center of the screen
+    culler.addOccluder(OcclusionCuller::createBoxOccluder(AABB(glm::vec3(-1.0f, -1.0f, -5.5f), glm::vec3(1.0f, 1.0f, -5.0f))), glm::mat4(1.0f));
+    culler.rasterizeOccluders();
+
+    check(culler.getTriangleCount() > 0, "the occluder is rasterized");
+    check(!culler.isVisible(AABB(glm::vec3(-0.3f, -0.3f, -10.3f), glm::vec3(0.3f, 0.3f, -9.7f))), "a box behind the occluder is hidden");
+    check(culler.isVisible(AABB(glm::vec3(2.7f, -0.3f, -10.3f), glm::vec3(3.3f, 0.3f, -9.7f))), "a box beside the occluder is visible");
+    check(culler.isVisible(AABB(glm::vec3(-0.3f, -0.3f, -3.3f), glm::vec3(0.3f, 0.3f, -2.7f))), "a box in front of the occluder is visible");
+    check(culler.getTestedCount() == 3 && culler.getCulledCount() == 1, "tested and culled objects are counted");
+
+    // without occluders nothing in view is hidden
+    culler.beginFrame(projection * view);
+    culler.rasterizeOccluders();
+    check(culler.isVisible(AABB(glm::vec3(-0.3f, -0.3f, -10.3f), glm::vec3(0.3f, 0.3f, -9.7f))), "a box is visible without occluders");
+
+    if (failures == 0) {
+        std::cout << "OcclusionCuller: all checks passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// CPU-only test of the scene graph, checks the propagated matrices and times the update of 100k changed nodes
+#include "Parallel.h"
+#include "SceneGraph.h"
+
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        failures++;
+    }
+}
+
+bool nearlyEqual(const glm::mat4& a, const glm::mat4& b) {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            if (std::abs(a[column][row] - b[column][row]) > 1e-4f)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool nearlyEqual(const glm::mat3& a, const glm::mat3& b) { return nearlyEqual(glm::mat4(a), glm::mat4(b)); }
+
+} // namespace
+
+int main() {
+    // a small hierarchy: root -> child -> grandchild
+    {
+        SceneGraph graph;
+        glm::mat4 rootLocal = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+        glm::mat4 childLocal = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f, 1.0f, 1.0f));
+        glm::mat4 grandchildLocal = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        NodeId root = graph.createNode(rootLocal);
+        NodeId child = graph.createNode(childLocal, root);
+        NodeId grandchild = graph.createNode(grandchildLocal, child);
+        graph.update();
+        check(nearlyEqual(graph.getWorldMatrix(grandchild), rootLocal * childLocal * grandchildLocal), "world matrices are propagated");
+
+        glm::mat4 moved = glm::translate(glm::mat4(1.0f), glm::vec3(-4.0f, 0.0f, 0.0f));
+        graph.setLocalMatrix(root, moved);
+        graph.update();
+        check(graph.hasChanged(grandchild), "descendants of a changed node are changed");
+        check(nearlyEqual(graph.getWorldMatrix(grandchild), moved * childLocal * grandchildLocal), "descendants follow their parent");
+        check(nearlyEqual(graph.getPreviousWorldMatrix(grandchild), rootLocal * childLocal * grandchildLocal), "the previous world matrix is kept");
+        glm::mat3 expectedNormal = glm::transpose(glm::inverse(glm::mat3(moved * childLocal)));
+        check(nearlyEqual(graph.getNormalMatrix(child), expectedNormal), "the normal matrix of a non-uniformly scaled node is computed");
+        check(nearlyEqual(glm::mat3(graph.getWorldData()[grandchild].normal), expectedNormal), "the bulk data contains the pending normal matrices");
+
+        graph.update();
+        check(!graph.hasChanged(grandchild), "nodes are unchanged once nothing moves");
+    }
+
+    // 1000 roots with 99 children each, every root moves each frame
+    {
+        const unsigned int ROOTS = 1000, CHILDREN = 99, FRAMES = 10;
+        SceneGraph graph;
+        std::vector<NodeId> roots;
+        for (unsigned int i = 0; i < ROOTS; i++) {
+            roots.push_back(graph.createNode(glm::translate(glm::mat4(1.0f), glm::vec3(float(i), 0.0f, 0.0f))));
+        }
+        for (unsigned int i = 0; i < ROOTS * CHILDREN; i++) {
+            graph.createNode(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, float(i % 7), 0.0f)), roots[i % ROOTS]);
+        }
+
+        std::cout << "SceneGraph: update of " << graph.getNodeCount() << " changed nodes" << std::endl;
+        for (unsigned int threads = 1; threads <= getWorkerThreadCount(); threads *= 2) {
+            double total = 0.0;
+            for (unsigned int frame = 0; frame < FRAMES; frame++) {
+                for (NodeId root : roots) {
+                    graph.setLocalMatrix(root, glm::translate(glm::mat4(1.0f), glm::vec3(float(root), 0.0f, float(frame))));
+                }
+                auto start = std::chrono::steady_clock::now();
+                graph.update(threads);
+                total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            std::cout << "  " << threads << " thread(s): " << total / FRAMES << " ms" << std::endl;
+        }
+        NodeId last = graph.getNodeCount() - 1;
+        glm::vec3 position = glm::vec3(graph.getWorldMatrix(last)[3]);
+        NodeId root = graph.getParent(last);
+        check(position == glm::vec3(float(root), float((last - ROOTS) % 7), float(FRAMES - 1)), "the parallel update propagates every level");
+    }
+
+    if (failures == 0) {
+        std::cout << "SceneGraph: all checks passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}